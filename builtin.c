@@ -0,0 +1,1003 @@
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include "builtin.h"
+#include "equal.h"
+#include "error.h"
+#include "parser.h"
+#include "datatype.h"
+#include "namespace.h"
+#include "print.h"
+#include "symbol.h"
+#include "f64vector.h"
+#include "hashtable.h"
+#include "memo.h"
+#include "number.h"
+#include "vm.h"
+
+/* Checks that every argument is a number */
+static bool check_numbers(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    for (unsigned int i = 0; i < argc; i++)
+    {
+        if (type_of(argv[i]) != NUMBER)
+        {
+            parser->error = EXPECTED_NUMBER;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Adds up argv, negating everything after the first if subtract is set
+static Value sum(struct Parser *parser, unsigned int argc, Value *argv, bool subtract)
+{
+    if (!check_numbers(parser, argc, argv)) return NO_VALUE;
+    Value total = (argc == 0) ? vfixnum(0) : argv[0];
+    for (unsigned int i = 1; i < argc && total != NO_VALUE; i++)
+    {
+        total = subtract ? number_sub(total, argv[i]) : number_add(total, argv[i]);
+    }
+    return total;
+}
+
+static Value builtin_add(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    return sum(parser, argc, argv, false);
+}
+
+static Value builtin_subtract(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    if (argc == 1)
+    {
+        // if only one value passed to '-', then it's a unary '-'
+        if (!check_numbers(parser, argc, argv)) return NO_VALUE;
+        return number_negate(argv[0]);
+    }
+    return sum(parser, argc, argv, true);
+}
+
+static Value builtin_multiply(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    if (!check_numbers(parser, argc, argv)) return NO_VALUE;
+    Value product = vfixnum(1);
+    for (unsigned int i = 0; i < argc && product != NO_VALUE; i++)
+    {
+        product = number_mul(product, argv[i]);
+    }
+    return product;
+}
+
+enum CompareOp
+{
+    EQ,
+    LEQ,
+    GEQ,
+    LESS,
+    GREATER,
+};
+
+static Value compare(struct Parser *parser, unsigned int argc, Value *argv, enum CompareOp op)
+{
+    if (!check_numbers(parser, argc, argv)) return NO_VALUE;
+
+    for (unsigned int i = 1; i < argc; i++)
+    {
+        // Exact integers are compared exactly, anything else as doubles
+        if (is_exact(argv[i - 1]) && is_exact(argv[i]))
+        {
+            int c = compare_integers(argv[i - 1], argv[i]);
+            if ((op == EQ && !(c == 0)) ||
+                    (op == LEQ && !(c <= 0)) ||
+                    (op == GEQ && !(c >= 0)) ||
+                    (op == LESS && !(c < 0)) ||
+                    (op == GREATER && !(c > 0)))
+            {
+                return vboolean(false);
+            }
+            continue;
+        }
+        double prev = as_number(argv[i - 1]);
+        double n = as_number(argv[i]);
+        if ((op == EQ && !(prev == n)) ||
+                (op == LEQ && !(prev <= n)) ||
+                (op == GEQ && !(prev >= n)) ||
+                (op == LESS && !(prev < n)) ||
+                (op == GREATER && !(prev > n)))
+        {
+            return vboolean(false);
+        }
+    }
+    return vboolean(true);
+}
+
+// Gets an integer argument as a C integer. Inexact ones must be whole
+// numbers that fit in an int64_t
+static bool get_integer(struct Parser *parser, Value v, int64_t *n)
+{
+    if (is_fixnum(v))
+    {
+        *n = as_fixnum(v);
+        return true;
+    }
+    else if (type_of(v) != NUMBER)
+    {
+        parser->error = EXPECTED_NUMBER;
+        return false;
+    }
+    double d = as_number(v);
+    if (!(d > -9223372036854775808.0 && d < 9223372036854775808.0) || d != (double)(int64_t)d)
+    {
+        parser->error = EXPECTED_INTEGER;
+        return false;
+    }
+    *n = (int64_t)d;
+    return true;
+}
+
+static Value divide(struct Parser *parser, Value *argv, enum DivideOp op)
+{
+    // Exact integers can be any size
+    if (is_exact(argv[0]) && is_exact(argv[1]))
+    {
+        if (argv[1] == vfixnum(0))
+        {
+            parser->error = DIVISION_BY_ZERO;
+            return NO_VALUE;
+        }
+        return divide_integers(argv[0], argv[1], op);
+    }
+
+    int64_t a, b, r;
+    if (!get_integer(parser, argv[0], &a) || !get_integer(parser, argv[1], &b)) return NO_VALUE;
+    if (b == 0)
+    {
+        parser->error = DIVISION_BY_ZERO;
+        return NO_VALUE;
+    }
+
+    // C division truncates, which is what quotient and remainder want.
+    // modulo takes the sign of the divisor instead
+    if (op == QUOTIENT)
+    {
+        r = a / b;
+    }
+    else
+    {
+        r = a % b;
+        if (op == MODULO && r != 0 && (r < 0) != (b < 0)) r += b;
+    }
+
+    return vnumber((double)r);
+}
+
+static Value builtin_quotient(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    return divide(parser, argv, QUOTIENT);
+}
+
+static Value builtin_remainder(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    return divide(parser, argv, REMAINDER);
+}
+
+static Value builtin_modulo(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    return divide(parser, argv, MODULO);
+}
+
+static Value builtin_eq_op(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    return compare(parser, argc, argv, EQ);
+}
+
+static Value builtin_leq(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    return compare(parser, argc, argv, LEQ);
+}
+
+static Value builtin_geq(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    return compare(parser, argc, argv, GEQ);
+}
+
+static Value builtin_less(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    return compare(parser, argc, argv, LESS);
+}
+
+static Value builtin_greater(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    return compare(parser, argc, argv, GREATER);
+}
+
+static Value builtin_eq(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)parser;
+    (void)argc;
+    return vboolean(is_eq(argv[0], argv[1]));
+}
+
+static Value builtin_equal(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)parser;
+    (void)argc;
+    return vboolean(is_equal(argv[0], argv[1]));
+}
+
+static Value builtin_car(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    Value v = argv[0];
+    (void)argc;
+    if (type_of(v) == PAIR)
+    {
+        return as_pair(v)->car;
+    }
+    else if (type_of(v) != LIST || is_empty(as_list(v)))
+    {
+        parser->error = EXPECTED_PAIR;
+        return NO_VALUE;
+    }
+    return list_lookup(as_list(v), 0);
+}
+
+static Value builtin_cdr(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    Value v = argv[0];
+    (void)argc;
+    if (type_of(v) == PAIR)
+    {
+        return as_pair(v)->cdr;
+    }
+    else if (type_of(v) != LIST || is_empty(as_list(v)))
+    {
+        parser->error = EXPECTED_PAIR;
+        return NO_VALUE;
+    }
+    // Shares the rest of the array rather than copying it
+    return list_tail(v);
+}
+
+static Value builtin_cons(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    Value car = argv[0], cdr = argv[1];
+    (void)argc;
+    if (type_of(cdr) != LIST && type_of(cdr) != PAIR)
+    {
+        parser->error = EXPECTED_LIST;
+        return NO_VALUE;
+    }
+    return vpair(car, cdr);
+}
+
+static Value builtin_display(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)parser;
+    (void)argc;
+    print(argv[0], true);
+    return NO_VALUE;
+}
+
+// Checks that v can be called
+static bool check_proc(struct Parser *parser, Value v)
+{
+    if (type_of(v) != PROCEDURE && type_of(v) != BUILTIN && type_of(v) != MEMO)
+    {
+        parser->error = EXPECTED_PROC;
+        return false;
+    }
+    return true;
+}
+
+static inline Value is_type(unsigned int argc, Value *argv, enum Type t)
+{
+    (void)argc;
+    return vboolean(type_of(argv[0]) == t);
+}
+
+static Value builtin_not(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)parser;
+    (void)argc;
+    return vboolean(argv[0] == FALSE_VALUE);
+}
+
+static Value builtin_is_boolean(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)parser;
+    return is_type(argc, argv, BOOLEAN);
+}
+
+static Value builtin_is_symbol(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)parser;
+    return is_type(argc, argv, SYMBOL);
+}
+
+static Value builtin_is_char(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)parser;
+    return is_type(argc, argv, CHAR);
+}
+
+static Value builtin_is_procedure(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)parser;
+    (void)argc;
+    return vboolean(type_of(argv[0]) == PROCEDURE || type_of(argv[0]) == BUILTIN
+            || type_of(argv[0]) == MEMO);
+}
+
+static Value builtin_is_list(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)parser;
+    (void)argc;
+    return vboolean(type_of(argv[0]) == LIST || type_of(argv[0]) == PAIR);
+}
+
+static Value builtin_is_number(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)parser;
+    return is_type(argc, argv, NUMBER);
+}
+
+static Value builtin_is_integer(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)parser;
+    (void)argc;
+    Value v = argv[0];
+    if (is_exact(v)) return vboolean(true);
+    else if (!is_double(v)) return vboolean(false);
+
+    // Every finite double from 2^53 up is whole, and the rest fit in an
+    // int64_t. d - d is only 0 for finite numbers
+    double d = as_number(v);
+    if (d - d != 0) return vboolean(false);
+    else if (d >= 9007199254740992.0 || d <= -9007199254740992.0) return vboolean(true);
+    return vboolean(d == (double)(int64_t)d);
+}
+
+static Value builtin_is_exact(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    if (!check_numbers(parser, 1, argv)) return NO_VALUE;
+    return vboolean(is_exact(argv[0]));
+}
+
+static Value builtin_is_inexact(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    if (!check_numbers(parser, 1, argv)) return NO_VALUE;
+    return vboolean(is_double(argv[0]));
+}
+
+static Value builtin_is_string(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)parser;
+    return is_type(argc, argv, STRING);
+}
+
+static Value builtin_is_pair(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    if (type_of(argv[0]) == PAIR)
+    {
+        return vboolean(true);
+    }
+    else if (type_of(argv[0]) != LIST)
+    {
+        parser->error = EXPECTED_PAIR;
+        return NO_VALUE;
+    }
+    return vboolean(argv[0] != EMPTY_LIST);
+}
+
+/* f64vectors */
+
+static bool check_f64vector(struct Parser *parser, Value v)
+{
+    if (type_of(v) != F64VECTOR)
+    {
+        parser->error = EXPECTED_F64VECTOR;
+        return false;
+    }
+    return true;
+}
+
+// Gets a length or index, which must be a whole number below limit
+static bool get_index(struct Parser *parser, Value v, unsigned int limit, unsigned int *index)
+{
+    if (type_of(v) != NUMBER)
+    {
+        parser->error = EXPECTED_NUMBER;
+        return false;
+    }
+    double d = as_number(v);
+    if (!(d >= 0 && d < limit) || d != (unsigned int)d)
+    {
+        parser->error = INDEX_OUT_OF_RANGE;
+        return false;
+    }
+    *index = (unsigned int)d;
+    return true;
+}
+
+// Gets a size in bytes, which must be an exact integer that isn't
+// negative. Sizes too big for a size_t are taken as SIZE_MAX
+static bool get_size(struct Parser *parser, Value v, size_t *size)
+{
+    if (type_of(v) != NUMBER)
+    {
+        parser->error = EXPECTED_NUMBER;
+        return false;
+    }
+    uint64_t n = 0;
+    if (is_fixnum(v) && as_fixnum(v) >= 0)
+    {
+        n = (uint64_t)as_fixnum(v);
+    }
+    else if (is_bignum(v) && !as_bignum(v)->negative)
+    {
+        struct Bignum *big = as_bignum(v);
+        for (unsigned int i = big->length; i > 0 && n != UINT64_MAX; i--)
+        {
+            n = (n >> 32 != 0) ? UINT64_MAX : (n << 32) | big->digits[i - 1];
+        }
+    }
+    else
+    {
+        parser->error = INDEX_OUT_OF_RANGE;
+        return false;
+    }
+    *size = (n > SIZE_MAX) ? SIZE_MAX : (size_t)n;
+    return true;
+}
+
+static Value builtin_make_f64vector(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    unsigned int length;
+    if (!get_index(parser, argv[0], UINT_MAX, &length)) return NO_VALUE;
+    if (argc == 2 && !check_numbers(parser, 1, &argv[1])) return NO_VALUE;
+
+    struct F64Vector *vec = new_f64vector(length);
+    if (vec == NULL) return NO_VALUE;
+    if (argc == 2)
+    {
+        double fill = as_number(argv[1]);
+        for (unsigned int i = 0; i < length; i++) vec->data[i] = fill;
+    }
+    return vf64vector(vec);
+}
+
+static Value builtin_f64vector(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    if (!check_numbers(parser, argc, argv)) return NO_VALUE;
+    struct F64Vector *vec = new_f64vector(argc);
+    if (vec == NULL) return NO_VALUE;
+    for (unsigned int i = 0; i < argc; i++) vec->data[i] = as_number(argv[i]);
+    return vf64vector(vec);
+}
+
+static Value builtin_is_f64vector(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)parser;
+    return is_type(argc, argv, F64VECTOR);
+}
+
+static Value builtin_f64vector_length(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    if (!check_f64vector(parser, argv[0])) return NO_VALUE;
+    return vinteger(as_f64vector(argv[0])->length);
+}
+
+static Value builtin_f64vector_ref(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    unsigned int i;
+    if (!check_f64vector(parser, argv[0])
+            || !get_index(parser, argv[1], as_f64vector(argv[0])->length, &i))
+    {
+        return NO_VALUE;
+    }
+    return vnumber(as_f64vector(argv[0])->data[i]);
+}
+
+static Value builtin_list_to_f64vector(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    if (type_of(argv[0]) != LIST && type_of(argv[0]) != PAIR)
+    {
+        parser->error = EXPECTED_LIST;
+        return NO_VALUE;
+    }
+    Value v = flatten_list(argv[0]);
+    if (v == NO_VALUE) return NO_VALUE;
+    struct List *lst = as_list(v);
+    return builtin_f64vector(parser, lst->size, lst->values);
+}
+
+static Value builtin_f64vector_to_list(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    if (!check_f64vector(parser, argv[0])) return NO_VALUE;
+    struct F64Vector *vec = as_f64vector(argv[0]);
+    struct List *lst = list();
+    if (lst == NULL) return NO_VALUE;
+    for (unsigned int i = 0; i < vec->length; i++)
+    {
+        if (!append(lst, vnumber(vec->data[i])))
+        {
+            delete_list(lst);
+            return NO_VALUE;
+        }
+    }
+    return vlist(lst);
+}
+
+static Value builtin_f64vector_sum(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    if (!check_f64vector(parser, argv[0])) return NO_VALUE;
+    return vnumber(f64_sum(as_f64vector(argv[0])->data, as_f64vector(argv[0])->length));
+}
+
+static Value builtin_f64vector_dot(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    if (!check_f64vector(parser, argv[0]) || !check_f64vector(parser, argv[1])) return NO_VALUE;
+    struct F64Vector *x = as_f64vector(argv[0]), *y = as_f64vector(argv[1]);
+    if (x->length != y->length)
+    {
+        parser->error = LENGTH_MISMATCH;
+        return NO_VALUE;
+    }
+    return vnumber(f64_dot(x->data, y->data, x->length));
+}
+
+// Applies op to each element of a vector and the matching element of
+// another vector, or a number
+static Value vector_op(struct Parser *parser, Value *argv, enum VectorOp op)
+{
+    if (!check_f64vector(parser, argv[0])) return NO_VALUE;
+    struct F64Vector *x = as_f64vector(argv[0]);
+    bool broadcast = (type_of(argv[1]) == NUMBER);
+    double n;
+    const double *y = &n;
+    if (broadcast)
+    {
+        n = as_number(argv[1]);
+    }
+    else if (!check_f64vector(parser, argv[1]))
+    {
+        return NO_VALUE;
+    }
+    else if (as_f64vector(argv[1])->length != x->length)
+    {
+        parser->error = LENGTH_MISMATCH;
+        return NO_VALUE;
+    }
+    else
+    {
+        y = as_f64vector(argv[1])->data;
+    }
+
+    struct F64Vector *out = new_f64vector(x->length);
+    if (out == NULL) return NO_VALUE;
+    f64_binary(op, x->data, y, broadcast, out->data, x->length);
+    return vf64vector(out);
+}
+
+static Value builtin_f64vector_add(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    return vector_op(parser, argv, VEC_ADD);
+}
+
+static Value builtin_f64vector_sub(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    return vector_op(parser, argv, VEC_SUB);
+}
+
+static Value builtin_f64vector_mul(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    return vector_op(parser, argv, VEC_MUL);
+}
+
+static Value builtin_f64vector_div(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    return vector_op(parser, argv, VEC_DIV);
+}
+
+static Value builtin_f64vector_eq(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    return vector_op(parser, argv, VEC_EQ);
+}
+
+static Value builtin_f64vector_less(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    return vector_op(parser, argv, VEC_LT);
+}
+
+static Value builtin_f64vector_greater(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    return vector_op(parser, argv, VEC_GT);
+}
+
+static Value builtin_f64vector_leq(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    return vector_op(parser, argv, VEC_LEQ);
+}
+
+static Value builtin_f64vector_geq(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    return vector_op(parser, argv, VEC_GEQ);
+}
+
+static Value builtin_f64vector_map(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    if (!check_proc(parser, argv[0]))
+    {
+        return NO_VALUE;
+    }
+    else if (!check_f64vector(parser, argv[1]))
+    {
+        return NO_VALUE;
+    }
+
+    // The arguments stay rooted on the VM's stack while the procedure
+    // runs, and vector buffers never move, so only argv is read again
+    unsigned int length = as_f64vector(argv[1])->length;
+    struct F64Vector *out = new_f64vector(length);
+    if (out == NULL) return NO_VALUE;
+    for (unsigned int i = 0; i < length; i++)
+    {
+        Value x = vnumber(as_f64vector(argv[1])->data[i]);
+        Value y = apply(parser, argv[0], 1, &x);
+        if (y != NO_VALUE && type_of(y) != NUMBER) parser->error = EXPECTED_NUMBER;
+        if (parser->error != NO_ERROR)
+        {
+            delete_f64vector(out);
+            return NO_VALUE;
+        }
+        out->data[i] = as_number(y);
+    }
+    return vf64vector(out);
+}
+
+/* Memos */
+
+static bool check_memo(struct Parser *parser, Value v)
+{
+    if (type_of(v) != MEMO)
+    {
+        parser->error = EXPECTED_MEMO;
+        return false;
+    }
+    return true;
+}
+
+static Value builtin_memoize(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    unsigned int max_entries = MEMO_DEFAULT_ENTRIES;
+    size_t max_bytes = MEMO_DEFAULT_BYTES;
+    if (type_of(argv[0]) != PROCEDURE)
+    {
+        parser->error = EXPECTED_PROC;
+        return NO_VALUE;
+    }
+    else if (argc > 1 && !get_index(parser, argv[1], UINT_MAX, &max_entries))
+    {
+        return NO_VALUE;
+    }
+    else if (argc > 2 && !get_size(parser, argv[2], &max_bytes))
+    {
+        return NO_VALUE;
+    }
+    return vmemo(new_memo(argv[0], max_entries, max_bytes));
+}
+
+static Value builtin_memo_hits(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    if (!check_memo(parser, argv[0])) return NO_VALUE;
+    return vinteger(as_memo(argv[0])->hits);
+}
+
+static Value builtin_memo_misses(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    if (!check_memo(parser, argv[0])) return NO_VALUE;
+    return vinteger(as_memo(argv[0])->misses);
+}
+
+static Value builtin_memo_count(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    if (!check_memo(parser, argv[0])) return NO_VALUE;
+    return vinteger(as_memo(argv[0])->count);
+}
+
+/* Hash tables */
+
+static bool check_hash_table(struct Parser *parser, Value v)
+{
+    if (type_of(v) != HASH_TABLE)
+    {
+        parser->error = EXPECTED_HASH_TABLE;
+        return false;
+    }
+    return true;
+}
+
+static Value builtin_make_hash_table(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    bool equal = true;
+    if (argc == 1)
+    {
+        // Any other equivalence couldn't be hashed
+        if (type_of(argv[0]) == BUILTIN && as_builtin(argv[0])->function_ptr == builtin_eq)
+        {
+            equal = false;
+        }
+        else if (type_of(argv[0]) != BUILTIN || as_builtin(argv[0])->function_ptr != builtin_equal)
+        {
+            parser->error = UNSUPPORTED_EQUIVALENCE;
+            return NO_VALUE;
+        }
+    }
+    return vhash_table(new_hash_table(equal));
+}
+
+static Value builtin_is_hash_table(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)parser;
+    return is_type(argc, argv, HASH_TABLE);
+}
+
+// Gets the value of key in table, or calls thunk (if it isn't NO_VALUE)
+// for one if it isn't there
+static Value table_ref(struct Parser *parser, Value table, Value key, Value thunk)
+{
+    Value v = hash_table_get(as_hash_table(table), key);
+    if (v != NO_VALUE) return v;
+    else if (thunk == NO_VALUE)
+    {
+        parser->error = KEY_NOT_FOUND;
+        return NO_VALUE;
+    }
+    return apply(parser, thunk, 0, NULL);
+}
+
+static Value builtin_hash_table_ref(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    if (!check_hash_table(parser, argv[0]) || (argc == 3 && !check_proc(parser, argv[2])))
+    {
+        return NO_VALUE;
+    }
+    return table_ref(parser, argv[0], argv[1], argc == 3 ? argv[2] : NO_VALUE);
+}
+
+static Value builtin_hash_table_ref_default(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    if (!check_hash_table(parser, argv[0])) return NO_VALUE;
+    Value v = hash_table_get(as_hash_table(argv[0]), argv[1]);
+    return v == NO_VALUE ? argv[2] : v;
+}
+
+static Value builtin_hash_table_contains(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    if (!check_hash_table(parser, argv[0])) return NO_VALUE;
+    return vboolean(hash_table_get(as_hash_table(argv[0]), argv[1]) != NO_VALUE);
+}
+
+static Value builtin_hash_table_set(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    if (!check_hash_table(parser, argv[0])) return NO_VALUE;
+    if (!hash_table_put(argv[0], argv[1], argv[2])) parser->error = OUT_OF_MEMORY;
+    return NO_VALUE;
+}
+
+static Value builtin_hash_table_delete(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    if (!check_hash_table(parser, argv[0])) return NO_VALUE;
+    hash_table_remove(as_hash_table(argv[0]), argv[1]);
+    return NO_VALUE;
+}
+
+// Binds argv[1] in the hash table argv[0] to what the procedure argv[2]
+// gives for v, its value before
+static Value update_entry(struct Parser *parser, Value *argv, Value v)
+{
+    // The arguments stay rooted on the VM's stack while the procedure
+    // runs, so argv is up to date after it
+    v = apply(parser, argv[2], 1, &v);
+    if (parser->error != NO_ERROR) return NO_VALUE;
+    else if (v == NO_VALUE)
+    {
+        parser->error = UNDEFINED;
+        return NO_VALUE;
+    }
+    if (!hash_table_put(argv[0], argv[1], v)) parser->error = OUT_OF_MEMORY;
+    return NO_VALUE;
+}
+
+static Value builtin_hash_table_update(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    if (!check_hash_table(parser, argv[0]) || !check_proc(parser, argv[2])
+            || (argc == 4 && !check_proc(parser, argv[3])))
+    {
+        return NO_VALUE;
+    }
+    Value v = table_ref(parser, argv[0], argv[1], argc == 4 ? argv[3] : NO_VALUE);
+    if (parser->error != NO_ERROR) return NO_VALUE;
+    return update_entry(parser, argv, v);
+}
+
+static Value builtin_hash_table_update_default(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    if (!check_hash_table(parser, argv[0]) || !check_proc(parser, argv[2])) return NO_VALUE;
+    Value v = hash_table_get(as_hash_table(argv[0]), argv[1]);
+    return update_entry(parser, argv, v == NO_VALUE ? argv[3] : v);
+}
+
+static Value builtin_hash_table_count(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    if (!check_hash_table(parser, argv[0])) return NO_VALUE;
+    return vinteger(as_hash_table(argv[0])->count);
+}
+
+// Gets a list of the keys (or values) of a hash table
+static Value table_list(struct Parser *parser, Value table, bool keys)
+{
+    if (!check_hash_table(parser, table)) return NO_VALUE;
+    struct HashTable *t = as_hash_table(table);
+    struct List *lst = list();
+    if (lst == NULL) return NO_VALUE;
+    for (unsigned int i = 0; i < t->count; i++)
+    {
+        if (!append(lst, keys ? t->entries[i].key : t->entries[i].value))
+        {
+            delete_list(lst);
+            return NO_VALUE;
+        }
+    }
+    return vlist(lst);
+}
+
+static Value builtin_hash_table_keys(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    return table_list(parser, argv[0], true);
+}
+
+static Value builtin_hash_table_values(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    return table_list(parser, argv[0], false);
+}
+
+static Value builtin_hash_table_walk(struct Parser *parser, unsigned int argc, Value *argv)
+{
+    (void)argc;
+    if (!check_hash_table(parser, argv[0]) || !check_proc(parser, argv[1])) return NO_VALUE;
+
+    // proc may change the table, so it's looked at afresh for each entry.
+    // Entries it adds or removes may or may not be visited
+    for (unsigned int i = 0; i < as_hash_table(argv[0])->count; i++)
+    {
+        struct HashEntry *e = &as_hash_table(argv[0])->entries[i];
+        Value args[] = { e->key, e->value };
+        apply(parser, argv[1], 2, args);
+        if (parser->error != NO_ERROR) return NO_VALUE;
+    }
+    return NO_VALUE;
+}
+
+static struct InternalFunction builtins[] = {
+    { "+", 0, -1, builtin_add },
+    { "-", 1, -1, builtin_subtract },
+    { "*", 0, -1, builtin_multiply },
+    { "=", 1, -1, builtin_eq_op },
+    { "<=", 1, -1, builtin_leq },
+    { ">=", 1, -1, builtin_geq },
+    { "<", 1, -1, builtin_less },
+    { ">", 1, -1, builtin_greater },
+    { "quotient", 2, 2, builtin_quotient },
+    { "remainder", 2, 2, builtin_remainder },
+    { "modulo", 2, 2, builtin_modulo },
+    { "eq?", 2, 2, builtin_eq },
+    { "equal?", 2, 2, builtin_equal },
+    { "car", 1, 1, builtin_car },
+    { "cdr", 1, 1, builtin_cdr },
+    { "cons", 2, 2, builtin_cons },
+    { "display", 1, 1, builtin_display },
+    { "not", 1, 1, builtin_not },
+    { "boolean?", 1, 1, builtin_is_boolean },
+    { "symbol?", 1, 1, builtin_is_symbol },
+    { "char?", 1, 1, builtin_is_char },
+    { "procedure?", 1, 1, builtin_is_procedure },
+    { "list?", 1, 1, builtin_is_list },
+    { "number?", 1, 1, builtin_is_number },
+    { "integer?", 1, 1, builtin_is_integer },
+    { "exact?", 1, 1, builtin_is_exact },
+    { "inexact?", 1, 1, builtin_is_inexact },
+    { "string?", 1, 1, builtin_is_string },
+    { "pair?", 1, 1, builtin_is_pair },
+    { "make-f64vector", 1, 2, builtin_make_f64vector },
+    { "f64vector", 0, -1, builtin_f64vector },
+    { "f64vector?", 1, 1, builtin_is_f64vector },
+    { "f64vector-length", 1, 1, builtin_f64vector_length },
+    { "f64vector-ref", 2, 2, builtin_f64vector_ref },
+    { "list->f64vector", 1, 1, builtin_list_to_f64vector },
+    { "f64vector->list", 1, 1, builtin_f64vector_to_list },
+    { "f64vector-sum", 1, 1, builtin_f64vector_sum },
+    { "f64vector-dot", 2, 2, builtin_f64vector_dot },
+    { "f64vector+", 2, 2, builtin_f64vector_add },
+    { "f64vector-", 2, 2, builtin_f64vector_sub },
+    { "f64vector*", 2, 2, builtin_f64vector_mul },
+    { "f64vector/", 2, 2, builtin_f64vector_div },
+    { "f64vector=", 2, 2, builtin_f64vector_eq },
+    { "f64vector<", 2, 2, builtin_f64vector_less },
+    { "f64vector>", 2, 2, builtin_f64vector_greater },
+    { "f64vector<=", 2, 2, builtin_f64vector_leq },
+    { "f64vector>=", 2, 2, builtin_f64vector_geq },
+    { "f64vector-map", 2, 2, builtin_f64vector_map },
+    { "memoize", 1, 3, builtin_memoize },
+    { "memo-hits", 1, 1, builtin_memo_hits },
+    { "memo-misses", 1, 1, builtin_memo_misses },
+    { "memo-count", 1, 1, builtin_memo_count },
+    { "make-hash-table", 0, 1, builtin_make_hash_table },
+    { "hash-table?", 1, 1, builtin_is_hash_table },
+    { "hash-table-ref", 2, 3, builtin_hash_table_ref },
+    { "hash-table-ref/default", 3, 3, builtin_hash_table_ref_default },
+    { "hash-table-contains?", 2, 2, builtin_hash_table_contains },
+    { "hash-table-set!", 3, 3, builtin_hash_table_set },
+    { "hash-table-delete!", 2, 2, builtin_hash_table_delete },
+    { "hash-table-update!", 3, 4, builtin_hash_table_update },
+    { "hash-table-update!/default", 4, 4, builtin_hash_table_update_default },
+    { "hash-table-count", 1, 1, builtin_hash_table_count },
+    { "hash-table-keys", 1, 1, builtin_hash_table_keys },
+    { "hash-table-values", 1, 1, builtin_hash_table_values },
+    { "hash-table-walk", 2, 2, builtin_hash_table_walk },
+};
+
+void register_function(struct Namespace *nsp, struct InternalFunction *fn)
+{
+    define(nsp, vsymbol(intern_cstr(fn->name)), vbuiltin(fn));
+}
+
+struct InternalFunction *find_builtin(char *name)
+{
+    for (unsigned int i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++)
+    {
+        if (strcmp(builtins[i].name, name) == 0) return &builtins[i];
+    }
+    return NULL;
+}
+
+void register_builtins(struct Namespace *nsp)
+{
+    for (unsigned int i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++)
+    {
+        register_function(nsp, &builtins[i]);
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef BUILTIN_INCLUDE
+#define BUILTIN_INCLUDE
+#include "datatype.h"
+#include "namespace.h"
+
+/* Data structures */
+
+/* Function definitions */
+
+/* Binds a builtin procedure to its name in nsp */
+void register_function(struct Namespace *nsp, struct InternalFunction *fn);
+
+/* Gets the builtin procedure with the given name, or NULL if there's none */
+struct InternalFunction *find_builtin(char *name);
+
+/* Binds all of the builtin procedures in nsp (normally the top level) */
+void register_builtins(struct Namespace *nsp);
+
+/* Utility functions */
+
+#endif
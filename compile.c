@@ -0,0 +1,811 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "builtin.h"
+#include "compile.h"
+#include "error.h"
+#include "macro.h"
+#include "namespace.h"
+#include "symbol.h"
+
+/* Internal constants */
+
+const unsigned int INIT_CODE_CAPACITY = 32;
+
+/* Most arguments a call can have and still be folded */
+#define MAX_FOLDED_ARGS 16
+
+/* Data structures */
+
+/* State for compiling one lambda body or top level form */
+struct Compiler
+{
+    struct Parser *parser;
+    struct Code *code;
+
+    /* Values on the stack when the next instruction runs */
+    unsigned int depth;
+
+    /* The globals the last fold read builtins from, as (value global
+     * builtin ...) with a placeholder for the value. NULL while compiling
+     * the code a fold falls back on, which can't depend on any */
+    struct List *guards;
+};
+
+/* Special forms get their arguments unevaluated. Each one is compiled
+ * by its own function, which leaves code that pushes its value */
+struct SpecialForm
+{
+    char *name;
+    bool (*compile)(struct Compiler *c, struct List *lst, bool tail);
+};
+
+/* Builtins with an instruction of their own for two arguments */
+struct Primitive
+{
+    char *name;
+    enum Opcode op;
+};
+
+/* Private function definitions */
+
+static bool compile_expr(struct Compiler *c, Value v, bool tail);
+static Value compile_code(struct Parser *parser, Value args, Value body);
+static Value fold(struct Compiler *c, Value v);
+static struct SpecialForm *lookup_special_form(char *name);
+
+static bool emit(struct Compiler *c, uint16_t word)
+{
+    struct Code *code = c->code;
+    if (code->length == MAX_CODE_LENGTH)
+    {
+        c->parser->error = CODE_TOO_LARGE;
+        return false;
+    }
+    if (code->length == code->capacity)
+    {
+        unsigned int capacity = code->capacity == 0 ? INIT_CODE_CAPACITY : code->capacity * 2;
+        uint16_t *ops = realloc(code->ops, capacity * sizeof(*ops));
+        if (ops == NULL) return false;
+        code->ops = ops;
+        code->capacity = capacity;
+    }
+    code->ops[code->length++] = word;
+    return true;
+}
+
+// Emits an instruction that changes the number of values on the stack
+// by effect, without its operands
+static bool emit_op(struct Compiler *c, enum Opcode op, int effect)
+{
+    c->depth += effect;
+    if (c->depth > c->code->max_stack) c->code->max_stack = c->depth;
+    return emit(c, (uint16_t)op);
+}
+
+// Gets the number of a constant, adding it if the code doesn't have it yet
+static bool constant(struct Compiler *c, Value v, uint16_t *k)
+{
+    struct List *constants = c->code->constants;
+    for (unsigned int i = 0; i < constants->size; i++)
+    {
+        if (constants->values[i] == v)
+        {
+            *k = (uint16_t)i;
+            return true;
+        }
+    }
+    if (constants->size == MAX_CODE_LENGTH)
+    {
+        c->parser->error = CODE_TOO_LARGE;
+        return false;
+    }
+    if (!append(constants, v)) return false;
+    *k = (uint16_t)(constants->size - 1);
+    return true;
+}
+
+static bool emit_with_constant(struct Compiler *c, enum Opcode op, int effect, Value v)
+{
+    uint16_t k;
+    return constant(c, v, &k) && emit_op(c, op, effect) && emit(c, k);
+}
+
+// Emits a jump whose target is filled in later by patch_jump, and
+// records where that needs to happen
+static bool emit_jump(struct Compiler *c, enum Opcode op, int effect, unsigned int *at)
+{
+    if (!emit_op(c, op, effect)) return false;
+    *at = c->code->length;
+    return emit(c, 0);
+}
+
+// Points the jump at the next instruction emitted
+static void patch_jump(struct Compiler *c, unsigned int at)
+{
+    c->code->ops[at] = (uint16_t)c->code->length;
+}
+
+// Gets the value of v if it's known without running anything, whatever
+// the builtins are bound to by then, or NO_VALUE if it isn't
+static Value static_value(struct Compiler *c, Value v)
+{
+    if (c->guards != NULL) c->guards->size = 1;
+    Value k = fold(c, v);
+    return (c->guards == NULL || c->guards->size == 1) ? k : NO_VALUE;
+}
+
+// Compiles v just to report any errors in it, then throws the code away.
+// For code that can never run
+static bool check_expr(struct Compiler *c, Value v)
+{
+    unsigned int length = c->code->length, depth = c->depth;
+    bool ok = compile_expr(c, v, false);
+    c->code->length = length;
+    c->depth = depth;
+    return ok;
+}
+
+// Compiles v, which folded to k as long as the globals in c->guards stay
+// bound to the same builtins. The code for v as written comes after, for
+// when they aren't
+static bool compile_folded(struct Compiler *c, Value v, Value k, bool tail)
+{
+    c->guards->values[0] = k;
+    struct List *lst = list_from(c->guards->values, c->guards->size);
+    if (lst == NULL) return false;
+    Value guards = vlist(lst);
+    if (guards == NO_VALUE)
+    {
+        delete_list(lst);
+        return false;
+    }
+
+    unsigned int to_end;
+    uint16_t n;
+    if (!constant(c, guards, &n) || !emit_op(c, OP_FOLDED, 1) || !emit(c, n))
+    {
+        return false;
+    }
+    to_end = c->code->length;
+    if (!emit(c, 0)) return false;
+
+    // Either way there's one value on the stack at the end
+    c->depth--;
+    struct List *saved = c->guards;
+    c->guards = NULL;
+    bool ok = compile_expr(c, v, tail);
+    c->guards = saved;
+    if (ok) patch_jump(c, to_end);
+    return ok;
+}
+
+/* Special forms */
+
+static bool compile_define(struct Compiler *c, struct List *lst, bool tail)
+{
+    (void)tail;
+    if (lst->size != 3)
+    {
+        c->parser->error = INCORRECT_NUMBER_OF_ARGS;
+        return false;
+    }
+    Value name = list_lookup(lst, 1);
+    if (type_of(name) != SYMBOL)
+    {
+        c->parser->error = EXPECTED_LIST_OR_SYMBOL;
+        return false;
+    }
+
+    // Declared *first* so we can recursively call if need be
+    return emit_with_constant(c, OP_DECLARE, 0, name)
+        && compile_expr(c, list_lookup(lst, 2), false)
+        && emit_with_constant(c, OP_DEFINE, 0, name);
+}
+
+// The macro is made here, but bound when the form runs, like a define.
+// Uses of it are expanded by the resolver (see resolve.h)
+static bool compile_define_syntax(struct Compiler *c, struct List *lst, bool tail)
+{
+    (void)tail;
+    if (lst->size != 3)
+    {
+        c->parser->error = INCORRECT_NUMBER_OF_ARGS;
+        return false;
+    }
+    Value name = list_lookup(lst, 1);
+    if (type_of(name) != SYMBOL)
+    {
+        c->parser->error = EXPECTED_SYMBOL;
+        return false;
+    }
+    Value macro = make_macro(c->parser, list_lookup(lst, 2));
+    return macro != NO_VALUE
+        && emit_with_constant(c, OP_CONST, 1, macro)
+        && emit_with_constant(c, OP_DEFINE, 0, name);
+}
+
+static bool compile_set(struct Compiler *c, struct List *lst, bool tail)
+{
+    (void)tail;
+    if (lst->size != 3)
+    {
+        c->parser->error = INCORRECT_NUMBER_OF_ARGS;
+        return false;
+    }
+    Value name = list_lookup(lst, 1);
+    if (type_of(name) != LOCAL && type_of(name) != GLOBAL && type_of(name) != SYMBOL)
+    {
+        c->parser->error = EXPECTED_SYMBOL;
+        return false;
+    }
+    if (!compile_expr(c, list_lookup(lst, 2), false)) return false;
+
+    if (type_of(name) == LOCAL)
+    {
+        return emit_op(c, OP_SET_LOCAL, 0)
+            && emit(c, as_object(name)->local.depth)
+            && emit(c, as_object(name)->local.slot);
+    }
+    return emit_with_constant(c, type_of(name) == GLOBAL ? OP_SET_GLOBAL : OP_SET_DYNAMIC, 0, name);
+}
+
+static bool compile_lambda(struct Compiler *c, struct List *lst, bool tail)
+{
+    (void)tail;
+    if (lst->size != 3)
+    {
+        c->parser->error = INCORRECT_NUMBER_OF_ARGS;
+        return false;
+    }
+    Value args = list_lookup(lst, 1);
+    if (type_of(args) == PAIR)
+    {
+        args = flatten_list(args);
+        if (args == NO_VALUE) return false;
+    }
+    if (type_of(args) == LIST)
+    {
+        struct List *params = as_list(args);
+        for (unsigned int i = 0; i < params->size; i++)
+        {
+            if (type_of(list_lookup(params, i)) != SYMBOL)
+            {
+                c->parser->error = EXPECTED_SYMBOL;
+                return false;
+            }
+        }
+        // Each parameter gets its own slot in the call frame
+        for (unsigned int i = 0; i < params->size; i++)
+        {
+            for (unsigned int j = i + 1; j < params->size; j++)
+            {
+                if (params->values[i] == params->values[j])
+                {
+                    c->parser->error = DUPLICATE_PARAMETER;
+                    return false;
+                }
+            }
+        }
+    }
+    else if (type_of(args) != SYMBOL)
+    {
+        c->parser->error = EXPECTED_LIST_OR_SYMBOL;
+        return false;
+    }
+
+    // The body is compiled once, here, and shared by every procedure
+    // this lambda makes
+    Value code = compile_code(c->parser, args, list_lookup(lst, 2));
+    if (code == NO_VALUE) return false;
+    return emit_with_constant(c, OP_LAMBDA, 1, code);
+}
+
+static bool compile_if(struct Compiler *c, struct List *lst, bool tail)
+{
+    if (lst->size < 3 || lst->size > 4)
+    {
+        c->parser->error = INCORRECT_NUMBER_OF_ARGS;
+        return false;
+    }
+    // If the test is known, only the branch it picks is kept. The other
+    // one is still compiled, for its errors
+    Value test = static_value(c, list_lookup(lst, 1));
+    if (test != NO_VALUE)
+    {
+        unsigned int taken = (test != FALSE_VALUE) ? 2 : 3, dead = 5 - taken;
+        if (dead < lst->size && !check_expr(c, list_lookup(lst, dead))) return false;
+        if (taken < lst->size) return compile_expr(c, list_lookup(lst, taken), tail);
+        return emit_op(c, OP_NONE, 1);
+    }
+
+    unsigned int to_else, to_end;
+    if (!compile_expr(c, list_lookup(lst, 1), false)
+            || !emit_jump(c, OP_JUMP_IF_FALSE, -1, &to_else)
+            || !compile_expr(c, list_lookup(lst, 2), tail)
+            || !emit_jump(c, OP_JUMP, 0, &to_end))
+    {
+        return false;
+    }
+
+    // Only one branch runs, so the else branch starts where the then
+    // branch did
+    c->depth--;
+    patch_jump(c, to_else);
+    if (lst->size == 4)
+    {
+        if (!compile_expr(c, list_lookup(lst, 3), tail)) return false;
+    }
+    else if (!emit_op(c, OP_NONE, 1))
+    {
+        return false;
+    }
+    patch_jump(c, to_end);
+    return true;
+}
+
+static bool compile_quote(struct Compiler *c, struct List *lst, bool tail)
+{
+    (void)tail;
+    if (lst->size != 2)
+    {
+        c->parser->error = INCORRECT_NUMBER_OF_ARGS;
+        return false;
+    }
+    return emit_with_constant(c, OP_CONST, 1, list_lookup(lst, 1));
+}
+
+static bool compile_begin(struct Compiler *c, struct List *lst, bool tail);
+
+// Compiles the expressions in a begin, splicing in any begins nested
+// before the last one. Only the last value is kept, so constants before
+// it are left out. *pushed is set once something has left a value
+static bool compile_sequence(struct Compiler *c, struct List *lst, bool tail, bool last, bool *pushed)
+{
+    for (unsigned int i = 1; i < lst->size; i++)
+    {
+        Value v = list_lookup(lst, i);
+        bool is_last = last && i == lst->size - 1;
+        if (!is_last && type_of(v) == LIST && !is_empty(as_list(v))
+                && type_of(list_lookup(as_list(v), 0)) == SYMBOL)
+        {
+            struct SpecialForm *form = lookup_special_form(as_symbol(list_lookup(as_list(v), 0)));
+            if (form != NULL && form->compile == compile_begin)
+            {
+                if (!compile_sequence(c, as_list(v), false, false, pushed)) return false;
+                continue;
+            }
+        }
+        if (!is_last && static_value(c, v) != NO_VALUE) continue;
+
+        if (*pushed && !emit_op(c, OP_POP, -1)) return false;
+        if (!compile_expr(c, v, tail && is_last)) return false;
+        *pushed = true;
+    }
+    return true;
+}
+
+static bool compile_begin(struct Compiler *c, struct List *lst, bool tail)
+{
+    if (lst->size == 1) return emit_op(c, OP_NONE, 1);
+
+    bool pushed = false;
+    return compile_sequence(c, lst, tail, true, &pushed);
+}
+
+// and/or stop at the first operand that settles the answer and return
+// it. The last operand is in tail position. Only #f counts as false
+static bool compile_bin_bool(struct Compiler *c, struct List *lst, bool tail, enum Opcode op, bool init)
+{
+    if (lst->size == 1) return emit_with_constant(c, OP_CONST, 1, vboolean(init));
+
+    unsigned int *to_end = malloc(lst->size * sizeof(*to_end));
+    if (to_end == NULL) return false;
+    bool ok = true;
+    unsigned int i, jumps = 0;
+    Value settled = NO_VALUE;
+    for (i = 1; i < lst->size - 1 && ok; i++)
+    {
+        // A constant operand either doesn't change the answer, and is left
+        // out, or settles it, and the rest can't run
+        Value k = static_value(c, list_lookup(lst, i));
+        if (k == NO_VALUE)
+        {
+            ok = compile_expr(c, list_lookup(lst, i), false)
+                && emit_jump(c, op, -1, &to_end[jumps++]);
+        }
+        else if ((k != FALSE_VALUE) != (op == OP_AND))
+        {
+            settled = k;
+            break;
+        }
+    }
+    if (ok && settled != NO_VALUE)
+    {
+        ok = emit_with_constant(c, OP_CONST, 1, settled);
+        for (i++; i < lst->size && ok; i++) ok = check_expr(c, list_lookup(lst, i));
+    }
+    else
+    {
+        ok = ok && compile_expr(c, list_lookup(lst, lst->size - 1), tail);
+    }
+    if (ok)
+    {
+        for (i = 0; i < jumps; i++) patch_jump(c, to_end[i]);
+    }
+    free(to_end);
+    return ok;
+}
+
+static bool compile_and(struct Compiler *c, struct List *lst, bool tail)
+{
+    return compile_bin_bool(c, lst, tail, OP_AND, true);
+}
+
+static bool compile_or(struct Compiler *c, struct List *lst, bool tail)
+{
+    return compile_bin_bool(c, lst, tail, OP_OR, false);
+}
+
+// Whoa, meta
+static bool compile_eval(struct Compiler *c, struct List *lst, bool tail)
+{
+    if (lst->size != 2)
+    {
+        c->parser->error = INCORRECT_NUMBER_OF_ARGS;
+        return false;
+    }
+    return compile_expr(c, list_lookup(lst, 1), false)
+        && emit_op(c, tail ? OP_TAIL_EVAL : OP_EVAL, 0);
+}
+
+static bool compile_load(struct Compiler *c, struct List *lst, bool tail)
+{
+    (void)tail;
+    if (lst->size != 2)
+    {
+        c->parser->error = INCORRECT_NUMBER_OF_ARGS;
+        return false;
+    }
+    return compile_expr(c, list_lookup(lst, 1), false)
+        && emit_op(c, OP_LOAD, 0);
+}
+
+static struct SpecialForm special_forms[] = {
+    { "define", compile_define },
+    { "define-syntax", compile_define_syntax },
+    { "set!", compile_set },
+    { "lambda", compile_lambda },
+    { "if", compile_if },
+    { "quote", compile_quote },
+    { "begin", compile_begin },
+    { "and", compile_and },
+    { "or", compile_or },
+    { "eval", compile_eval },
+    { "load", compile_load },
+};
+
+static struct Primitive primitives[] = {
+    { "+", OP_ADD },
+    { "-", OP_SUB },
+    { "=", OP_NUM_EQ },
+    { "<", OP_LT },
+    { ">", OP_GT },
+    { "<=", OP_LEQ },
+    { ">=", OP_GEQ },
+};
+
+/* Builtins without side effects, which give the same answer whenever
+ * they're called with the same constants. Calls to them can be folded */
+static char *foldable_names[] = {
+    "+", "-", "*", "quotient", "remainder", "modulo",
+    "=", "<", ">", "<=", ">=", "not",
+};
+
+#define NUM_SPECIAL_FORMS (sizeof(special_forms) / sizeof(special_forms[0]))
+#define NUM_PRIMITIVES (sizeof(primitives) / sizeof(primitives[0]))
+#define NUM_FOLDABLE (sizeof(foldable_names) / sizeof(foldable_names[0]))
+
+static struct InternalFunction *foldable[NUM_FOLDABLE];
+
+// Must be a power of two, and comfortably bigger than NUM_SPECIAL_FORMS
+#define SPECIAL_FORM_TABLE_SIZE 64
+
+/* Dispatch table from interned name to special form, open addressing.
+ * The names in special_forms (and primitives) are replaced by their
+ * interned copies */
+static struct SpecialForm *special_form_table[SPECIAL_FORM_TABLE_SIZE];
+static bool special_forms_registered = false;
+
+static inline unsigned int special_form_slot(char *name)
+{
+    return (unsigned int)(((uintptr_t)name >> 3) * 2654435761u) & (SPECIAL_FORM_TABLE_SIZE - 1);
+}
+
+static void register_special_forms(void)
+{
+    for (unsigned int i = 0; i < NUM_SPECIAL_FORMS; i++)
+    {
+        special_forms[i].name = intern_cstr(special_forms[i].name);
+        unsigned int slot = special_form_slot(special_forms[i].name);
+        while (special_form_table[slot] != NULL)
+        {
+            slot = (slot + 1) & (SPECIAL_FORM_TABLE_SIZE - 1);
+        }
+        special_form_table[slot] = &special_forms[i];
+    }
+    for (unsigned int i = 0; i < NUM_PRIMITIVES; i++)
+    {
+        primitives[i].name = intern_cstr(primitives[i].name);
+    }
+    for (unsigned int i = 0; i < NUM_FOLDABLE; i++)
+    {
+        foldable[i] = find_builtin(foldable_names[i]);
+    }
+    special_forms_registered = true;
+}
+
+static struct SpecialForm *lookup_special_form(char *name)
+{
+    if (!special_forms_registered) register_special_forms();
+    unsigned int slot = special_form_slot(name);
+    for (; special_form_table[slot] != NULL; slot = (slot + 1) & (SPECIAL_FORM_TABLE_SIZE - 1))
+    {
+        if (special_form_table[slot]->name == name)
+        {
+            return special_form_table[slot];
+        }
+    }
+    return NULL;
+}
+
+// Gets the primitive a call goes through, or NULL for an ordinary call.
+// Only calls to a global name with two arguments qualify
+static struct Primitive *lookup_primitive(struct List *lst)
+{
+    Value first = list_lookup(lst, 0);
+    if (lst->size != 3) return NULL;
+    char *name;
+    if (type_of(first) == GLOBAL)
+        name = as_object(first)->global.cell->name;
+    else if (type_of(first) == SYMBOL)
+        name = as_symbol(first);
+    else
+        return NULL;
+
+    if (!special_forms_registered) register_special_forms();
+    for (unsigned int i = 0; i < NUM_PRIMITIVES; i++)
+    {
+        if (primitives[i].name == name) return &primitives[i];
+    }
+    return NULL;
+}
+
+/* Folding */
+
+// Folds a call to a global that's bound to a foldable builtin, recording
+// the global in c->guards
+static Value fold_call(struct Compiler *c, struct List *lst)
+{
+    Value first = list_lookup(lst, 0);
+    if (c->guards == NULL || type_of(first) != GLOBAL) return NO_VALUE;
+    Value f = as_object(first)->global.cell->value;
+    if (f == NO_VALUE || f == UNBOUND || type_of(f) != BUILTIN) return NO_VALUE;
+
+    struct InternalFunction *fn = as_builtin(f);
+    unsigned int argc = lst->size - 1;
+    bool pure = false;
+    if (!special_forms_registered) register_special_forms();
+    for (unsigned int i = 0; i < NUM_FOLDABLE; i++)
+    {
+        if (foldable[i] == fn) pure = true;
+    }
+    if (!pure || argc > MAX_FOLDED_ARGS || argc < (unsigned int)fn->min_args
+            || (fn->max_args != -1 && argc > (unsigned int)fn->max_args))
+    {
+        return NO_VALUE;
+    }
+
+    Value argv[MAX_FOLDED_ARGS];
+    for (unsigned int i = 0; i < argc; i++)
+    {
+        argv[i] = fold(c, list_lookup(lst, i + 1));
+        if (argv[i] == NO_VALUE) return NO_VALUE;
+    }
+    // Calls that fail (say, adding a string) are left to fail when they run
+    Value v = fn->function_ptr(c->parser, argc, argv);
+    if (c->parser->error != NO_ERROR)
+    {
+        c->parser->error = NO_ERROR;
+        return NO_VALUE;
+    }
+    if (v == NO_VALUE) return NO_VALUE;
+
+    for (unsigned int i = 1; i < c->guards->size; i += 2)
+    {
+        if (c->guards->values[i] == first) return v;
+    }
+    return (append(c->guards, first) && append(c->guards, f)) ? v : NO_VALUE;
+}
+
+// Works out the value of v if it only depends on constants and calls that
+// can be folded, or gives NO_VALUE. The globals those calls read are
+// added to c->guards
+static Value fold(struct Compiler *c, Value v)
+{
+    switch (type_of(v))
+    {
+        case SYMBOL:
+        case GLOBAL:
+        case LOCAL:
+        case PAIR:
+            return NO_VALUE;
+        case LIST:
+            break;
+        default:
+            return v;
+    }
+
+    struct List *lst = as_list(v);
+    if (is_empty(lst)) return NO_VALUE;
+    Value first = list_lookup(lst, 0);
+    if (type_of(first) != SYMBOL) return fold_call(c, lst);
+    struct SpecialForm *form = lookup_special_form(as_symbol(first));
+    if (form == NULL) return NO_VALUE;
+
+    if (form->compile == compile_quote)
+    {
+        return (lst->size == 2) ? list_lookup(lst, 1) : NO_VALUE;
+    }
+    else if (form->compile == compile_if)
+    {
+        if (lst->size < 3 || lst->size > 4) return NO_VALUE;
+        Value test = fold(c, list_lookup(lst, 1));
+        if (test == NO_VALUE) return NO_VALUE;
+        unsigned int taken = (test != FALSE_VALUE) ? 2 : 3;
+        return (taken < lst->size) ? fold(c, list_lookup(lst, taken)) : NO_VALUE;
+    }
+    else if (form->compile == compile_begin || form->compile == compile_and
+            || form->compile == compile_or)
+    {
+        // and/or stop at the first operand that settles the answer
+        Value k = (form->compile == compile_or) ? FALSE_VALUE : TRUE_VALUE;
+        if (form->compile == compile_begin && lst->size == 1) return NO_VALUE;
+        for (unsigned int i = 1; i < lst->size; i++)
+        {
+            k = fold(c, list_lookup(lst, i));
+            if (k == NO_VALUE) return NO_VALUE;
+            if (form->compile == compile_and && k == FALSE_VALUE) break;
+            if (form->compile == compile_or && k != FALSE_VALUE) break;
+        }
+        return k;
+    }
+    return NO_VALUE;
+}
+
+static bool compile_call(struct Compiler *c, struct List *lst, bool tail)
+{
+    unsigned int argc = lst->size - 1;
+    if (argc > MAX_CODE_LENGTH)
+    {
+        c->parser->error = CODE_TOO_LARGE;
+        return false;
+    }
+
+    struct Primitive *prim = lookup_primitive(lst);
+    if (prim != NULL)
+    {
+        // If it turns into an ordinary call, the procedure is put under
+        // the arguments, so leave room for it
+        if (!compile_expr(c, list_lookup(lst, 1), false)
+                || !compile_expr(c, list_lookup(lst, 2), false)
+                || !emit_with_constant(c, prim->op, 1, list_lookup(lst, 0)))
+        {
+            return false;
+        }
+        c->depth -= 2;
+        return true;
+    }
+
+    for (unsigned int i = 0; i < lst->size; i++)
+    {
+        if (!compile_expr(c, list_lookup(lst, i), false)) return false;
+    }
+    return emit_op(c, tail ? OP_TAIL_CALL : OP_CALL, -(int)argc)
+        && emit(c, (uint16_t)argc);
+}
+
+static bool compile_expr(struct Compiler *c, Value v, bool tail)
+{
+    if (v == NO_VALUE)
+    {
+        c->parser->error = CANT_EVAL_UNDEF;
+        return false;
+    }
+    switch (type_of(v))
+    {
+        case SYMBOL:
+            return emit_with_constant(c, OP_DYNAMIC, 1, v);
+        case GLOBAL:
+            return emit_with_constant(c, OP_GLOBAL, 1, v);
+        case LOCAL:
+            return emit_op(c, OP_LOCAL, 1)
+                && emit(c, as_object(v)->local.depth)
+                && emit(c, as_object(v)->local.slot);
+        case PAIR:
+            // Code built at run time with cons. Parsed code is never pairs
+            v = flatten_list(v);
+            if (v == NO_VALUE) return false;
+            break;
+        case LIST:
+            break;
+        default:
+            return emit_with_constant(c, OP_CONST, 1, v);
+    }
+
+    struct List *lst = as_list(v);
+    if (is_empty(lst))
+    {
+        // should throw error or something
+        return emit_op(c, OP_NONE, 1);
+    }
+    Value first = list_lookup(lst, 0);
+    struct SpecialForm *form = NULL;
+    if (type_of(first) == SYMBOL) form = lookup_special_form(as_symbol(first));
+
+    // Special forms simplify themselves, so only calls are folded here.
+    // So are ifs whose tests fold through builtins, which compile_if
+    // can't prune for good
+    if (c->guards != NULL && (form == NULL || form->compile == compile_if))
+    {
+        c->guards->size = 1;
+        Value k = fold(c, v);
+        if (k != NO_VALUE && (form == NULL || c->guards->size > 1))
+        {
+            return compile_folded(c, v, k, tail);
+        }
+    }
+    if (form != NULL) return form->compile(c, lst, tail);
+    return compile_call(c, lst, tail);
+}
+
+// Compiles body into a CODE value that leaves its value on the stack
+// and returns. args are the parameters of the lambda it belongs to
+static Value compile_code(struct Parser *parser, Value args, Value body)
+{
+    struct Code *code = new_code(args, body);
+    if (code == NULL) return NO_VALUE;
+    if (args != NO_VALUE && type_of(args) == SYMBOL)
+    {
+        code->variadic = true;
+    }
+    else if (args != NO_VALUE)
+    {
+        code->nparams = (unsigned short)as_list(args)->size;
+    }
+
+    // Folds start with a placeholder for the value they come to
+    struct Compiler c = { parser, code, 0, list() };
+    bool ok = c.guards != NULL && append(c.guards, FALSE_VALUE)
+        && compile_expr(&c, body, true) && emit_op(&c, OP_RETURN, -1);
+    if (c.guards != NULL) delete_list(c.guards);
+    if (!ok)
+    {
+        delete_code(code);
+        return NO_VALUE;
+    }
+    Value v = vcode(code);
+    if (v == NO_VALUE) delete_code(code);
+    return v;
+}
+
+/* Public functions */
+
+Value compile(struct Parser *parser, Value form)
+{
+    return compile_code(parser, NO_VALUE, form);
+}
+
+bool is_special_form(char *symbol)
+{
+    return lookup_special_form(symbol) != NULL;
+}
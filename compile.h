@@ -0,0 +1,67 @@
+#ifndef COMPILE
+#define COMPILE
+
+#include "datatype.h"
+#include "parser.h"
+
+/* Constants */
+
+/* Most instructions (or constants) one piece of code can hold, since
+ * jump targets and constant numbers are 16 bit operands */
+#define MAX_CODE_LENGTH 65535
+
+/* Instructions are 16 bit words: an opcode followed by its operands.
+ * Every expression leaves exactly one value on the stack, which is
+ * NO_VALUE for expressions that don't return anything (define, set!, ...) */
+enum Opcode
+{
+    OP_CONST,         /* k: push constant k */
+    OP_NONE,          /* push NO_VALUE */
+    OP_LOCAL,         /* depth slot: push a resolved variable (see resolve.h) */
+    OP_GLOBAL,        /* k: push the global whose cell is in constant k */
+    OP_DYNAMIC,       /* k: push the variable named by constant k */
+    OP_SET_LOCAL,     /* depth slot: pop into a resolved variable, push NO_VALUE */
+    OP_SET_GLOBAL,    /* k: pop into the global whose cell is in constant k, push NO_VALUE */
+    OP_SET_DYNAMIC,   /* k: pop into the variable named by constant k, push NO_VALUE */
+    OP_DECLARE,       /* k: bind the name in constant k to NO_VALUE in this frame */
+    OP_DEFINE,        /* k: pop and bind to the name in constant k, push NO_VALUE */
+    OP_POP,           /* drop the top of the stack */
+    OP_JUMP,          /* target: continue at target */
+    OP_JUMP_IF_FALSE, /* target: pop, continue at target if it was #f */
+    OP_AND,           /* target: if the top is #f, continue at target, else pop */
+    OP_OR,            /* target: if the top isn't #f, continue at target, else pop */
+    OP_FOLDED,        /* k target: constant k is (value global builtin ...). If every
+                       * global is still bound to the builtin after it, push the value
+                       * and continue at target. Otherwise run the code that follows */
+    OP_LAMBDA,        /* k: push a procedure made from the code in constant k */
+    OP_CALL,          /* argc: call the procedure under argc arguments */
+    OP_TAIL_CALL,     /* argc: same, but the new call replaces this one */
+    OP_RETURN,        /* return the top of the stack to the caller */
+    OP_EVAL,          /* compile and run the top of the stack */
+    OP_TAIL_EVAL,     /* same, in place of this call */
+    OP_LOAD,          /* load the file named by the top of the stack */
+
+    /* k: pop two arguments and apply the builtin constant k refers to
+     * (a global or a name, as for OP_GLOBAL and OP_DYNAMIC).
+     * Numbers (exact or not) are handled inline as long as the name is
+     * still bound to the builtin, anything else is an ordinary call */
+    OP_ADD,
+    OP_SUB,
+    OP_NUM_EQ,
+    OP_LT,
+    OP_GT,
+    OP_LEQ,
+    OP_GEQ
+};
+
+/* Function definitions */
+
+/* Compiles a (resolved) top level form into a CODE value that computes
+ * it. Returns NO_VALUE and sets parser->error on failure */
+Value compile(struct Parser *parser, Value form);
+
+/* Checks if symbol names a special form (define, if, lambda, ...),
+ * which gets its arguments unevaluated */
+bool is_special_form(char *symbol);
+
+#endif
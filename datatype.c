@@ -1,11 +1,13 @@
 #include <stdlib.h> 
 #include <limits.h>
+#include <string.h>
 #include "datatype.h"
+#include "hashtable.h"
+#include "memo.h"
 
 /* Internal constants */
 
 const unsigned int MAX_LIST_CAPACITY = UINT_MAX;
-const unsigned char INIT_LIST_CAPACITY = 8;
 
 /* Forward declarations */
 
@@ -26,29 +28,36 @@ static int grow_list(struct List *lst);
  */
 static int shrink_list(struct List *lst);
 
-/* Deletes list and all of its contents */
-void delete_list(struct List *lst);
+struct List empty_list = { 0, 0, NULL, NO_VALUE };
 
-struct List *list(void)
+// Makes an empty list with room for capacity elements in its storage
+static struct List *new_list(unsigned int capacity)
 {
-    struct List *lst;
-    lst = malloc(sizeof(*lst));
-    if (lst == NULL)
-    {
-        return NULL;
-    }
-    lst->values = calloc(INIT_LIST_CAPACITY, sizeof(*(lst->values)));
-    if (lst->values == NULL)
-    {
-        free(lst);
-        return NULL;
-    }
+    struct List *lst = malloc(sizeof(*lst) + capacity * sizeof(Value));
+    if (lst == NULL) return NULL;
     lst->size = 0;
-    lst->capacity = INIT_LIST_CAPACITY;
+    lst->capacity = capacity;
+    lst->values = lst->storage;
+    lst->owner = NO_VALUE;
+    return lst;
+}
+
+struct List *list(void)
+{
+    return new_list(INIT_LIST_CAPACITY);
+}
+
+struct List *list_from(const Value *values, unsigned int size)
+{
+    // Never zero elements, so an empty list still has room to grow
+    struct List *lst = new_list(size == 0 ? 1 : size);
+    if (lst == NULL) return NULL;
+    memcpy(lst->storage, values, size * sizeof(*values));
+    lst->size = size;
     return lst;
 }
 
-bool append(struct List *lst, struct Value *v)
+bool append(struct List *lst, Value v)
 {
     if (lst->size == lst->capacity)
     {
@@ -62,11 +71,11 @@ bool append(struct List *lst, struct Value *v)
     return true;
 }
 
-struct Value *pop(struct List *lst)
+Value pop(struct List *lst)
 {
     if (lst->size == 0)
     {
-        return NULL;
+        return NO_VALUE;
     }
     // Only shrink if we're reasonably sure we won't need to grow again soon
     else if (lst->size < lst->capacity / (GROWTH_FACTOR * GROWTH_FACTOR))
@@ -75,49 +84,179 @@ struct Value *pop(struct List *lst)
         shrink_list(lst); 
     }
     lst->size--;
-    struct Value *v = lst->values[lst->size];
-    lst->values[lst->size] = NULL;
+    Value v = lst->values[lst->size];
+    if (lst->owner == NO_VALUE) lst->values[lst->size] = NO_VALUE;
     return v;
 }
 
-void delete_value(struct Value *v)
+void release_object(struct Object *o)
 {
-    if (v == NULL) return;
-    switch (v->type)
+    switch (o->type)
     {
         case LIST:
-            delete_list(v->list);
-            break;
-        case SYMBOL:
-            free(v->symbol);
+            delete_list(o->list);
             break;
         case STRING:
-            delete_list(v->string);
+            delete_scm_string(o->string);
             break;
-        case PROCEDURE:
-            delete_list(v->proc);
+        case CODE:
+            delete_code(o->code);
             break;
-        default: // Num, bool, and char
+        case F64VECTOR:
+            delete_f64vector(o->f64vector);
+            break;
+        case NUMBER:
+            delete_bignum(o->bignum);
+            break;
+        case MEMO:
+            delete_memo(o->memo);
+            break;
+        case HASH_TABLE:
+            delete_hash_table(o->table);
+            break;
+        default: // Procedures, builtins and local references own nothing
             break;
     }
-    free(v);
 }
 
 void delete_list(struct List *lst)
 {
     if (lst == NULL) return;
-    for (unsigned int i = 0; i < lst->size; i++)
+    if (lst->owner == NO_VALUE && lst->values != lst->storage) free(lst->values);
+    free(lst);
+}
+
+Value list_tail(Value v)
+{
+    struct List *lst = as_list(v);
+    if (lst->size == 1) return EMPTY_LIST;
+
+    struct List *tail = malloc(sizeof(*tail));
+    if (tail == NULL) return NO_VALUE;
+    tail->size = lst->size - 1;
+    tail->capacity = tail->size;
+    tail->values = lst->values + 1;
+
+    // Always share with the list that owns the values, so a long walk
+    // down a list doesn't leave a chain of tails behind it
+    tail->owner = (lst->owner == NO_VALUE) ? v : lst->owner;
+
+    struct Object *o;
+    Value t = vobject(LIST, sizeof(*tail), &o);
+    if (t == NO_VALUE)
     {
-        delete_value(lst->values[i]);
+        free(tail);
+        return NO_VALUE;
     }
-    free(lst->values);
-    free(lst);
+    o->list = tail;
+    return t;
 }
 
-/* Shallow copy size elements from src to tgt. Assumes both lists have at least size elements. */
-static void inline copy_values(struct Value **tgt, struct Value **src, unsigned int size)
+Value flatten_list(Value v)
 {
-    for (unsigned int i = 0; i < size; i++) tgt[i] = src[i];
+    if (type_of(v) == LIST) return v;
+
+    struct List *lst = list();
+    if (lst == NULL) return NO_VALUE;
+    for (; type_of(v) == PAIR; v = as_pair(v)->cdr)
+    {
+        append(lst, as_pair(v)->car);
+    }
+    struct List *rest = as_list(v);
+    for (unsigned int i = 0; i < rest->size; i++)
+    {
+        append(lst, rest->values[i]);
+    }
+    return vlist(lst);
+}
+
+struct F64Vector *new_f64vector(unsigned int length)
+{
+    struct F64Vector *vec = malloc(sizeof(*vec));
+    if (vec == NULL) return NULL;
+    // Never zero bytes, so an empty vector still gets a buffer
+    vec->data = calloc(length == 0 ? 1 : length, sizeof(*vec->data));
+    if (vec->data == NULL)
+    {
+        free(vec);
+        return NULL;
+    }
+    vec->length = length;
+    return vec;
+}
+
+void delete_f64vector(struct F64Vector *vec)
+{
+    if (vec == NULL) return;
+    free(vec->data);
+    free(vec);
+}
+
+void delete_bignum(struct Bignum *big)
+{
+    if (big == NULL) return;
+    free(big->digits);
+    free(big);
+}
+
+Value bignum_from_int64(int64_t n)
+{
+    struct Bignum *big = malloc(sizeof(*big));
+    if (big == NULL) return NO_VALUE;
+    big->digits = malloc(2 * sizeof(*big->digits));
+    if (big->digits == NULL)
+    {
+        free(big);
+        return NO_VALUE;
+    }
+    // Negated as unsigned, since INT64_MIN has no positive counterpart
+    uint64_t magnitude = (n < 0) ? -(uint64_t)n : (uint64_t)n;
+    big->negative = (n < 0);
+    big->digits[0] = (uint32_t)magnitude;
+    big->digits[1] = (uint32_t)(magnitude >> 32);
+    big->length = (big->digits[1] == 0) ? 1 : 2;
+    Value v = vbignum(big);
+    if (v == NO_VALUE) delete_bignum(big);
+    return v;
+}
+
+double bignum_to_double(struct Bignum *big)
+{
+    double d = 0;
+    for (unsigned int i = big->length; i > 0; i--)
+    {
+        d = d * 4294967296.0 + big->digits[i - 1];
+    }
+    return big->negative ? -d : d;
+}
+
+struct Code *new_code(Value args, Value body)
+{
+    struct Code *code = malloc(sizeof(*code));
+    if (code == NULL) return NULL;
+    code->constants = list();
+    if (code->constants == NULL)
+    {
+        free(code);
+        return NULL;
+    }
+    code->ops = NULL;
+    code->length = 0;
+    code->capacity = 0;
+    code->args = args;
+    code->body = body;
+    code->nparams = 0;
+    code->variadic = false;
+    code->max_stack = 0;
+    return code;
+}
+
+void delete_code(struct Code *code)
+{
+    if (code == NULL) return;
+    free(code->ops);
+    delete_list(code->constants);
+    free(code);
 }
 
 static int grow_list(struct List *lst)
@@ -126,21 +265,33 @@ static int grow_list(struct List *lst)
     if (lst->capacity > (MAX_LIST_CAPACITY / GROWTH_FACTOR)) return 0;
 
     unsigned int new_capacity = lst->capacity * GROWTH_FACTOR;
-    struct Value **values = calloc(new_capacity, sizeof(*values));
-    if (values == NULL) return 0;
-
-    // Copy over the elements
-    copy_values(values, lst->values, lst->size);
-
-    // Update values in the list
-    free(lst->values);
+    Value *values;
+    if (lst->values == lst->storage || lst->owner != NO_VALUE)
+    {
+        // The elements are in storage or borrowed, so they move out to a
+        // block of the list's own
+        values = malloc(new_capacity * sizeof(*values));
+        if (values == NULL) return 0;
+        memcpy(values, lst->values, lst->size * sizeof(*values));
+    }
+    else
+    {
+        // realloc can usually grow the block where it is (big ones are
+        // remapped rather than copied)
+        values = realloc(lst->values, new_capacity * sizeof(*values));
+        if (values == NULL) return 0;
+    }
     lst->values = values;
     lst->capacity = new_capacity;
+    lst->owner = NO_VALUE;
     return 1;
 }
 
 static int shrink_list(struct List *lst)
 {
+    // Only a block of the list's own can give memory back
+    if (lst->values == lst->storage || lst->owner != NO_VALUE) return 0;
+
     unsigned int new_capacity;
     if (lst->capacity / GROWTH_FACTOR < INIT_LIST_CAPACITY)
     {
@@ -151,111 +302,65 @@ static int shrink_list(struct List *lst)
         new_capacity = lst->capacity / GROWTH_FACTOR;
     }
 
-    struct Value **values = calloc(new_capacity, sizeof(*values));
+    Value *values = realloc(lst->values, new_capacity * sizeof(*values));
     if (values == NULL)
     {
         return 0;
     }
-
-    // Copy over the elements
-    copy_values(values, lst->values, lst->size);
-
-    // Update values in the list
-    free(lst->values);
     lst->values = values;
     lst->capacity = new_capacity;
     return 1;
 }
 
-ScmString *to_scm_string(char *str)
+ScmString *scm_string(const char *chars, unsigned int length)
 {
-    ScmString *lst = list();
-    if (lst == NULL) return NULL;
-    struct Value *v;
-    for (; *str != '\0'; str++)
+    ScmString *sstr = malloc(sizeof(*sstr));
+    if (sstr == NULL) return NULL;
+    sstr->chars = malloc(length + 1);
+    if (sstr->chars == NULL)
     {
-        v = vcharacter(*str);
-        if (v == NULL) 
-        {
-            delete_list(lst);
-            return NULL;
-        }
-        if (!append(lst, v)) 
-        {
-            delete_value(v);
-            delete_list(lst);
-            return NULL;
-        }
+        free(sstr);
+        return NULL;
     }
-    return lst;
+    memcpy(sstr->chars, chars, length);
+    sstr->chars[length] = '\0';
+    sstr->length = length;
+    sstr->capacity = length + 1;
+    return sstr;
 }
 
-char *from_scm_string(ScmString *sstr)
+bool string_append(ScmString *sstr, char c)
 {
-    if (sstr == NULL)
+    // Always leave room for the null terminator
+    if (sstr->length + 1 == sstr->capacity)
     {
-        return NULL;
+        if (sstr->capacity > (MAX_LIST_CAPACITY / GROWTH_FACTOR)) return false;
+        unsigned int new_capacity = sstr->capacity < INIT_LIST_CAPACITY
+            ? INIT_LIST_CAPACITY
+            : sstr->capacity * GROWTH_FACTOR;
+        char *chars = realloc(sstr->chars, new_capacity);
+        if (chars == NULL) return false;
+        sstr->chars = chars;
+        sstr->capacity = new_capacity;
     }
-    unsigned int i = 0;
-    char *str = calloc(sstr->size + 1, sizeof(char));
-    if (str == NULL) return NULL;
-    for (i = 0; i < sstr->size; i++)
-    {
-        str[i] = sstr->values[i]->character;
-    }
-    str[i+1] = '\0';
-    return str;
+    sstr->chars[sstr->length++] = c;
+    sstr->chars[sstr->length] = '\0';
+    return true;
 }
 
 void delete_scm_string(ScmString *sstr)
 {
-    delete_list(sstr);
+    if (sstr == NULL) return;
+    free(sstr->chars);
+    free(sstr);
 }
 
-struct Value *copy_value(struct Value *v)
+ScmString *to_scm_string(char *str)
 {
-    if (v == NULL) return NULL;
+    return scm_string(str, strlen(str));
+}
 
-    struct Value *copy, *args_copy, *body_copy;
-    struct List *lst;
-    switch (v->type)
-    {
-        case LIST:
-            lst = list();
-            if (lst == NULL) return NULL;
-            for (unsigned int i = 0; i < v->list->size; i++)
-            {
-                copy = copy_value(v->list->values[i]);
-                if (copy == NULL) 
-                {
-                    delete_list(lst);
-                    return NULL;
-                }
-                append(lst, copy);
-            }
-            return vlist(lst);
-        case SYMBOL:
-            return vsymbol(v->symbol);
-        case CHAR:
-            return vcharacter(v->character);
-        case NUMBER:
-            return vnumber(v->number);
-        case STRING:
-            return vstring(v->string);
-        case BOOLEAN:
-            return vboolean(v->boolean);
-        case PROCEDURE:
-            args_copy = copy_value(get_args(v));
-            if (args_copy == NULL) 
-            {
-                return NULL;
-            }
-            body_copy = copy_value(get_body(v));
-            if (body_copy == NULL) 
-            {
-                free(args_copy);
-                return NULL;
-            }
-            return vproc(args_copy, body_copy);
-    }
+char *from_scm_string(ScmString *sstr)
+{
+    return (sstr == NULL) ? NULL : sstr->chars;
 }
@@ -1,83 +1,410 @@
 #ifndef DATATYPE
 #define DATATYPE
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 /* Constants */
 #define MAXIMUM_SYMBOL_LENGTH 255
 
+/* Elements a list made by list has room for before it needs a block of
+ * its own */
+#define INIT_LIST_CAPACITY 4
+
+/* Index that stands for no entry in a memo's list of entries */
+#define MEMO_NONE ((unsigned int)-1)
+
 /* Data structures */
 
 enum Type
 {
     LIST,
+    PAIR,
     SYMBOL,
     CHAR,
     NUMBER,
     STRING,
     BOOLEAN,
-    PROCEDURE
+    PROCEDURE,
+    BUILTIN,
+    LOCAL,
+    GLOBAL,
+    CODE,
+    F64VECTOR,
+    MACRO,
+    MEMO,
+    HASH_TABLE
+};
+
+struct Namespace;
+struct Binding;
+struct Parser;
+
+/* A Scheme value is a single NaN-boxed 64 bit word, so numbers,
+ * booleans, characters, symbols and the empty list live inside the word
+ * itself and never touch the allocator. Everything else is a pointer to
+ * a heap allocated struct Object.
+ *
+ * The encoding follows JavaScriptCore: doubles are stored with 2^49
+ * added to their bits, which moves every double (with NaNs canonicalized)
+ * above 2^49. Below that, the top 16 bits are zero and the word is
+ *   0                          NO_VALUE (nothing / undefined / error)
+ *   pointer, low 3 bits 0      heap object
+ *   payload << 3 | tag         immediate, tag is one of the TAG_ values
+ *
+ * Numbers are either doubles or fixnums, exact integers that fit in the
+ * 46 bits of payload (stored in two's complement). Exact integers too
+ * big for that are bignums, which are heap objects (see number.h) */
+typedef uint64_t Value;
+
+#define NO_VALUE ((Value)0)
+
+#define DOUBLE_OFFSET ((Value)1 << 49)
+#define TAG_MASK ((Value)7)
+#define TAG_OBJECT ((Value)0)
+#define TAG_BOOLEAN ((Value)1)
+#define TAG_CHAR ((Value)2)
+#define TAG_EMPTY_LIST ((Value)3)
+#define TAG_SYMBOL ((Value)4)
+#define TAG_FIXNUM ((Value)5)
+
+#define FIXNUM_BITS 46
+#define FIXNUM_MAX (((int64_t)1 << (FIXNUM_BITS - 1)) - 1)
+#define FIXNUM_MIN (-((int64_t)1 << (FIXNUM_BITS - 1)))
+
+/* Held by a top level binding that code refers to but that hasn't been
+ * defined yet (see namespace.h). An immediate with a tag of its own, it
+ * never leaves the binding */
+#define UNBOUND ((Value)6)
+
+#define EMPTY_LIST TAG_EMPTY_LIST
+#define FALSE_VALUE TAG_BOOLEAN
+#define TRUE_VALUE (((Value)1 << 3) | TAG_BOOLEAN)
+
+/* Procedures are a lambda's compiled code (a CODE value) plus the
+ * namespace they were created in, which they close over */
+struct Procedure
+{
+    Value code;
+    struct Namespace *env;
 };
 
-struct Value
+/* Cells made by cons. Lists are any chain of pairs ending in an array
+ * list or the empty list, so cdr is always a list as well */
+struct Pair
+{
+    Value car;
+    Value cdr;
+};
+
+/* Heap allocated values, owned by the garbage collector (see gc.h).
+ * Objects are never modified once they're made (set! changes bindings,
+ * not values), so they're shared by reference and never copied. The
+ * exceptions are list tails, which copy the array they borrow before
+ * anything is added to them, and memos and hash tables (see struct Memo) */
+struct Object
 {
     enum Type type;
+
+    /* Collector bookkeeping: epoch of the last collection that reached
+     * the object and bytes it accounts for. next links old objects into
+     * the heap, and is where a young object that has been promoted out
+     * of the nursery records its new address */
+    unsigned int mark;
+    unsigned int size;
+    struct Object *next;
+
     union
     {
         struct List *list;
-        char *symbol;
-        char character;
-        double number;
-        struct List *string;
-        bool boolean;
-        struct List *proc;
+        struct ScmString *string;
+        struct Procedure proc;
+        struct Pair pair;
+        struct InternalFunction *builtin;
+
+        /* Variable reference resolved to a frame depth and binding slot
+         * (see resolve.h). Only ever appears in code, never in data. */
+        struct
+        {
+            char *name;
+            unsigned short depth;
+            unsigned short slot;
+        } local;
+
+        /* Variable reference resolved to the binding of a top level
+         * name, which is its cell. Also only ever appears in code */
+        struct
+        {
+            struct Namespace *nsp;
+            struct Binding *cell;
+        } global;
+
+        /* Bytecode. Like variable references, never appears in data */
+        struct Code *code;
+
+        struct F64Vector *f64vector;
+
+        /* Macro made by define-syntax, which is the syntax-rules form it
+         * was defined with (see macro.h) */
+        Value macro;
+
+        /* Procedure made by memoize, which remembers the values it has
+         * returned (see memo.h) */
+        struct Memo *memo;
+
+        struct HashTable *table;
+
+        /* The only numbers on the heap, so their type is NUMBER */
+        struct Bignum *bignum;
     };
 };
 
-struct List 
+/* Procedure implemented in C. The function gets its arguments already
+ * evaluated, and is only called with between min_args and max_args of
+ * them (max_args of -1 means there's no upper limit). On failure it sets
+ * parser->error and returns NO_VALUE */
+struct InternalFunction
+{
+    char *name;
+    int min_args;
+    int max_args;
+    Value (*function_ptr)(struct Parser *parser, unsigned int argc, Value *argv);
+};
+
+/* Lists held in one array, which is how code and literal data are
+ * parsed (and what vectors need). The elements start out in storage, in
+ * the same allocation as the list itself, which is all most lists (a
+ * few arguments, a binding pair, a parsed form) ever need. A list that
+ * outgrows it moves its elements to a block of their own, which grows
+ * and shrinks in place with realloc */
+struct List
 {
     unsigned int size;
     unsigned int capacity;
-    struct Value **values;
+    Value *values;
+
+    /* The list whose values this one shares, if it's a tail made by
+     * list_tail, otherwise NO_VALUE. Shared values are never modified;
+     * adding to a tail gives it its own copy first */
+    Value owner;
+
+    /* Sized when the list is made: INIT_LIST_CAPACITY by list, exactly
+     * the elements by list_from, and nothing for tails */
+    Value storage[];
+};
+
+/* Strings are a length plus one contiguous buffer of UTF-8 bytes, which
+ * is always kept null terminated so it can be handed straight to C */
+typedef struct ScmString
+{
+    unsigned int length;
+    unsigned int capacity;
+    char *chars;
+} ScmString;
+
+/* Homogeneous vectors of doubles. The numbers are stored unboxed in one
+ * contiguous buffer, so numeric kernels can run over them directly (see
+ * f64vector.h) */
+struct F64Vector
+{
+    unsigned int length;
+    double *data;
+};
+
+/* Exact integers too big to be fixnums, as a sign and a magnitude. The
+ * digits are base 2^32, least significant first, and the last one is
+ * never 0. Anything that fits in a fixnum is always made one instead */
+struct Bignum
+{
+    bool negative;
+    unsigned int length;
+    uint32_t *digits;
+};
+
+/* A value the procedure of a memo returned, and the list of arguments it
+ * returned it for. Entries are kept in order of use in a list linked
+ * through their indices, newest first */
+struct MemoEntry
+{
+    Value args;
+    Value value;
+    uint64_t hash;
+    size_t bytes;
+    unsigned int newer;
+    unsigned int older;
+};
+
+/* Procedure that remembers what it returned for each list of arguments
+ * (equal? ones count as the same), up to a budget of entries and bytes.
+ * Past that, the least recently used entry is forgotten. Unlike other
+ * objects, memos change after they're made, so they tell the collector
+ * when they're given a young value (see gc.h) */
+struct Memo
+{
+    Value proc;
+
+    /* entries[0..count), and an open addressing table of their indices
+     * plus one (0 is an empty slot), whose size is a power of two */
+    struct MemoEntry *entries;
+    unsigned int count;
+    unsigned int capacity;
+    unsigned int *slots;
+    unsigned int slot_count;
+
+    /* Ends of the list of entries in order of use, MEMO_NONE if empty */
+    unsigned int newest;
+    unsigned int oldest;
+
+    unsigned int max_entries;
+    size_t max_bytes;
+    size_t bytes;
+
+    unsigned long hits;
+    unsigned long misses;
+
+    /* Collector bookkeeping, like a namespace's (see namespace.h) */
+    bool remembered;
+    struct Object *next_remembered;
+};
+
+/* A key of a hash table and the value it's bound to */
+struct HashEntry
+{
+    Value key;
+    Value value;
+    uint64_t hash;
+};
+
+/* Table of keys and values, which are the same key if they're eq? (or
+ * equal? if equal is set). Like memos, they change after they're made
+ * and tell the collector when they're given a young value */
+struct HashTable
+{
+    bool equal;
+
+    /* entries[0..count), in no particular order, and an open addressing
+     * table of their indices plus one (0 is an empty slot), whose size
+     * is a power of two */
+    struct HashEntry *entries;
+    unsigned int count;
+    unsigned int capacity;
+    unsigned int *slots;
+    unsigned int slot_count;
+
+    /* Collector bookkeeping, like a namespace's (see namespace.h) */
+    bool remembered;
+    struct Object *next_remembered;
 };
 
-typedef struct List ScmString;
+/* Bytecode for a lambda body or a top level form (see compile.h). Every
+ * lambda expression is compiled once, and each procedure made from it
+ * shares the one struct Code */
+struct Code
+{
+    uint16_t *ops;
+    unsigned int length;
+    unsigned int capacity;
+
+    /* Constants, variable names and nested lambdas the code refers to */
+    struct List *constants;
+
+    /* The lambda's parameter list (or lone symbol for variadic lambdas)
+     * and body, NO_VALUE for top level forms */
+    Value args;
+    Value body;
+    unsigned short nparams;
+    bool variadic;
+
+    /* Most values the code ever has on the stack at once */
+    unsigned int max_stack;
+};
+
+/* The list every empty list value points to. Must never be appended to */
+extern struct List empty_list;
 
 /* Function definitions */
 
 // /* Creates a scheme list. Returns NULL on failure. */
 struct List *list(void);
 
+/* Creates a list holding a copy of values[0..size), allocated at exactly
+ * that size. Returns NULL on failure */
+struct List *list_from(const Value *values, unsigned int size);
+
 /* Adds a value to the list. Returns true on success, false otherwise */
-bool append(struct List *lst, struct Value *v);
+bool append(struct List *lst, Value v);
 
 /* Remove element from the end of the list and return it */
-struct Value *pop(struct List *lst);
+Value pop(struct List *lst);
 
-/* Deletes a list and all of its elements */
+/* Deletes a list that was never wrapped in a value. Its elements are
+ * owned by the garbage collector and are left alone */
 void delete_list(struct List *lst);
 
-/* Deletes a value */
-void delete_value(struct Value *v);
+/* Allocates a heap object of the given type and hands it to the garbage
+ * collector, which counts payload_size more bytes (the list, string or
+ * procedure the object owns) towards the next collection. Returns NULL
+ * on failure */
+struct Object *new_object(enum Type type, size_t payload_size);
 
-static inline void delete_scm_string(ScmString *sstr)
-{
-    delete_list(sstr);
-}
+/* Frees whatever an object owns, but not the object itself. Only the
+ * collector calls this */
+void release_object(struct Object *o);
+
+/* Creates a string holding a copy of the first length bytes of chars.
+ * Returns NULL on failure. */
+ScmString *scm_string(const char *chars, unsigned int length);
+
+/* Adds a byte to the end of the string. Returns true on success */
+bool string_append(ScmString *sstr, char c);
+
+/* Deletes a string and its buffer */
+void delete_scm_string(ScmString *sstr);
 
-/* Convert to and from Value strings */
+/* Convert to and from Value strings. from_scm_string returns the
+ * string's own buffer, which must not be freed or modified */
 ScmString *to_scm_string(char *str);
 char *from_scm_string(ScmString *sstr);
 
-/* Create a deep copy of a value and return it */
-struct Value *copy_value(struct Value *v);
+/* Creates an f64vector of length zeroes. Returns NULL on failure */
+struct F64Vector *new_f64vector(unsigned int length);
+
+/* Deletes an f64vector and its buffer */
+void delete_f64vector(struct F64Vector *vec);
+
+/* Deletes a bignum and its digits */
+void delete_bignum(struct Bignum *big);
+
+/* Gets the bignum for n, which must be too big for a fixnum. Returns
+ * NO_VALUE on failure */
+Value bignum_from_int64(int64_t n);
+
+/* Gets the nearest double to a bignum (which may be infinite) */
+double bignum_to_double(struct Bignum *big);
+
+/* Gets the list of everything after the first element of v, a non-empty
+ * list value held in an array, without copying. Returns NO_VALUE on
+ * failure */
+Value list_tail(Value v);
+
+/* Gets an array list value with the same elements as the list v, which
+ * may be made of pairs. Returns NO_VALUE on failure */
+Value flatten_list(Value v);
+
+/* Creates empty code for the given lambda parameters and body. Returns
+ * NULL on failure */
+struct Code *new_code(Value args, Value body);
+
+/* Deletes code that was never wrapped in a value */
+void delete_code(struct Code *code);
 
 /* Utility functions */
 
-/* Gets value from specified index (null if index out of bounds) */
-static inline struct Value *list_lookup(struct List *lst, unsigned int index)
+/* Gets value from specified index (NO_VALUE if index out of bounds) */
+static inline Value list_lookup(struct List *lst, unsigned int index)
 {
-    return (index >= lst->size ? NULL : lst->values[index]);
+    return (index >= lst->size ? NO_VALUE : lst->values[index]);
 }
 
 /* Sugar for checking if a list is empty */
@@ -86,89 +413,349 @@ static inline bool is_empty(struct List *lst)
     return (lst != NULL && lst->size == 0);
 }
 
+/* Sugar for inspecting values */
+static inline bool is_double(Value v)
+{
+    return v >= DOUBLE_OFFSET;
+}
+
+static inline bool is_fixnum(Value v)
+{
+    return v < DOUBLE_OFFSET && (v & TAG_MASK) == TAG_FIXNUM;
+}
+
+/* Numbers held in the word itself, which is all of them but bignums */
+static inline bool is_immediate_number(Value v)
+{
+    return is_double(v) || is_fixnum(v);
+}
+
+static inline bool is_object(Value v)
+{
+    return v != NO_VALUE && v < DOUBLE_OFFSET && (v & TAG_MASK) == TAG_OBJECT;
+}
+
+static inline struct Object *as_object(Value v)
+{
+    return (struct Object *)(uintptr_t)v;
+}
+
+/* Gets the type of a value. v must not be NO_VALUE */
+static inline enum Type type_of(Value v)
+{
+    if (is_double(v)) return NUMBER;
+    switch (v & TAG_MASK)
+    {
+        case TAG_BOOLEAN:
+            return BOOLEAN;
+        case TAG_CHAR:
+            return CHAR;
+        case TAG_EMPTY_LIST:
+            return LIST;
+        case TAG_SYMBOL:
+            return SYMBOL;
+        case TAG_FIXNUM:
+            return NUMBER;
+        default:
+            return as_object(v)->type;
+    }
+}
+
+static inline int64_t as_fixnum(Value v)
+{
+    // Shift the payload to the top, then back down to extend its sign
+    return (int64_t)(v << (61 - FIXNUM_BITS)) >> (64 - FIXNUM_BITS);
+}
+
+/* Gets any number as a double */
+static inline double as_number(Value v)
+{
+    if (is_fixnum(v)) return (double)as_fixnum(v);
+    else if (is_object(v)) return bignum_to_double(as_object(v)->bignum);
+    double d;
+    v -= DOUBLE_OFFSET;
+    memcpy(&d, &v, sizeof(d));
+    return d;
+}
+
+static inline bool as_boolean(Value v)
+{
+    return v != FALSE_VALUE;
+}
+
+static inline char as_char(Value v)
+{
+    return (char)(v >> 3);
+}
+
+static inline char *as_symbol(Value v)
+{
+    return (char *)(uintptr_t)(v & ~TAG_MASK);
+}
+
+/* Gets the elements of a list value (including the empty list) */
+static inline struct List *as_list(Value v)
+{
+    return (v == EMPTY_LIST) ? &empty_list : as_object(v)->list;
+}
+
+static inline ScmString *as_string(Value v)
+{
+    return as_object(v)->string;
+}
+
+static inline struct Procedure *as_proc(Value v)
+{
+    return &as_object(v)->proc;
+}
+
+static inline struct Pair *as_pair(Value v)
+{
+    return &as_object(v)->pair;
+}
+
+static inline struct InternalFunction *as_builtin(Value v)
+{
+    return as_object(v)->builtin;
+}
+
+static inline struct Code *as_code(Value v)
+{
+    return as_object(v)->code;
+}
+
+static inline bool is_bignum(Value v)
+{
+    return is_object(v) && as_object(v)->type == NUMBER;
+}
+
+/* Fixnums and bignums */
+static inline bool is_exact(Value v)
+{
+    return is_fixnum(v) || is_bignum(v);
+}
+
+static inline struct Bignum *as_bignum(Value v)
+{
+    return as_object(v)->bignum;
+}
+
+static inline struct F64Vector *as_f64vector(Value v)
+{
+    return as_object(v)->f64vector;
+}
+
+static inline struct Memo *as_memo(Value v)
+{
+    return as_object(v)->memo;
+}
+
+static inline struct HashTable *as_hash_table(Value v)
+{
+    return as_object(v)->table;
+}
+
 /* Sugar for dealing with procs */
-static inline struct Value *get_args(struct Value *v)
+static inline Value get_args(Value v)
 {
-    return (v->type == PROCEDURE) ? list_lookup(v->proc, 0) : NULL;
+    return (type_of(v) == PROCEDURE) ? as_code(as_proc(v)->code)->args : NO_VALUE;
 }
 
-static inline struct Value *get_body(struct Value *v)
+static inline Value get_body(Value v)
 {
-    return (v->type == PROCEDURE) ? list_lookup(v->proc, 1) : NULL;
+    return (type_of(v) == PROCEDURE) ? as_code(as_proc(v)->code)->body : NO_VALUE;
 }
 
-/* Sugar for creating heap-allocated values */
-static inline struct Value *vsymbol(char *symbol)
+static inline struct Namespace *get_env(Value v)
 {
-    struct Value *v = malloc(sizeof(*v));
-    if (v == NULL) return NULL;
-    v->type = SYMBOL;
-    v->symbol = symbol;
+    return (type_of(v) == PROCEDURE) ? as_proc(v)->env : NULL;
+}
+
+/* Sugar for creating values. Only lists, pairs, strings, procedures,
+ * builtins, variable references, code, f64vectors and bignums are heap
+ * allocated; the rest are immediate */
+
+/* symbol must be an interned name (see symbol.h) */
+static inline Value vsymbol(char *symbol)
+{
+    return (Value)(uintptr_t)symbol | TAG_SYMBOL;
+}
+
+static inline Value vcharacter(char character)
+{
+    return ((Value)(unsigned char)character << 3) | TAG_CHAR;
+}
+
+static inline Value vnumber(double number)
+{
+    Value v;
+    // Only one NaN bit pattern, so no NaN can be confused with a tag
+    if (number != number) number = __builtin_nan("");
+    memcpy(&v, &number, sizeof(v));
+    return v + DOUBLE_OFFSET;
+}
+
+static inline bool fits_fixnum(int64_t n)
+{
+    return n >= FIXNUM_MIN && n <= FIXNUM_MAX;
+}
+
+/* n must fit in a fixnum */
+static inline Value vfixnum(int64_t n)
+{
+    return (((Value)n & (((Value)1 << FIXNUM_BITS) - 1)) << 3) | TAG_FIXNUM;
+}
+
+/* A fixnum if n fits in one, otherwise a bignum */
+static inline Value vinteger(int64_t n)
+{
+    return fits_fixnum(n) ? vfixnum(n) : bignum_from_int64(n);
+}
+
+static inline Value vboolean(bool boolean)
+{
+    return boolean ? TRUE_VALUE : FALSE_VALUE;
+}
+
+static inline Value vobject(enum Type type, size_t payload_size, struct Object **out)
+{
+    struct Object *o = new_object(type, payload_size);
+    if (o == NULL) return NO_VALUE;
+    *out = o;
+    return (Value)(uintptr_t)o;
+}
+
+static inline Value vstring(ScmString *string)
+{
+    if (string == NULL) return NO_VALUE;
+    struct Object *o;
+    Value v = vobject(STRING, sizeof(*string) + string->capacity, &o);
+    if (v != NO_VALUE) o->string = string;
     return v;
 }
 
-static inline struct Value *vcharacter(char character)
+/* Takes ownership of list, empty lists become EMPTY_LIST */
+static inline Value vlist(struct List *list)
 {
-    struct Value *v = malloc(sizeof(*v));
-    if (v == NULL) return NULL;
-    v->type = CHAR;
-    v->character = character;
+    if (list == NULL) return NO_VALUE;
+    if (list->size == 0)
+    {
+        delete_list(list);
+        return EMPTY_LIST;
+    }
+    struct Object *o;
+    Value v = vobject(LIST, sizeof(*list) + list->capacity * sizeof(Value), &o);
+    if (v != NO_VALUE) o->list = list;
     return v;
 }
 
-static inline struct Value *vnumber(double number)
+/* cdr must be a list (or pair) */
+static inline Value vpair(Value car, Value cdr)
 {
-    struct Value *v = malloc(sizeof(*v));
-    if (v == NULL) return NULL;
-    v->type = NUMBER;
-    v->number = number;
+    struct Object *o;
+    Value v = vobject(PAIR, 0, &o);
+    if (v == NO_VALUE) return NO_VALUE;
+    o->pair.car = car;
+    o->pair.cdr = cdr;
     return v;
 }
 
-static inline struct Value *vstring(struct List *string)
+/* code must be a CODE value */
+static inline Value vproc(Value code, struct Namespace *env)
 {
-    struct Value *v = malloc(sizeof(*v));
-    if (v == NULL) return NULL;
-    v->type = STRING;
-    v->string = string;
+    struct Object *o;
+    Value v = vobject(PROCEDURE, 0, &o);
+    if (v == NO_VALUE) return NO_VALUE;
+    o->proc.code = code;
+    o->proc.env = env;
     return v;
 }
 
-static inline struct Value *vboolean(bool boolean)
+static inline Value vbuiltin(struct InternalFunction *builtin)
 {
-    struct Value *v = malloc(sizeof(*v));
-    if (v == NULL) return NULL;
-    v->type = BOOLEAN;
-    v->boolean = boolean;
+    struct Object *o;
+    Value v = vobject(BUILTIN, 0, &o);
+    if (v != NO_VALUE) o->builtin = builtin;
     return v;
 }
 
-static inline struct Value *vlist(struct List *list)
+static inline Value vlocal(char *name, unsigned short depth, unsigned short slot)
 {
-    struct Value *v = malloc(sizeof(*v));
-    if (v == NULL) return NULL;
-    v->type = LIST;
-    v->list = list;
+    struct Object *o;
+    Value v = vobject(LOCAL, 0, &o);
+    if (v == NO_VALUE) return NO_VALUE;
+    o->local.name = name;
+    o->local.depth = depth;
+    o->local.slot = slot;
     return v;
 }
 
-static inline struct Value *vproc(struct Value *args, struct Value *body)
+static inline Value vglobal(struct Namespace *nsp, struct Binding *cell)
 {
-    struct Value *v = malloc(sizeof(*v));
-    if (v == NULL) 
-    {
-        return NULL;
-    }
-    struct List *proc = list();
-    if (proc == NULL) 
-    {
-        free(v);
-        return NULL;
-    }
-    v->type = PROCEDURE;
-    v->proc = proc;
-    append(proc, args);
-    append(proc, body);
+    struct Object *o;
+    Value v = vobject(GLOBAL, 0, &o);
+    if (v == NO_VALUE) return NO_VALUE;
+    o->global.nsp = nsp;
+    o->global.cell = cell;
+    return v;
+}
+
+/* Takes ownership of code */
+static inline Value vcode(struct Code *code)
+{
+    if (code == NULL) return NO_VALUE;
+    struct Object *o;
+    Value v = vobject(CODE, sizeof(*code) + code->capacity * sizeof(uint16_t), &o);
+    if (v != NO_VALUE) o->code = code;
+    return v;
+}
+
+/* Takes ownership of big, which must be too big for a fixnum */
+static inline Value vbignum(struct Bignum *big)
+{
+    if (big == NULL) return NO_VALUE;
+    struct Object *o;
+    Value v = vobject(NUMBER, sizeof(*big) + big->length * sizeof(uint32_t), &o);
+    if (v != NO_VALUE) o->bignum = big;
+    return v;
+}
+
+/* rules must be a syntax-rules form checked by make_macro */
+static inline Value vmacro(Value rules)
+{
+    struct Object *o;
+    Value v = vobject(MACRO, 0, &o);
+    if (v != NO_VALUE) o->macro = rules;
+    return v;
+}
+
+/* Takes ownership of vec */
+static inline Value vf64vector(struct F64Vector *vec)
+{
+    if (vec == NULL) return NO_VALUE;
+    struct Object *o;
+    Value v = vobject(F64VECTOR, sizeof(*vec) + vec->length * sizeof(double), &o);
+    if (v != NO_VALUE) o->f64vector = vec;
+    return v;
+}
+
+/* Takes ownership of memo */
+static inline Value vmemo(struct Memo *memo)
+{
+    if (memo == NULL) return NO_VALUE;
+    struct Object *o;
+    Value v = vobject(MEMO, sizeof(*memo), &o);
+    if (v != NO_VALUE) o->memo = memo;
+    return v;
+}
+
+/* Takes ownership of table */
+static inline Value vhash_table(struct HashTable *table)
+{
+    if (table == NULL) return NO_VALUE;
+    struct Object *o;
+    Value v = vobject(HASH_TABLE, sizeof(*table), &o);
+    if (v != NO_VALUE) o->table = table;
     return v;
 }
 
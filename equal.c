@@ -0,0 +1,253 @@
+#include <string.h>
+#include "equal.h"
+#include "datatype.h"
+#include "number.h"
+
+/* Internal constants */
+
+/* Pairs are hashed by what's in them, this many pairs deep */
+const unsigned int HASH_PAIR_DEPTH = 4;
+
+/* Private function definitions */
+
+// Adds x to the hash h
+static inline uint64_t mix(uint64_t h, uint64_t x)
+{
+    h ^= x + 0x9e3779b97f4a7c15 + (h << 6) + (h >> 2);
+    return h;
+}
+
+// Spreads the bits of a word over the whole hash, so words that differ
+// in a few bits (like neighbouring pointers) end up far apart
+static inline uint64_t scramble(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111eb;
+    x ^= x >> 31;
+    return x;
+}
+
+static inline uint64_t hash_double(double d)
+{
+    // 0.0 and -0.0 are equal, so they have to hash the same
+    if (d == 0) d = 0;
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    return scramble(bits);
+}
+
+static inline uint64_t hash_pointer(const void *p)
+{
+    return scramble((uint64_t)(uintptr_t)p);
+}
+
+// Gets the next element of a list made of pairs, arrays or both, where
+// *rest is what's left of it and *i how far into *rest's array that is.
+// Returns false at the end of the list
+static inline bool next_element(Value *rest, unsigned int *i, Value *out)
+{
+    if (type_of(*rest) == PAIR)
+    {
+        *out = as_pair(*rest)->car;
+        *rest = as_pair(*rest)->cdr;
+        *i = 0;
+        return true;
+    }
+    struct List *lst = as_list(*rest);
+    if (*i == lst->size) return false;
+    *out = lst->values[(*i)++];
+    return true;
+}
+
+static uint64_t hash_identity(Value v, unsigned int depth)
+{
+    if (is_fixnum(v) || !is_object(v))
+    {
+        // Symbols are interned, so every immediate but a double is eq?
+        // only to the same word
+        return is_double(v) ? hash_double(as_number(v)) : scramble(v);
+    }
+
+    enum Type type = type_of(v);
+    uint64_t h = scramble(type);
+    switch (type)
+    {
+        case PAIR:
+            // A pair's address changes when it's promoted, but what's in
+            // it never does
+            if (depth == 0) return h;
+            h = mix(h, hash_identity(as_pair(v)->car, depth - 1));
+            return mix(h, hash_identity(as_pair(v)->cdr, depth - 1));
+        case NUMBER:
+        {
+            struct Bignum *big = as_bignum(v);
+            h = mix(h, big->negative);
+            for (unsigned int i = 0; i < big->length; i++) h = mix(h, big->digits[i]);
+            return scramble(h);
+        }
+        case PROCEDURE:
+            // Procedures move with their object, but the code and frame
+            // they're made of don't
+            h = mix(h, hash_pointer(as_code(as_proc(v)->code)));
+            return mix(h, hash_pointer(as_proc(v)->env));
+        case LIST:
+            // Tails made by cdr share their values with the list, so
+            // they're told apart by where those start and how many
+            h = mix(h, hash_pointer(as_list(v)->values));
+            return mix(h, as_list(v)->size);
+        case STRING:
+            return mix(h, hash_pointer(as_string(v)));
+        case F64VECTOR:
+            return mix(h, hash_pointer(as_f64vector(v)));
+        case BUILTIN:
+            return mix(h, hash_pointer(as_builtin(v)));
+        case MEMO:
+            return mix(h, hash_pointer(as_memo(v)));
+        case HASH_TABLE:
+            return mix(h, hash_pointer(as_hash_table(v)));
+        default: // Macros have nothing that stays put to go by
+            return h;
+    }
+}
+
+static bool is_list_equal(Value a, Value b)
+{
+    unsigned int i = 0, j = 0;
+    Value x, y;
+    for (;;)
+    {
+        bool more = next_element(&a, &i, &x);
+        if (more != next_element(&b, &j, &y)) return false;
+        if (!more) return true;
+        if (!is_equal(x, y)) return false;
+    }
+}
+
+/* Public functions */
+
+bool is_eq(Value a, Value b)
+{
+    // Immediates and heap objects alike are the same value exactly when
+    // they are the same word
+    if (a == b)
+    {
+        return true;
+    }
+    // If types not equal, know it's not eq
+    if (type_of(a) != type_of(b))
+    {
+        return false;
+    }
+    // Basing this on the behavior of Chez Scheme
+    switch (type_of(a))
+    {
+        // An exact number is never the same as an inexact one
+        case NUMBER:
+            if (is_exact(a) != is_exact(b)) return false;
+            else if (is_exact(a)) return compare_integers(a, b) == 0;
+            return as_number(a) == as_number(b);
+        case STRING:
+            return as_string(a) == as_string(b);
+        case PROCEDURE:
+            return as_proc(a) == as_proc(b);
+        case BUILTIN:
+            return as_builtin(a) == as_builtin(b);
+        case LIST:
+            // Taking the cdr of a list makes a new tail each time, and
+            // they're all the same list if they share the same values
+            return as_list(a)->values == as_list(b)->values
+                && as_list(a)->size == as_list(b)->size;
+        case F64VECTOR:
+            return as_f64vector(a) == as_f64vector(b);
+        case MEMO:
+            return as_memo(a) == as_memo(b);
+        case HASH_TABLE:
+            return as_hash_table(a) == as_hash_table(b);
+        case MACRO: // Only the same word is the same macro or pair
+        case PAIR:
+        case CHAR:
+        case BOOLEAN:
+        case SYMBOL:
+        case LOCAL: // Variable references and code never escape as values
+        case GLOBAL:
+        case CODE:
+            return false;
+    }
+    return false;
+}
+
+bool is_equal(Value a, Value b)
+{
+    if (is_eq(a, b)) return true;
+
+    enum Type type = type_of(a);
+    if (type == LIST || type == PAIR)
+    {
+        return (type_of(b) == LIST || type_of(b) == PAIR) && is_list_equal(a, b);
+    }
+    else if (type != type_of(b))
+    {
+        return false;
+    }
+    else if (type == STRING)
+    {
+        ScmString *x = as_string(a), *y = as_string(b);
+        return x->length == y->length && memcmp(x->chars, y->chars, x->length) == 0;
+    }
+    else if (type == F64VECTOR)
+    {
+        struct F64Vector *x = as_f64vector(a), *y = as_f64vector(b);
+        if (x->length != y->length) return false;
+        for (unsigned int i = 0; i < x->length; i++)
+        {
+            if (x->data[i] != y->data[i]) return false;
+        }
+        return true;
+    }
+    return false;
+}
+
+uint64_t hash_eq(Value v)
+{
+    return hash_identity(v, HASH_PAIR_DEPTH);
+}
+
+uint64_t hash_equal(Value v)
+{
+    enum Type type = type_of(v);
+    if (type == LIST || type == PAIR)
+    {
+        // Pairs and arrays with the same elements are equal (and so is
+        // any empty list), so all of them hash as just their elements
+        unsigned int i = 0;
+        Value x;
+        uint64_t h = scramble(LIST);
+        while (next_element(&v, &i, &x)) h = mix(h, hash_equal(x));
+        return h;
+    }
+    else if (type == STRING)
+    {
+        ScmString *s = as_string(v);
+        uint64_t h = scramble(STRING);
+        for (unsigned int i = 0; i < s->length; i++) h = mix(h, (unsigned char)s->chars[i]);
+        return scramble(h);
+    }
+    else if (type == F64VECTOR)
+    {
+        struct F64Vector *vec = as_f64vector(v);
+        uint64_t h = scramble(F64VECTOR);
+        for (unsigned int i = 0; i < vec->length; i++) h = mix(h, hash_double(vec->data[i]));
+        return h;
+    }
+    // Anything else is only equal? if it's eq?
+    return hash_eq(v);
+}
+
+uint64_t hash_values(const Value *values, unsigned int count)
+{
+    uint64_t h = scramble(LIST);
+    for (unsigned int i = 0; i < count; i++) h = mix(h, hash_equal(values[i]));
+    return h;
+}
@@ -0,0 +1,33 @@
+#ifndef EQUAL_INCLUDE
+#define EQUAL_INCLUDE
+#include <stdbool.h>
+#include <stdint.h>
+#include "datatype.h"
+
+/* Function definitions */
+
+/* Checks if a and b are the same value, which is what eq? means. Numbers
+ * are the same if they're equally exact and equal, lists if they share
+ * the same values (as tails of one list do), and anything else on the
+ * heap only if it's the same object */
+bool is_eq(Value a, Value b);
+
+/* Checks if a and b have the same structure, which is what equal? means.
+ * Lists are equal if their elements are (whether they're made of pairs,
+ * arrays or both), strings and f64vectors if their contents are, and
+ * anything else only if it's eq? */
+bool is_equal(Value a, Value b);
+
+/* Hashes a value so that values that are eq? hash the same. Like
+ * hash_equal, it stays the same when young objects are promoted */
+uint64_t hash_eq(Value v);
+
+/* Hashes a value so that values that are equal? hash the same. Only
+ * contents and addresses that never move go into the hash, so it stays
+ * the same when young objects are promoted */
+uint64_t hash_equal(Value v);
+
+/* Hashes values[0..count) the same as hash_equal hashes a list of them */
+uint64_t hash_values(const Value *values, unsigned int count);
+
+#endif
@@ -21,6 +21,8 @@ enum Error
     EXTRA_PARENS,
     UNEXPECTED_END_OF_LIST,
     EXPECTED_OPEN_PAREN,
+    DUPLICATE_PARAMETER,
+    OUT_OF_MEMORY,
 
     /* eval errors */ 
     FIRST_NOT_PROC,
@@ -29,17 +31,30 @@ enum Error
     UNDEFINED,
     CANT_OPEN_FILE,
     CANT_EVAL_UNDEF,
+    CODE_TOO_LARGE,
+    INDEX_OUT_OF_RANGE,
+    LENGTH_MISMATCH,
+    DIVISION_BY_ZERO,
+    INVALID_SYNTAX_RULES,
+    NO_MATCHING_SYNTAX,
+    EXPANSION_TOO_DEEP,
+    KEY_NOT_FOUND,
+    UNSUPPORTED_EQUIVALENCE,
 
     /* type errors */
     EXPECTED_SYMBOL,
     EXPECTED_BOOLEAN,
     EXPECTED_NUMBER,
+    EXPECTED_INTEGER,
     EXPECTED_CHAR,
     EXPECTED_PROC,
     EXPECTED_STRING,
     EXPECTED_LIST,
     EXPECTED_PAIR,
-    EXPECTED_LIST_OR_SYMBOL
+    EXPECTED_LIST_OR_SYMBOL,
+    EXPECTED_F64VECTOR,
+    EXPECTED_MEMO,
+    EXPECTED_HASH_TABLE
 };
 
 /* Convert Error to friendly error message */
@@ -79,6 +94,10 @@ static inline char *parse_error_to_string(enum Error e)
              return "unexpected end of list";
         case EXPECTED_OPEN_PAREN:
              return "expected openning parenthesis";
+        case DUPLICATE_PARAMETER:
+             return "parameter names must be unique";
+        case OUT_OF_MEMORY:
+             return "ran out of memory";
 
         /* eval errors */
         case FIRST_NOT_PROC:
@@ -93,6 +112,24 @@ static inline char *parse_error_to_string(enum Error e)
              return "could not open file";
         case CANT_EVAL_UNDEF:
              return "cannot evaluate undefined";
+        case CODE_TOO_LARGE:
+             return "form is too large to compile";
+        case INDEX_OUT_OF_RANGE:
+             return "index out of range";
+        case LENGTH_MISMATCH:
+             return "vectors must have the same length";
+        case DIVISION_BY_ZERO:
+             return "division by zero";
+        case INVALID_SYNTAX_RULES:
+             return "malformed syntax-rules";
+        case NO_MATCHING_SYNTAX:
+             return "no syntax-rules pattern matches the form";
+        case EXPANSION_TOO_DEEP:
+             return "macro expansion nested too deeply";
+        case KEY_NOT_FOUND:
+             return "key not found in hash table";
+        case UNSUPPORTED_EQUIVALENCE:
+             return "hash tables can only compare keys with eq? or equal?";
 
         /* type errors */
         case EXPECTED_SYMBOL:
@@ -101,6 +138,8 @@ static inline char *parse_error_to_string(enum Error e)
              return "expected boolean";
         case EXPECTED_NUMBER:
              return "expected a numeric value";
+        case EXPECTED_INTEGER:
+             return "expected an integer";
         case EXPECTED_CHAR:
              return "expected a character";
         case EXPECTED_STRING:
@@ -113,6 +152,12 @@ static inline char *parse_error_to_string(enum Error e)
              return "expected a procedure";
         case EXPECTED_LIST_OR_SYMBOL:
              return "expected a list or a symbol";
+        case EXPECTED_F64VECTOR:
+             return "expected an f64vector";
+        case EXPECTED_MEMO:
+             return "expected a memoized procedure";
+        case EXPECTED_HASH_TABLE:
+             return "expected a hash table";
     }
 }
 
@@ -10,11 +10,15 @@
 /* Function definitions */
 
 /* Evaluates a scheme value in the current namespace */
-struct Value *eval(struct Namespace *nsp, struct Parser *parser, struct Value *val);
+Value eval(struct Namespace *nsp, struct Parser *parser, Value val);
 
 /* Loads and evaluates external Scheme source */
 void load(struct Namespace *nsp, struct Parser *p, char *filename);
 
+/* Evaluates every form in a file, in nsp, and returns the value of the
+ * last one. Sets parser->error and returns NO_VALUE on failure */
+Value load_file(struct Namespace *nsp, struct Parser *parser, char *filename);
+
 /* Utility functions */
 
 #endif
@@ -0,0 +1,325 @@
+#include <stdbool.h>
+#include "f64vector.h"
+
+/* SSE2 is part of x86-64, so it's always there. AVX2 kernels are built
+ * alongside with a target attribute and only used if the CPU has it */
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define HAVE_X86_SIMD
+#include <immintrin.h>
+#define AVX2 __attribute__((target("avx2")))
+#endif
+
+/* Data structures */
+
+struct Kernels
+{
+    double (*sum)(const double *x, unsigned int n);
+    double (*dot)(const double *x, const double *y, unsigned int n);
+    void (*binary)(enum VectorOp op, const double *x, const double *y, bool broadcast,
+            double *out, unsigned int n);
+};
+
+/* Private function definitions */
+
+/* Plain C, for the tails of vectors and for other architectures */
+
+static inline double scalar_op(enum VectorOp op, double a, double b)
+{
+    switch (op)
+    {
+        case VEC_ADD:
+            return a + b;
+        case VEC_SUB:
+            return a - b;
+        case VEC_MUL:
+            return a * b;
+        case VEC_DIV:
+            return a / b;
+        case VEC_EQ:
+            return a == b;
+        case VEC_LT:
+            return a < b;
+        case VEC_GT:
+            return a > b;
+        case VEC_LEQ:
+            return a <= b;
+        default:
+            return a >= b;
+    }
+}
+
+static double sum_scalar(const double *x, unsigned int n)
+{
+    double sum = 0;
+    for (unsigned int i = 0; i < n; i++) sum += x[i];
+    return sum;
+}
+
+static double dot_scalar(const double *x, const double *y, unsigned int n)
+{
+    double sum = 0;
+    for (unsigned int i = 0; i < n; i++) sum += x[i] * y[i];
+    return sum;
+}
+
+static void binary_scalar(enum VectorOp op, const double *x, const double *y, bool broadcast,
+        double *out, unsigned int n)
+{
+    // Read before anything is written, in case out is y
+    double b = *y;
+    for (unsigned int i = 0; i < n; i++)
+    {
+        out[i] = scalar_op(op, x[i], broadcast ? b : y[i]);
+    }
+}
+
+static const struct Kernels scalar_kernels = { sum_scalar, dot_scalar, binary_scalar };
+
+#ifdef HAVE_X86_SIMD
+
+/* SSE2, two doubles at a time. Loads are unaligned, since vectors are
+ * just malloc'd */
+
+static inline __m128d op_sse2(enum VectorOp op, __m128d a, __m128d b)
+{
+    // Comparisons give all ones or all zeroes, which masks 1.0
+    switch (op)
+    {
+        case VEC_ADD:
+            return _mm_add_pd(a, b);
+        case VEC_SUB:
+            return _mm_sub_pd(a, b);
+        case VEC_MUL:
+            return _mm_mul_pd(a, b);
+        case VEC_DIV:
+            return _mm_div_pd(a, b);
+        case VEC_EQ:
+            return _mm_and_pd(_mm_cmpeq_pd(a, b), _mm_set1_pd(1.0));
+        case VEC_LT:
+            return _mm_and_pd(_mm_cmplt_pd(a, b), _mm_set1_pd(1.0));
+        case VEC_GT:
+            return _mm_and_pd(_mm_cmpgt_pd(a, b), _mm_set1_pd(1.0));
+        case VEC_LEQ:
+            return _mm_and_pd(_mm_cmple_pd(a, b), _mm_set1_pd(1.0));
+        default:
+            return _mm_and_pd(_mm_cmpge_pd(a, b), _mm_set1_pd(1.0));
+    }
+}
+
+static inline double hsum_sse2(__m128d v)
+{
+    double lanes[2];
+    _mm_storeu_pd(lanes, v);
+    return lanes[0] + lanes[1];
+}
+
+static double sum_sse2(const double *x, unsigned int n)
+{
+    // Two accumulators, so consecutive adds don't wait on each other
+    __m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+    unsigned int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        s0 = _mm_add_pd(s0, _mm_loadu_pd(x + i));
+        s1 = _mm_add_pd(s1, _mm_loadu_pd(x + i + 2));
+    }
+    double sum = hsum_sse2(_mm_add_pd(s0, s1));
+    for (; i < n; i++) sum += x[i];
+    return sum;
+}
+
+static double dot_sse2(const double *x, const double *y, unsigned int n)
+{
+    __m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+    unsigned int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i)));
+        s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(x + i + 2), _mm_loadu_pd(y + i + 2)));
+    }
+    double sum = hsum_sse2(_mm_add_pd(s0, s1));
+    for (; i < n; i++) sum += x[i] * y[i];
+    return sum;
+}
+
+static void binary_sse2(enum VectorOp op, const double *x, const double *y, bool broadcast,
+        double *out, unsigned int n)
+{
+    double b = *y;
+    __m128d bv = _mm_set1_pd(b);
+    unsigned int i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128d yv = broadcast ? bv : _mm_loadu_pd(y + i);
+        _mm_storeu_pd(out + i, op_sse2(op, _mm_loadu_pd(x + i), yv));
+    }
+    for (; i < n; i++)
+    {
+        out[i] = scalar_op(op, x[i], broadcast ? b : y[i]);
+    }
+}
+
+static const struct Kernels sse2_kernels = { sum_sse2, dot_sse2, binary_sse2 };
+
+/* AVX2, four doubles at a time */
+
+static inline AVX2 __m256d op_avx2(enum VectorOp op, __m256d a, __m256d b)
+{
+    // Ordered comparisons, so NaN compares false like it does in C
+    switch (op)
+    {
+        case VEC_ADD:
+            return _mm256_add_pd(a, b);
+        case VEC_SUB:
+            return _mm256_sub_pd(a, b);
+        case VEC_MUL:
+            return _mm256_mul_pd(a, b);
+        case VEC_DIV:
+            return _mm256_div_pd(a, b);
+        case VEC_EQ:
+            return _mm256_and_pd(_mm256_cmp_pd(a, b, _CMP_EQ_OQ), _mm256_set1_pd(1.0));
+        case VEC_LT:
+            return _mm256_and_pd(_mm256_cmp_pd(a, b, _CMP_LT_OQ), _mm256_set1_pd(1.0));
+        case VEC_GT:
+            return _mm256_and_pd(_mm256_cmp_pd(a, b, _CMP_GT_OQ), _mm256_set1_pd(1.0));
+        case VEC_LEQ:
+            return _mm256_and_pd(_mm256_cmp_pd(a, b, _CMP_LE_OQ), _mm256_set1_pd(1.0));
+        default:
+            return _mm256_and_pd(_mm256_cmp_pd(a, b, _CMP_GE_OQ), _mm256_set1_pd(1.0));
+    }
+}
+
+static inline AVX2 double hsum_avx2(__m256d v)
+{
+    double lanes[4];
+    _mm256_storeu_pd(lanes, v);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+static AVX2 double sum_avx2(const double *x, unsigned int n)
+{
+    __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+    unsigned int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        s0 = _mm256_add_pd(s0, _mm256_loadu_pd(x + i));
+        s1 = _mm256_add_pd(s1, _mm256_loadu_pd(x + i + 4));
+    }
+    double sum = hsum_avx2(_mm256_add_pd(s0, s1));
+    for (; i < n; i++) sum += x[i];
+    return sum;
+}
+
+static AVX2 double dot_avx2(const double *x, const double *y, unsigned int n)
+{
+    __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+    unsigned int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        s0 = _mm256_add_pd(s0, _mm256_mul_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+        s1 = _mm256_add_pd(s1, _mm256_mul_pd(_mm256_loadu_pd(x + i + 4), _mm256_loadu_pd(y + i + 4)));
+    }
+    double sum = hsum_avx2(_mm256_add_pd(s0, s1));
+    for (; i < n; i++) sum += x[i] * y[i];
+    return sum;
+}
+
+static AVX2 void binary_avx2(enum VectorOp op, const double *x, const double *y, bool broadcast,
+        double *out, unsigned int n)
+{
+    double b = *y;
+    __m256d bv = _mm256_set1_pd(b);
+    unsigned int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d yv = broadcast ? bv : _mm256_loadu_pd(y + i);
+        _mm256_storeu_pd(out + i, op_avx2(op, _mm256_loadu_pd(x + i), yv));
+    }
+    for (; i < n; i++)
+    {
+        out[i] = scalar_op(op, x[i], broadcast ? b : y[i]);
+    }
+}
+
+static const struct Kernels avx2_kernels = { sum_avx2, dot_avx2, binary_avx2 };
+
+#endif
+
+static enum SimdLevel level;
+static const struct Kernels *kernels = NULL;
+
+// Checks if the kernels for level can run here
+static bool supported(enum SimdLevel level)
+{
+    switch (level)
+    {
+        case SIMD_NONE:
+            return true;
+#ifdef HAVE_X86_SIMD
+        case SIMD_SSE2:
+            return true;
+        case SIMD_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+static inline const struct Kernels *get_kernels(void)
+{
+    if (kernels == NULL)
+    {
+        if (!set_simd_level(SIMD_AVX2) && !set_simd_level(SIMD_SSE2))
+        {
+            set_simd_level(SIMD_NONE);
+        }
+    }
+    return kernels;
+}
+
+/* Public functions */
+
+enum SimdLevel simd_level(void)
+{
+    get_kernels();
+    return level;
+}
+
+bool set_simd_level(enum SimdLevel new_level)
+{
+    if (!supported(new_level)) return false;
+    switch (new_level)
+    {
+#ifdef HAVE_X86_SIMD
+        case SIMD_SSE2:
+            kernels = &sse2_kernels;
+            break;
+        case SIMD_AVX2:
+            kernels = &avx2_kernels;
+            break;
+#endif
+        default:
+            kernels = &scalar_kernels;
+            break;
+    }
+    level = new_level;
+    return true;
+}
+
+double f64_sum(const double *x, unsigned int n)
+{
+    return get_kernels()->sum(x, n);
+}
+
+double f64_dot(const double *x, const double *y, unsigned int n)
+{
+    return get_kernels()->dot(x, y, n);
+}
+
+void f64_binary(enum VectorOp op, const double *x, const double *y, bool broadcast,
+        double *out, unsigned int n)
+{
+    get_kernels()->binary(op, x, y, broadcast, out, n);
+}
@@ -0,0 +1,55 @@
+#ifndef F64VECTOR_INCLUDE
+#define F64VECTOR_INCLUDE
+#include <stdbool.h>
+
+/* Data structures */
+
+/* Element-wise operations on f64vectors. Comparisons give 1.0 where they
+ * hold and 0.0 where they don't, so the result can be summed to count
+ * matches or multiplied in as a mask */
+enum VectorOp
+{
+    VEC_ADD,
+    VEC_SUB,
+    VEC_MUL,
+    VEC_DIV,
+    VEC_EQ,
+    VEC_LT,
+    VEC_GT,
+    VEC_LEQ,
+    VEC_GEQ
+};
+
+/* Instruction sets the kernels come in. The best one the CPU supports is
+ * picked the first time a kernel runs */
+enum SimdLevel
+{
+    SIMD_NONE,
+    SIMD_SSE2,
+    SIMD_AVX2
+};
+
+/* Function definitions */
+
+/* Gets the instruction set the kernels are using */
+enum SimdLevel simd_level(void);
+
+/* Makes the kernels use the given instruction set (mostly for testing).
+ * Returns false, leaving things as they were, if the CPU or compiler
+ * doesn't support it */
+bool set_simd_level(enum SimdLevel level);
+
+/* Sum of x[0..n). Partial sums are kept in each lane, so the result can
+ * differ in the last bits from adding the elements in order */
+double f64_sum(const double *x, unsigned int n);
+
+/* Dot product of x[0..n) and y[0..n), summed the same way as f64_sum */
+double f64_dot(const double *x, const double *y, unsigned int n);
+
+/* Sets out[i] to x[i] op y[i] for i in [0, n). If broadcast is true, y
+ * points to a single number used for every element instead. out may be
+ * the same buffer as x or y */
+void f64_binary(enum VectorOp op, const double *x, const double *y, bool broadcast,
+        double *out, unsigned int n);
+
+#endif
@@ -1,36 +1,118 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "datatype.h"
 #include "error.h"
+#include "file.h"
+
+/* Size of each read once we've gone past the expected size of a file */
+#define READ_CHUNK_SIZE 65536
+
+// Reads everything left in fd with as few read calls as possible.
+// size_hint is the expected size of the file (0 if it isn't known)
+static ScmString *read_all(int fd, off_t size_hint)
+{
+    if (size_hint < 0 || size_hint >= UINT_MAX - 1) return NULL;
+    ScmString *sstr = scm_string("", 0);
+    if (sstr == NULL) return NULL;
+
+    // One spare byte past the expected size lets the read that hits the
+    // end of the file go through without growing the buffer
+    unsigned int capacity = (unsigned int)size_hint + 2;
+    while (1)
+    {
+        if (capacity > sstr->capacity)
+        {
+            char *chars = realloc(sstr->chars, capacity);
+            if (chars == NULL) goto error;
+            sstr->chars = chars;
+            sstr->capacity = capacity;
+        }
+
+        // Always leave room for the null terminator
+        ssize_t n = read(fd, &sstr->chars[sstr->length], sstr->capacity - sstr->length - 1);
+        if (n == 0) break;
+        if (n < 0) goto error;
+        sstr->length += n;
+
+        // File is bigger than expected, keep going a chunk at a time
+        if (sstr->capacity - sstr->length <= 1)
+        {
+            if (sstr->capacity > UINT_MAX - READ_CHUNK_SIZE) goto error;
+            capacity = sstr->capacity + READ_CHUNK_SIZE;
+        }
+    }
+    sstr->chars[sstr->length] = '\0';
+    return sstr;
+
+error:
+    delete_scm_string(sstr);
+    return NULL;
+}
 
 ScmString *read_file(char *filename)
 {
     if (filename == NULL) return NULL;
-    char c;
-    struct Value *vchar;
-    ScmString *sstr; 
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) return NULL;
 
-    FILE *fp = fopen(filename, "r");
-    if (!fp)
+    struct stat st;
+    ScmString *sstr = NULL;
+    if (fstat(fd, &st) == 0)
     {
-        return NULL;
+        sstr = read_all(fd, S_ISREG(st.st_mode) ? st.st_size : 0);
     }
+    close(fd);
+    return sstr;
+}
 
-    sstr = list();
-    if (sstr == NULL) return NULL;
-    while ((c = fgetc(fp)) != EOF)
+bool open_source(struct SourceFile *src, char *filename)
+{
+    if (filename == NULL) return false;
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size >= UINT_MAX)
     {
-        vchar = vcharacter(c);
-        if (vchar == NULL) 
-        {
-            delete_list(sstr);
-            return NULL;
-        }
-        else if (!append(sstr, vchar))
+        close(fd);
+        return false;
+    }
+    src->mapping = NULL;
+    src->copy = NULL;
+
+    // Map regular files, the parser reads straight out of the page cache
+    if (S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED)
         {
-            delete_value(vchar);
-            delete_list(sstr);
-            return NULL;
+            close(fd);
+            src->mapping = mapping;
+            src->chars = mapping;
+            src->length = st.st_size;
+            return true;
         }
     }
-    return sstr;
+
+    src->copy = read_all(fd, S_ISREG(st.st_mode) ? st.st_size : 0);
+    close(fd);
+    if (src->copy == NULL) return false;
+    src->chars = src->copy->chars;
+    src->length = src->copy->length;
+    return true;
+}
+
+void close_source(struct SourceFile *src)
+{
+    if (src->mapping != NULL) munmap(src->mapping, src->length);
+    delete_scm_string(src->copy);
+    src->mapping = NULL;
+    src->copy = NULL;
+    src->chars = NULL;
+    src->length = 0;
 }
@@ -1,14 +1,35 @@
 #ifndef FILE_INCLUDE
 #define FILE_INCLUDE
+#include <stdbool.h>
 #include "datatype.h"
 
 /* Constants */
 
 /* Data structures */
 
+/* Contents of a source file. The bytes are either mapped read-only
+ * straight from the file, or (when it can't be mapped, e.g. pipes and
+ * empty files) read into a string in one go. */
+struct SourceFile
+{
+    const char *chars;
+    unsigned int length;
+
+    void *mapping;
+    ScmString *copy;
+};
+
 /* Function definitions */
+
+/* Reads a whole file into a new string. Returns NULL on failure */
 ScmString *read_file(char *filename);
 
+/* Makes the contents of a file available in src. Returns false on failure */
+bool open_source(struct SourceFile *src, char *filename);
+
+/* Releases the contents of a file opened with open_source */
+void close_source(struct SourceFile *src);
+
 /* Utility functions */
 
 #endif
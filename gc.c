@@ -0,0 +1,451 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "datatype.h"
+#include "namespace.h"
+#include "gc.h"
+
+/* Internal constants */
+
+const unsigned int INIT_MARK_STACK_CAPACITY = 256;
+
+/* Data structures */
+
+static struct Object nursery[NURSERY_SIZE];
+
+struct Heap heap = {
+    nursery, 0,
+    NULL, NULL, NULL,
+    NULL, NULL,
+    NULL,
+    0, MIN_COLLECTION_BYTES,
+    0, DEFAULT_HEAP_GROWTH,
+    0, 0, 0
+};
+
+/* Objects that have been marked but whose contents haven't been yet.
+ * Keeps marking iterative so long chains of data don't use up C stack */
+struct MarkStack
+{
+    unsigned int size;
+    unsigned int capacity;
+    struct Object **objects;
+};
+
+static struct MarkStack mark_stack = { 0, 0, NULL };
+
+/* Private function definitions */
+
+/* Minor collection */
+
+// Gets the bookkeeping of an object that can change after it's made,
+// which is a memo or a hash table
+static bool *remembered_flag(struct Object *o)
+{
+    return o->type == MEMO ? &o->memo->remembered : &o->table->remembered;
+}
+
+static struct Object **next_remembered(struct Object *o)
+{
+    return o->type == MEMO ? &o->memo->next_remembered : &o->table->next_remembered;
+}
+
+// Adds an object to the old generation
+static void add_old(struct Object *o)
+{
+    o->mark = 0;
+    o->next = heap.objects;
+    heap.objects = o;
+    heap.allocated += o->size;
+}
+
+// Moves the young object at *v (if it is one) to the old generation,
+// unless that has already happened, and points *v at its new address
+static void promote(Value *v)
+{
+    if (!is_young(*v)) return;
+    struct Object *o = as_object(*v);
+    if (o->next == NULL)
+    {
+        struct Object *copy = malloc(sizeof(*copy));
+        if (copy == NULL)
+        {
+            // Can't leave it behind, the nursery is about to be reused
+            fprintf(stderr, "out of memory while collecting garbage\n");
+            abort();
+        }
+        *copy = *o;
+        add_old(copy);
+        o->next = copy;
+    }
+    *v = (Value)(uintptr_t)o->next;
+}
+
+static void promote_bindings(struct Namespace *nsp)
+{
+    for (unsigned int i = 0; i < nsp->size; i++)
+    {
+        promote(&binding_at(nsp, i)->value);
+    }
+}
+
+// Promotes everything an old object points to
+static void promote_contents(struct Object *o)
+{
+    switch (o->type)
+    {
+        case LIST:
+            for (unsigned int i = 0; i < o->list->size; i++)
+            {
+                promote(&o->list->values[i]);
+            }
+            promote(&o->list->owner);
+            break;
+        case PAIR:
+            promote(&o->pair.car);
+            promote(&o->pair.cdr);
+            break;
+        case PROCEDURE:
+            promote(&o->proc.code);
+            break;
+        case CODE:
+            for (unsigned int i = 0; i < o->code->constants->size; i++)
+            {
+                promote(&o->code->constants->values[i]);
+            }
+            promote(&o->code->args);
+            promote(&o->code->body);
+            break;
+        case MACRO:
+            promote(&o->macro);
+            break;
+        case MEMO:
+            promote(&o->memo->proc);
+            for (unsigned int i = 0; i < o->memo->count; i++)
+            {
+                promote(&o->memo->entries[i].args);
+                promote(&o->memo->entries[i].value);
+            }
+            break;
+        case HASH_TABLE:
+            for (unsigned int i = 0; i < o->table->count; i++)
+            {
+                promote(&o->table->entries[i].key);
+                promote(&o->table->entries[i].value);
+            }
+            break;
+        default: // Strings, builtins, variable references and f64vectors hold no values
+            break;
+    }
+}
+
+/* Major collection */
+
+static void trace_object(struct Object *o);
+
+static void mark_value(Value v)
+{
+    if (!is_object(v)) return;
+    struct Object *o = as_object(v);
+    if (o->mark == heap.epoch) return;
+    o->mark = heap.epoch;
+
+    if (mark_stack.size == mark_stack.capacity)
+    {
+        unsigned int capacity = mark_stack.capacity == 0
+            ? INIT_MARK_STACK_CAPACITY
+            : mark_stack.capacity * 2;
+        struct Object **objects = realloc(mark_stack.objects, capacity * sizeof(*objects));
+        if (objects == NULL)
+        {
+            // No room to defer it, so trace it right away instead
+            trace_object(o);
+            return;
+        }
+        mark_stack.objects = objects;
+        mark_stack.capacity = capacity;
+    }
+    mark_stack.objects[mark_stack.size++] = o;
+}
+
+static void mark_namespace(struct Namespace *nsp)
+{
+    for (; nsp != NULL && nsp->mark != heap.epoch; nsp = nsp->parent)
+    {
+        nsp->mark = heap.epoch;
+        for (unsigned int i = 0; i < nsp->size; i++)
+        {
+            mark_value(binding_at(nsp, i)->value);
+        }
+    }
+}
+
+static void trace_object(struct Object *o)
+{
+    switch (o->type)
+    {
+        case LIST:
+            for (unsigned int i = 0; i < o->list->size; i++)
+            {
+                mark_value(o->list->values[i]);
+            }
+            mark_value(o->list->owner);
+            break;
+        case PAIR:
+            mark_value(o->pair.car);
+            mark_value(o->pair.cdr);
+            break;
+        case PROCEDURE:
+            mark_value(o->proc.code);
+            mark_namespace(o->proc.env);
+            break;
+        case GLOBAL:
+            mark_namespace(o->global.nsp);
+            break;
+        case CODE:
+            for (unsigned int i = 0; i < o->code->constants->size; i++)
+            {
+                mark_value(o->code->constants->values[i]);
+            }
+            mark_value(o->code->args);
+            mark_value(o->code->body);
+            break;
+        case MACRO:
+            mark_value(o->macro);
+            break;
+        case MEMO:
+            mark_value(o->memo->proc);
+            for (unsigned int i = 0; i < o->memo->count; i++)
+            {
+                mark_value(o->memo->entries[i].args);
+                mark_value(o->memo->entries[i].value);
+            }
+            break;
+        case HASH_TABLE:
+            for (unsigned int i = 0; i < o->table->count; i++)
+            {
+                mark_value(o->table->entries[i].key);
+                mark_value(o->table->entries[i].value);
+            }
+            break;
+        default: // Strings, builtins, local references and f64vectors hold no values
+            break;
+    }
+}
+
+static void mark_roots(void)
+{
+    for (struct GCRoot *root = heap.roots; root != NULL; root = root->prev)
+    {
+        for (unsigned int i = 0; i < root->count; i++)
+        {
+            mark_value(root->values[i]);
+        }
+        mark_namespace(root->nsp);
+        for (unsigned int i = 0; i < root->frame_count; i++)
+        {
+            mark_namespace(root->frames[i]);
+        }
+    }
+    while (mark_stack.size > 0)
+    {
+        trace_object(mark_stack.objects[--mark_stack.size]);
+    }
+}
+
+static void sweep(void)
+{
+    heap.live = 0;
+
+    struct Object **o = &heap.objects;
+    while (*o != NULL)
+    {
+        struct Object *obj = *o;
+        if (obj->mark == heap.epoch)
+        {
+            heap.live += obj->size;
+            o = &obj->next;
+        }
+        else
+        {
+            *o = obj->next;
+            release_object(obj);
+            free(obj);
+        }
+    }
+
+    struct Namespace **n = &heap.namespaces;
+    while (*n != NULL)
+    {
+        struct Namespace *nsp = *n;
+        if (nsp->mark == heap.epoch)
+        {
+            heap.live += sizeof(*nsp);
+            n = &nsp->next;
+        }
+        else
+        {
+            *n = nsp->next;
+            free_nsp(nsp);
+        }
+    }
+}
+
+// Sets the number of bytes that can be allocated before the next collection
+static void update_threshold(void)
+{
+    size_t growth = heap.live / 100 * heap.heap_growth;
+    heap.threshold = growth < MIN_COLLECTION_BYTES ? MIN_COLLECTION_BYTES : growth;
+}
+
+/* Public functions */
+
+struct Object *new_object(enum Type type, size_t payload_size)
+{
+    struct Object *o;
+    if (heap.nursery_top < NURSERY_SIZE)
+    {
+        o = &heap.nursery[heap.nursery_top++];
+        o->type = type;
+        o->size = sizeof(*o) + payload_size;
+        o->next = NULL;
+        return o;
+    }
+
+    // Nursery is full until the next safe point
+    o = malloc(sizeof(*o));
+    if (o == NULL) return NULL;
+    o->type = type;
+    o->size = sizeof(*o) + payload_size;
+    add_old(o);
+    return o;
+}
+
+void gc_track_namespace(struct Namespace *nsp)
+{
+    nsp->on_heap = true;
+    nsp->next = heap.namespaces;
+    heap.namespaces = nsp;
+    heap.allocated += sizeof(*nsp);
+}
+
+void gc_remember(struct Namespace *nsp)
+{
+    // Namespaces that aren't on the heap are only ever roots
+    if (!nsp->on_heap || nsp->remembered) return;
+    nsp->remembered = true;
+    nsp->next_remembered = heap.remembered;
+    heap.remembered = nsp;
+}
+
+void gc_remember_object(Value v)
+{
+    // Young objects are scanned anyway when they're promoted
+    if (is_young(v)) return;
+    struct Object *o = as_object(v);
+    if (*remembered_flag(o)) return;
+    *remembered_flag(o) = true;
+    *next_remembered(o) = heap.remembered_objects;
+    heap.remembered_objects = o;
+}
+
+void gc_push_root(struct GCRoot *root, Value *values, unsigned int count, struct Namespace *nsp)
+{
+    root->values = values;
+    root->count = count;
+    root->nsp = nsp;
+    root->frames = NULL;
+    root->frame_count = 0;
+    root->prev = heap.roots;
+    heap.roots = root;
+}
+
+void gc_pop_root(struct GCRoot *root)
+{
+    assert(heap.roots == root);
+    heap.roots = root->prev;
+}
+
+void gc_minor_collect(void)
+{
+    // Young objects can only be pointed to by roots, namespaces, memos
+    // and hash tables that were given one, and old objects allocated since the last minor
+    // collection (which includes everything promoted by this one)
+    struct Object *scanned = heap.promoted;
+    for (struct GCRoot *root = heap.roots; root != NULL; root = root->prev)
+    {
+        for (unsigned int i = 0; i < root->count; i++)
+        {
+            promote(&root->values[i]);
+        }
+        for (struct Namespace *nsp = root->nsp; nsp != NULL && !nsp->on_heap; nsp = nsp->parent)
+        {
+            promote_bindings(nsp);
+        }
+        for (unsigned int i = 0; i < root->frame_count; i++)
+        {
+            for (struct Namespace *nsp = root->frames[i]; nsp != NULL && !nsp->on_heap; nsp = nsp->parent)
+            {
+                promote_bindings(nsp);
+            }
+        }
+    }
+    for (struct Namespace *nsp = heap.remembered; nsp != NULL; nsp = nsp->next_remembered)
+    {
+        promote_bindings(nsp);
+        nsp->remembered = false;
+    }
+    heap.remembered = NULL;
+    for (struct Object *o = heap.remembered_objects; o != NULL; o = *next_remembered(o))
+    {
+        promote_contents(o);
+        *remembered_flag(o) = false;
+    }
+    heap.remembered_objects = NULL;
+
+    // Promoted objects are added to the head of the list, so keep going
+    // until a pass doesn't promote anything new
+    while (heap.objects != scanned)
+    {
+        struct Object *head = heap.objects;
+        for (struct Object *o = head; o != scanned; o = o->next)
+        {
+            promote_contents(o);
+        }
+        scanned = head;
+    }
+    heap.promoted = heap.objects;
+
+    // Whatever wasn't promoted is garbage. Only lists and strings own
+    // anything, everything else is freed just by reusing the nursery
+    for (unsigned int i = 0; i < heap.nursery_top; i++)
+    {
+        struct Object *o = &heap.nursery[i];
+        if (o->next == NULL) release_object(o);
+    }
+    heap.nursery_top = 0;
+    heap.minor_collections++;
+}
+
+void gc_collect(void)
+{
+    // Empty the nursery first, so only the old generation needs sweeping
+    gc_minor_collect();
+
+    // Epoch 0 is what new objects start with, so never reuse it
+    heap.epoch++;
+    if (heap.epoch == 0) heap.epoch++;
+
+    mark_roots();
+    sweep();
+    heap.promoted = heap.objects;
+    heap.allocated = 0;
+    heap.collections++;
+    update_threshold();
+}
+
+void gc_set_heap_growth(unsigned int percent)
+{
+    heap.heap_growth = percent;
+    update_threshold();
+}
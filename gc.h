@@ -0,0 +1,157 @@
+#ifndef GC_INCLUDE
+#define GC_INCLUDE
+#include <stddef.h>
+#include "datatype.h"
+
+/* Constants */
+
+/* Bytes that may be allocated before the first collection, and the
+ * smallest gap ever left between two collections */
+#define MIN_COLLECTION_BYTES (1 << 20)
+
+/* After a collection, the heap may grow by this percentage of what
+ * survived before the next one runs */
+#define DEFAULT_HEAP_GROWTH 100
+
+/* Number of objects that fit in the nursery */
+#define NURSERY_SIZE 4096
+
+/* Data structures */
+
+struct Namespace;
+
+/* Precise generational collector. It owns every struct Object (and the
+ * list or string inside it) and every namespace made with new_nsp, as
+ * well as call frames that have been captured (see new_frame).
+ * Nothing is ever freed by hand.
+ *
+ * New objects are bump allocated in a small nursery. Most die young, so
+ * a minor collection copies out the few that survive, promoting them to
+ * the old generation, and empties the nursery in one go. When the
+ * nursery fills up between collections, objects go straight to the old
+ * generation. The old generation is collected by mark-sweep once enough
+ * has been promoted into it.
+ *
+ * Collections only happen at safe points (on entry to eval), so C code
+ * that doesn't evaluate anything can hold values freely. Anything held
+ * across a call to eval must be reachable from a registered root: the
+ * top level namespace, the form being evaluated, the frame of the
+ * procedure being run, arguments evaluated so far, and so on. Since
+ * young objects move when they are promoted, a value held in a C
+ * variable across a call to eval is only valid afterwards if it was
+ * registered itself; lists and strings inside objects never move. */
+
+/* A root registration lives on the C stack of whoever pushes it, so
+ * registering never allocates. Any part may be empty. frames holds the
+ * namespaces of the calls the VM is in the middle of (see vm.h), and is
+ * set by hand after pushing */
+struct GCRoot
+{
+    Value *values;
+    unsigned int count;
+    struct Namespace *nsp;
+    struct Namespace **frames;
+    unsigned int frame_count;
+    struct GCRoot *prev;
+};
+
+struct Heap
+{
+    /* Young objects live in nursery[0..nursery_top) */
+    struct Object *nursery;
+    unsigned int nursery_top;
+
+    /* Every old object and heap namespace, for sweeping. Old objects
+     * from the head of the list up to promoted were allocated since the
+     * last minor collection and may point into the nursery */
+    struct Object *objects;
+    struct Object *promoted;
+    struct Namespace *namespaces;
+
+    /* Heap namespaces, and old objects that can change (memos and hash
+     * tables), given a young value since the last minor collection */
+    struct Namespace *remembered;
+    struct Object *remembered_objects;
+
+    /* Innermost registered root */
+    struct GCRoot *roots;
+
+    /* Bytes allocated in the old generation since the last collection,
+     * and how many bytes may be allocated there before the next one */
+    size_t allocated;
+    size_t threshold;
+
+    /* Bytes that survived the last collection */
+    size_t live;
+    unsigned int heap_growth;
+
+    /* Incremented by each collection. Anything marked with the current
+     * epoch was reached by the last mark phase */
+    unsigned int epoch;
+    unsigned long collections;
+    unsigned long minor_collections;
+};
+
+extern struct Heap heap;
+
+/* Function definitions */
+
+/* Starts tracking a namespace allocated by new_nsp or captured */
+void gc_track_namespace(struct Namespace *nsp);
+
+/* Records that a young value was stored in nsp (see set_binding) */
+void gc_remember(struct Namespace *nsp);
+
+/* Records that a young value was stored in v, a memo or hash table (see
+ * memo_store and hash_table_put) */
+void gc_remember_object(Value v);
+
+/* Registers values[0..count) and nsp (and its parents) as roots until
+ * the matching gc_pop_root. Roots must be popped in reverse order */
+void gc_push_root(struct GCRoot *root, Value *values, unsigned int count, struct Namespace *nsp);
+
+/* Unregisters the innermost root, which must be root */
+void gc_pop_root(struct GCRoot *root);
+
+/* Promotes every young object that can be reached from a registered
+ * root and empties the nursery */
+void gc_minor_collect(void);
+
+/* Frees everything that can't be reached from a registered root */
+void gc_collect(void);
+
+/* Sets how far the heap may grow, as a percentage of the live heap,
+ * before it is collected again */
+void gc_set_heap_growth(unsigned int percent);
+
+/* Utility functions */
+
+/* Checks if v is an object in the nursery */
+static inline bool is_young(Value v)
+{
+    return is_object(v)
+        && as_object(v) >= heap.nursery
+        && as_object(v) < heap.nursery + NURSERY_SIZE;
+}
+
+/* Collects if the nursery is full or enough has been allocated since the
+ * last collection. Must only be called where every live value is rooted,
+ * except for *live, which is updated if it moves */
+static inline void gc_safe_point(Value *live)
+{
+    if (heap.nursery_top < NURSERY_SIZE && heap.allocated < heap.threshold) return;
+
+    struct GCRoot root;
+    gc_push_root(&root, live, 1, NULL);
+    if (heap.allocated >= heap.threshold)
+    {
+        gc_collect();
+    }
+    else
+    {
+        gc_minor_collect();
+    }
+    gc_pop_root(&root);
+}
+
+#endif
@@ -0,0 +1,152 @@
+#include <stdlib.h>
+#include "hashtable.h"
+#include "datatype.h"
+#include "equal.h"
+#include "gc.h"
+
+/* Internal constants */
+
+const unsigned int INIT_HASH_TABLE_CAPACITY = 8;
+
+/* Private function definitions */
+
+static inline uint64_t hash_key(struct HashTable *table, Value key)
+{
+    return table->equal ? hash_equal(key) : hash_eq(key);
+}
+
+// Gets the slot of the entry for key, or the empty slot where it would go
+// if there's none. The table must have slots
+static unsigned int find_slot(struct HashTable *table, uint64_t hash, Value key)
+{
+    unsigned int mask = table->slot_count - 1;
+    unsigned int i = hash & mask;
+    while (table->slots[i] != 0)
+    {
+        struct HashEntry *e = &table->entries[table->slots[i] - 1];
+        if (e->hash == hash && (table->equal ? is_equal(e->key, key) : is_eq(e->key, key))) break;
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+// Empties a slot, moving later entries of the same run back into the
+// gap so every entry can still be found from its home slot
+static void clear_slot(struct HashTable *table, unsigned int hole)
+{
+    unsigned int mask = table->slot_count - 1;
+    for (unsigned int i = (hole + 1) & mask; table->slots[i] != 0; i = (i + 1) & mask)
+    {
+        unsigned int home = table->entries[table->slots[i] - 1].hash & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            table->slots[hole] = table->slots[i];
+            hole = i;
+        }
+    }
+    table->slots[hole] = 0;
+}
+
+// Makes room for one more entry, keeping the table at most half full
+static bool reserve_entry(struct HashTable *table)
+{
+    if (table->count == table->capacity)
+    {
+        unsigned int capacity = table->capacity == 0 ? INIT_HASH_TABLE_CAPACITY : table->capacity * 2;
+        struct HashEntry *entries = realloc(table->entries, capacity * sizeof(*entries));
+        if (entries == NULL) return false;
+        table->entries = entries;
+        table->capacity = capacity;
+    }
+    if ((table->count + 1) * 2 <= table->slot_count) return true;
+
+    unsigned int slot_count = table->slot_count == 0 ? INIT_HASH_TABLE_CAPACITY * 2 : table->slot_count * 2;
+    unsigned int *slots = calloc(slot_count, sizeof(*slots));
+    if (slots == NULL) return false;
+    free(table->slots);
+    table->slots = slots;
+    table->slot_count = slot_count;
+    for (unsigned int e = 0; e < table->count; e++)
+    {
+        unsigned int i = table->entries[e].hash & (slot_count - 1);
+        while (slots[i] != 0) i = (i + 1) & (slot_count - 1);
+        slots[i] = e + 1;
+    }
+    return true;
+}
+
+/* Public functions */
+
+struct HashTable *new_hash_table(bool equal)
+{
+    struct HashTable *table = malloc(sizeof(*table));
+    if (table == NULL) return NULL;
+    table->equal = equal;
+    table->entries = NULL;
+    table->count = 0;
+    table->capacity = 0;
+    table->slots = NULL;
+    table->slot_count = 0;
+    table->remembered = false;
+    table->next_remembered = NULL;
+    return table;
+}
+
+void delete_hash_table(struct HashTable *table)
+{
+    if (table == NULL) return;
+    free(table->entries);
+    free(table->slots);
+    free(table);
+}
+
+Value hash_table_get(struct HashTable *table, Value key)
+{
+    if (table->count == 0) return NO_VALUE;
+    unsigned int slot = find_slot(table, hash_key(table, key), key);
+    return table->slots[slot] == 0 ? NO_VALUE : table->entries[table->slots[slot] - 1].value;
+}
+
+bool hash_table_put(Value v, Value key, Value value)
+{
+    struct HashTable *table = as_hash_table(v);
+    uint64_t hash = hash_key(table, key);
+    unsigned int slot = table->count > 0 ? find_slot(table, hash, key) : 0;
+    if (table->count > 0 && table->slots[slot] != 0)
+    {
+        table->entries[table->slots[slot] - 1].value = value;
+    }
+    else
+    {
+        if (!reserve_entry(table)) return false;
+        unsigned int e = table->count++;
+        table->entries[e].key = key;
+        table->entries[e].value = value;
+        table->entries[e].hash = hash;
+        table->slots[find_slot(table, hash, key)] = e + 1;
+    }
+
+    if (is_young(key) || is_young(value)) gc_remember_object(v);
+    return true;
+}
+
+bool hash_table_remove(struct HashTable *table, Value key)
+{
+    if (table->count == 0) return false;
+    unsigned int slot = find_slot(table, hash_key(table, key), key);
+    if (table->slots[slot] == 0) return false;
+
+    unsigned int e = table->slots[slot] - 1, last = table->count - 1;
+    clear_slot(table, slot);
+    if (e != last)
+    {
+        // Keep the entries packed by moving the last one into the gap
+        unsigned int mask = table->slot_count - 1;
+        unsigned int i = table->entries[last].hash & mask;
+        while (table->slots[i] != last + 1) i = (i + 1) & mask;
+        table->entries[e] = table->entries[last];
+        table->slots[i] = e + 1;
+    }
+    table->count--;
+    return true;
+}
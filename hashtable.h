@@ -0,0 +1,27 @@
+#ifndef HASHTABLE_INCLUDE
+#define HASHTABLE_INCLUDE
+#include <stdbool.h>
+#include "datatype.h"
+
+/* Function definitions */
+
+/* Creates an empty hash table whose keys are compared with equal? if
+ * equal is set, otherwise eq?. Returns NULL on failure */
+struct HashTable *new_hash_table(bool equal);
+
+/* Deletes a hash table and its buffers. Its keys and values are owned by
+ * the garbage collector and are left alone */
+void delete_hash_table(struct HashTable *table);
+
+/* Gets the value key is bound to in table, or NO_VALUE if it isn't */
+Value hash_table_get(struct HashTable *table, Value key);
+
+/* Binds key to value in table (a HASH_TABLE value), replacing what it
+ * was bound to before. Returns false if it runs out of memory */
+bool hash_table_put(Value table, Value key, Value value);
+
+/* Unbinds key in table. Returns false if it wasn't bound. The last entry
+ * moves into its place, so entries after it shift by one position */
+bool hash_table_remove(struct HashTable *table, Value key);
+
+#endif
@@ -3,6 +3,37 @@
 ;;; TODO: Most of this
 
 
+;; Syntax
+
+(define-syntax let
+  (syntax-rules ()
+    ((_ ((name val) ...) body1 body2 ...)
+     ((lambda (name ...) (begin body1 body2 ...)) val ...))))
+
+(define-syntax let*
+  (syntax-rules ()
+    ((_ () body1 body2 ...)
+     (let () body1 body2 ...))
+    ((_ ((name val) rest ...) body1 body2 ...)
+     (let ((name val)) (let* (rest ...) body1 body2 ...)))))
+
+(define-syntax cond
+  (syntax-rules (else)
+    ((_ (else e1 e2 ...))
+     (begin e1 e2 ...))
+    ((_ (test e1 e2 ...))
+     (if test (begin e1 e2 ...)))
+    ((_ (test e1 e2 ...) clause1 clause2 ...)
+     (if test (begin e1 e2 ...) (cond clause1 clause2 ...)))))
+
+(define-syntax when
+  (syntax-rules ()
+    ((_ test e1 e2 ...) (if test (begin e1 e2 ...)))))
+
+(define-syntax unless
+  (syntax-rules ()
+    ((_ test e1 e2 ...) (if test (begin) (begin e1 e2 ...)))))
+
 (define null? (lambda (val) (eq? val (quote ()))))
 
 ;; Math functions
@@ -34,7 +65,7 @@
 
 (define even? 
   (lambda (x)
-    (integer? (/ x 2))))
+    (= (remainder x 2) 0)))
 
 (define odd? 
   (lambda (x)
@@ -57,11 +88,6 @@
     (max-min-helper < (car x) (cdr x))))
 
 
-;; Boolean functions
-
-(define not (lambda (x) (if x #f #t)))
-
-
 ;; List functions
 
 (define reverse-helper
@@ -0,0 +1,451 @@
+#include <string.h>
+#include "error.h"
+#include "macro.h"
+#include "symbol.h"
+
+/* Data structures */
+
+/* What the pattern variables of a rule stand for is kept in a list of
+ * triples: the name, the number of ...s it's under, and the value. A
+ * variable under n ...s is bound to a list of values under n - 1 */
+#define BINDING_NAME 0
+#define BINDING_DEPTH 1
+#define BINDING_VALUE 2
+
+/* Interned names with a meaning of their own in syntax-rules */
+static char *s_syntax_rules, *s_ellipsis, *s_underscore;
+
+/* Private function definitions */
+
+static void intern_names(void)
+{
+    if (s_syntax_rules != NULL) return;
+    s_syntax_rules = intern_cstr("syntax-rules");
+    s_ellipsis = intern_cstr("...");
+    s_underscore = intern_cstr("_");
+}
+
+static inline bool is_name(Value v, char *name)
+{
+    return type_of(v) == SYMBOL && as_symbol(v) == name;
+}
+
+static bool is_literal(struct List *literals, Value v)
+{
+    for (unsigned int i = 0; i < literals->size; i++)
+    {
+        if (literals->values[i] == v) return true;
+    }
+    return false;
+}
+
+// Gets the index of the ... in a pattern or template list, or -1
+static long ellipsis_at(struct List *lst, unsigned int start)
+{
+    for (unsigned int i = start; i < lst->size; i++)
+    {
+        if (is_name(lst->values[i], s_ellipsis)) return i;
+    }
+    return -1;
+}
+
+// Checks that every ... in a pattern follows a subpattern, and that a
+// list has at most one. The elements before start aren't matched
+static bool valid_pattern(Value pattern, unsigned int start)
+{
+    if (type_of(pattern) != LIST) return true;
+    struct List *lst = as_list(pattern);
+    long at = ellipsis_at(lst, start);
+    if (at != -1 && ((unsigned int)at == start || ellipsis_at(lst, at + 1) != -1)) return false;
+    for (unsigned int i = start; i < lst->size; i++)
+    {
+        if (!valid_pattern(lst->values[i], 0)) return false;
+    }
+    return true;
+}
+
+// Checks that every ... in a template follows something to repeat
+static bool valid_template(Value template)
+{
+    if (type_of(template) != LIST) return !is_name(template, s_ellipsis);
+    struct List *lst = as_list(template);
+    for (unsigned int i = 0; i < lst->size; i++)
+    {
+        if (is_name(lst->values[i], s_ellipsis))
+        {
+            if (i == 0 || is_name(lst->values[i - 1], s_ellipsis)) return false;
+        }
+        else if (!valid_template(lst->values[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static long find_binding(struct List *bindings, Value name)
+{
+    for (unsigned int i = 0; i < bindings->size; i += 3)
+    {
+        if (bindings->values[i + BINDING_NAME] == name) return i;
+    }
+    return -1;
+}
+
+static bool bind(struct List *bindings, Value name, unsigned int depth, Value v)
+{
+    return append(bindings, name) && append(bindings, vfixnum(depth)) && append(bindings, v);
+}
+
+// Adds the name and depth of every variable in pattern to vars
+static bool pattern_vars(Value pattern, struct List *literals, unsigned int depth, struct List *vars)
+{
+    if (type_of(pattern) == SYMBOL)
+    {
+        if (is_name(pattern, s_underscore) || is_name(pattern, s_ellipsis)
+                || is_literal(literals, pattern))
+        {
+            return true;
+        }
+        return append(vars, pattern) && append(vars, vfixnum(depth));
+    }
+    if (type_of(pattern) != LIST) return true;
+    struct List *lst = as_list(pattern);
+    for (unsigned int i = 0; i < lst->size; i++)
+    {
+        bool repeated = i + 1 < lst->size && is_name(lst->values[i + 1], s_ellipsis);
+        if (!pattern_vars(lst->values[i], literals, depth + repeated, vars)) return false;
+    }
+    return true;
+}
+
+static bool match(struct Parser *parser, Value pattern, Value form, struct List *literals,
+        struct List *bindings);
+
+// Matches each of forms against pattern, binding every variable in it
+// to the list of what it matched each time
+static bool match_repeated(struct Parser *parser, Value pattern, Value *forms, unsigned int count,
+        struct List *literals, struct List *bindings)
+{
+    struct List *vars = list();
+    if (vars == NULL || !pattern_vars(pattern, literals, 0, vars))
+    {
+        delete_list(vars);
+        parser->error = OUT_OF_MEMORY;
+        return false;
+    }
+
+    // One list of matches per variable, filled in a match at a time
+    unsigned int nvars = vars->size / 2;
+    struct List **seqs = calloc(nvars + 1, sizeof(*seqs));
+    bool ok = seqs != NULL;
+    for (unsigned int j = 0; j < nvars && ok; j++)
+    {
+        seqs[j] = list();
+        ok = seqs[j] != NULL;
+    }
+    if (!ok) parser->error = OUT_OF_MEMORY;
+
+    for (unsigned int i = 0; i < count && ok; i++)
+    {
+        struct List *sub = list();
+        ok = sub != NULL && match(parser, pattern, forms[i], literals, sub);
+        for (unsigned int j = 0; j < nvars && ok; j++)
+        {
+            long at = find_binding(sub, vars->values[2 * j]);
+            ok = append(seqs[j], sub->values[at + BINDING_VALUE]);
+        }
+        delete_list(sub);
+    }
+    for (unsigned int j = 0; j < nvars && ok; j++)
+    {
+        unsigned int depth = (unsigned int)as_fixnum(vars->values[2 * j + 1]);
+        Value seq = vlist(seqs[j]);
+        if (seq != NO_VALUE) seqs[j] = NULL;
+        ok = seq != NO_VALUE && bind(bindings, vars->values[2 * j], depth + 1, seq);
+        if (!ok) parser->error = OUT_OF_MEMORY;
+    }
+
+    for (unsigned int j = 0; seqs != NULL && j < nvars; j++) delete_list(seqs[j]);
+    free(seqs);
+    delete_list(vars);
+    return ok;
+}
+
+// Matches the elements of form from start on against those of pattern
+static bool match_list(struct Parser *parser, struct List *pattern, struct List *form,
+        unsigned int start, struct List *literals, struct List *bindings)
+{
+    long at = ellipsis_at(pattern, start);
+    if (at == -1)
+    {
+        if (form->size != pattern->size) return false;
+        for (unsigned int i = start; i < pattern->size; i++)
+        {
+            if (!match(parser, pattern->values[i], form->values[i], literals, bindings)) return false;
+        }
+        return true;
+    }
+
+    // The subpattern before the ... takes whatever the elements around
+    // it don't need
+    unsigned int needed = pattern->size - 2, repeats;
+    if (form->size < needed) return false;
+    repeats = form->size - needed;
+    for (unsigned int i = start; i < (unsigned int)at - 1; i++)
+    {
+        if (!match(parser, pattern->values[i], form->values[i], literals, bindings)) return false;
+    }
+    if (!match_repeated(parser, pattern->values[at - 1], &form->values[at - 1], repeats,
+                literals, bindings))
+    {
+        return false;
+    }
+    for (unsigned int i = at + 1; i < pattern->size; i++)
+    {
+        if (!match(parser, pattern->values[i], form->values[i - 2 + repeats], literals, bindings))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool match(struct Parser *parser, Value pattern, Value form, struct List *literals,
+        struct List *bindings)
+{
+    switch (type_of(pattern))
+    {
+        case SYMBOL:
+            if (is_name(pattern, s_underscore)) return true;
+            if (is_literal(literals, pattern)) return form == pattern;
+            if (!bind(bindings, pattern, 0, form))
+            {
+                parser->error = OUT_OF_MEMORY;
+                return false;
+            }
+            return true;
+        case LIST:
+            if (type_of(form) != LIST) return false;
+            return match_list(parser, as_list(pattern), as_list(form), 0, literals, bindings);
+        case STRING:
+            return type_of(form) == STRING
+                && strcmp(from_scm_string(as_string(pattern)), from_scm_string(as_string(form))) == 0;
+        default:
+            return form == pattern;
+    }
+}
+
+// Copies the lists in a form, so no two places in code share one
+static Value copy_form(Value v)
+{
+    if (type_of(v) != LIST || v == EMPTY_LIST) return v;
+    struct List *lst = list_from(as_list(v)->values, as_list(v)->size);
+    if (lst == NULL) return NO_VALUE;
+    for (unsigned int i = 0; i < lst->size; i++)
+    {
+        lst->values[i] = copy_form(lst->values[i]);
+        if (lst->values[i] == NO_VALUE)
+        {
+            delete_list(lst);
+            return NO_VALUE;
+        }
+    }
+    Value copy = vlist(lst);
+    if (copy == NO_VALUE) delete_list(lst);
+    return copy;
+}
+
+// Adds the bindings of the repeated variables in template to vars
+static bool repeated_vars(Value template, struct List *bindings, struct List *vars)
+{
+    if (type_of(template) == SYMBOL)
+    {
+        long at = find_binding(bindings, template);
+        if (at == -1 || as_fixnum(bindings->values[at + BINDING_DEPTH]) == 0) return true;
+        for (unsigned int i = 0; i < vars->size; i++)
+        {
+            if (as_fixnum(vars->values[i]) == at) return true;
+        }
+        return append(vars, vfixnum(at));
+    }
+    if (type_of(template) != LIST) return true;
+    struct List *lst = as_list(template);
+    for (unsigned int i = 0; i < lst->size; i++)
+    {
+        if (!repeated_vars(lst->values[i], bindings, vars)) return false;
+    }
+    return true;
+}
+
+static Value instantiate(struct Parser *parser, Value template, struct List *bindings);
+
+// Adds template to out once for each value its repeated variables have
+static bool instantiate_repeated(struct Parser *parser, Value template, struct List *bindings,
+        struct List *out)
+{
+    struct List *vars = list();
+    if (vars == NULL || !repeated_vars(template, bindings, vars))
+    {
+        delete_list(vars);
+        parser->error = OUT_OF_MEMORY;
+        return false;
+    }
+    if (vars->size == 0)
+    {
+        delete_list(vars);
+        parser->error = INVALID_SYNTAX_RULES;
+        return false;
+    }
+
+    // Variables repeated together must have matched as many times
+    unsigned int count = as_list(bindings->values[as_fixnum(vars->values[0]) + BINDING_VALUE])->size;
+    bool ok = true;
+    for (unsigned int j = 1; j < vars->size && ok; j++)
+    {
+        ok = as_list(bindings->values[as_fixnum(vars->values[j]) + BINDING_VALUE])->size == count;
+    }
+    if (!ok) parser->error = NO_MATCHING_SYNTAX;
+
+    for (unsigned int i = 0; i < count && ok; i++)
+    {
+        // Each time round, the repeated variables stand for one of
+        // their values, one level down
+        struct List *sub = list_from(bindings->values, bindings->size);
+        if (sub == NULL)
+        {
+            parser->error = OUT_OF_MEMORY;
+            break;
+        }
+        for (unsigned int j = 0; j < vars->size; j++)
+        {
+            unsigned int at = (unsigned int)as_fixnum(vars->values[j]);
+            sub->values[at + BINDING_DEPTH] = vfixnum(as_fixnum(bindings->values[at + BINDING_DEPTH]) - 1);
+            sub->values[at + BINDING_VALUE] = as_list(bindings->values[at + BINDING_VALUE])->values[i];
+        }
+        Value v = instantiate(parser, template, sub);
+        delete_list(sub);
+        ok = v != NO_VALUE && append(out, v);
+        if (v != NO_VALUE && !ok) parser->error = OUT_OF_MEMORY;
+    }
+    delete_list(vars);
+    return ok;
+}
+
+// Fills in template with what the variables in bindings stand for
+static Value instantiate(struct Parser *parser, Value template, struct List *bindings)
+{
+    if (type_of(template) == SYMBOL)
+    {
+        long at = find_binding(bindings, template);
+        if (at == -1) return template;
+        if (as_fixnum(bindings->values[at + BINDING_DEPTH]) != 0)
+        {
+            // Used without the ...s it matched under
+            parser->error = INVALID_SYNTAX_RULES;
+            return NO_VALUE;
+        }
+        Value v = copy_form(bindings->values[at + BINDING_VALUE]);
+        if (v == NO_VALUE) parser->error = OUT_OF_MEMORY;
+        return v;
+    }
+    if (type_of(template) != LIST || template == EMPTY_LIST) return template;
+
+    struct List *tmpl = as_list(template);
+    struct List *out = list();
+    if (out == NULL)
+    {
+        parser->error = OUT_OF_MEMORY;
+        return NO_VALUE;
+    }
+    for (unsigned int i = 0; i < tmpl->size; i++)
+    {
+        bool ok;
+        if (i + 1 < tmpl->size && is_name(tmpl->values[i + 1], s_ellipsis))
+        {
+            ok = instantiate_repeated(parser, tmpl->values[i], bindings, out);
+            i++;
+        }
+        else
+        {
+            Value v = instantiate(parser, tmpl->values[i], bindings);
+            ok = v != NO_VALUE && append(out, v);
+            if (v != NO_VALUE && !ok) parser->error = OUT_OF_MEMORY;
+        }
+        if (!ok)
+        {
+            delete_list(out);
+            return NO_VALUE;
+        }
+    }
+    Value v = vlist(out);
+    if (v == NO_VALUE)
+    {
+        delete_list(out);
+        parser->error = OUT_OF_MEMORY;
+    }
+    return v;
+}
+
+/* Public functions */
+
+Value make_macro(struct Parser *parser, Value rules)
+{
+    intern_names();
+    parser->error = INVALID_SYNTAX_RULES;
+    if (type_of(rules) != LIST) return NO_VALUE;
+    struct List *spec = as_list(rules);
+    if (spec->size < 2 || !is_name(spec->values[0], s_syntax_rules)
+            || type_of(spec->values[1]) != LIST)
+    {
+        return NO_VALUE;
+    }
+    struct List *literals = as_list(spec->values[1]);
+    for (unsigned int i = 0; i < literals->size; i++)
+    {
+        if (type_of(literals->values[i]) != SYMBOL) return NO_VALUE;
+    }
+    for (unsigned int i = 2; i < spec->size; i++)
+    {
+        // The first element of a pattern is where the macro's name goes,
+        // and is never matched
+        Value rule = spec->values[i];
+        if (type_of(rule) != LIST || as_list(rule)->size != 2) return NO_VALUE;
+        Value pattern = as_list(rule)->values[0];
+        if (type_of(pattern) != LIST || pattern == EMPTY_LIST || !valid_pattern(pattern, 1)
+                || !valid_template(as_list(rule)->values[1]))
+        {
+            return NO_VALUE;
+        }
+    }
+    Value macro = vmacro(rules);
+    parser->error = (macro == NO_VALUE) ? OUT_OF_MEMORY : NO_ERROR;
+    return macro;
+}
+
+Value expand_macro(struct Parser *parser, Value macro, Value form)
+{
+    intern_names();
+    struct List *spec = as_list(as_object(macro)->macro);
+    struct List *literals = as_list(spec->values[1]);
+    for (unsigned int i = 2; i < spec->size; i++)
+    {
+        struct List *rule = as_list(spec->values[i]);
+        struct List *bindings = list();
+        if (bindings == NULL)
+        {
+            parser->error = OUT_OF_MEMORY;
+            return NO_VALUE;
+        }
+        if (match_list(parser, as_list(rule->values[0]), as_list(form), 1, literals, bindings))
+        {
+            Value v = instantiate(parser, rule->values[1], bindings);
+            delete_list(bindings);
+            return v;
+        }
+        delete_list(bindings);
+        if (parser->error != NO_ERROR) return NO_VALUE;
+    }
+    parser->error = NO_MATCHING_SYNTAX;
+    return NO_VALUE;
+}
@@ -0,0 +1,25 @@
+#ifndef MACRO_INCLUDE
+#define MACRO_INCLUDE
+#include "datatype.h"
+#include "parser.h"
+
+/* Function definitions */
+
+/* Makes a macro from a (syntax-rules (literal ...) (pattern template) ...)
+ * form. Returns NO_VALUE and sets parser->error if it's malformed */
+Value make_macro(struct Parser *parser, Value rules);
+
+/* Rewrites form, a use of macro, with the template of the first rule
+ * whose pattern matches it. In a pattern, _ matches anything, a literal
+ * matches only itself, and any other name matches anything and stands
+ * for it in the template. A subpattern followed by ... matches any
+ * number of elements, and a template followed by ... is repeated once
+ * for each of them.
+ *
+ * Expansion isn't hygienic: names the template brings in mean whatever
+ * they mean where the macro is used. The result shares nothing with the
+ * macro or with form, so it can be resolved in place. Returns NO_VALUE
+ * and sets parser->error if no rule matches */
+Value expand_macro(struct Parser *parser, Value macro, Value form);
+
+#endif
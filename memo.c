@@ -0,0 +1,228 @@
+#include <stdlib.h>
+#include "memo.h"
+#include "datatype.h"
+#include "equal.h"
+#include "gc.h"
+
+/* Internal constants */
+
+const unsigned int INIT_MEMO_CAPACITY = 8;
+
+/* Private function definitions */
+
+// Estimates the bytes an entry takes, counting its share of the table
+static size_t entry_bytes(Value args, Value value)
+{
+    size_t bytes = sizeof(struct MemoEntry) + 2 * sizeof(unsigned int);
+    if (is_object(args)) bytes += as_object(args)->size;
+    if (is_object(value)) bytes += as_object(value)->size;
+    return bytes;
+}
+
+static bool is_entry_for(struct MemoEntry *e, uint64_t hash, const Value *argv, unsigned int argc)
+{
+    if (e->hash != hash) return false;
+    struct List *args = as_list(e->args);
+    if (args->size != argc) return false;
+    for (unsigned int i = 0; i < argc; i++)
+    {
+        if (!is_equal(args->values[i], argv[i])) return false;
+    }
+    return true;
+}
+
+// Gets the slot of the entry for argv[0..argc), or the empty slot where
+// it would go if there's none. The table must not be empty
+static unsigned int find_slot(struct Memo *memo, uint64_t hash, const Value *argv, unsigned int argc)
+{
+    unsigned int mask = memo->slot_count - 1;
+    unsigned int i = hash & mask;
+    while (memo->slots[i] != 0
+            && !is_entry_for(&memo->entries[memo->slots[i] - 1], hash, argv, argc))
+    {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+// Gets the slot holding entry e
+static unsigned int slot_of(struct Memo *memo, unsigned int e)
+{
+    unsigned int mask = memo->slot_count - 1;
+    unsigned int i = memo->entries[e].hash & mask;
+    while (memo->slots[i] != e + 1) i = (i + 1) & mask;
+    return i;
+}
+
+// Empties a slot, moving later entries of the same run back into the
+// gap so every entry can still be found from its home slot
+static void clear_slot(struct Memo *memo, unsigned int hole)
+{
+    unsigned int mask = memo->slot_count - 1;
+    for (unsigned int i = (hole + 1) & mask; memo->slots[i] != 0; i = (i + 1) & mask)
+    {
+        unsigned int home = memo->entries[memo->slots[i] - 1].hash & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            memo->slots[hole] = memo->slots[i];
+            hole = i;
+        }
+    }
+    memo->slots[hole] = 0;
+}
+
+static void unlink_entry(struct Memo *memo, unsigned int e)
+{
+    struct MemoEntry *entry = &memo->entries[e];
+    if (entry->newer == MEMO_NONE) memo->newest = entry->older;
+    else memo->entries[entry->newer].older = entry->older;
+    if (entry->older == MEMO_NONE) memo->oldest = entry->newer;
+    else memo->entries[entry->older].newer = entry->newer;
+}
+
+static void link_newest(struct Memo *memo, unsigned int e)
+{
+    memo->entries[e].newer = MEMO_NONE;
+    memo->entries[e].older = memo->newest;
+    if (memo->newest == MEMO_NONE) memo->oldest = e;
+    else memo->entries[memo->newest].newer = e;
+    memo->newest = e;
+}
+
+// Forgets entry e. The last entry takes its place, so the entries stay
+// packed
+static void remove_entry(struct Memo *memo, unsigned int e)
+{
+    unsigned int last = memo->count - 1;
+    clear_slot(memo, slot_of(memo, e));
+    unlink_entry(memo, e);
+    memo->bytes -= memo->entries[e].bytes;
+
+    if (e != last)
+    {
+        unsigned int slot = slot_of(memo, last);
+        struct MemoEntry *entry = &memo->entries[e];
+        *entry = memo->entries[last];
+        memo->slots[slot] = e + 1;
+        if (entry->newer == MEMO_NONE) memo->newest = e;
+        else memo->entries[entry->newer].older = e;
+        if (entry->older == MEMO_NONE) memo->oldest = e;
+        else memo->entries[entry->older].newer = e;
+    }
+    memo->count--;
+}
+
+// Makes room for one more entry, keeping the table at most half full
+static bool reserve_entry(struct Memo *memo)
+{
+    if (memo->count == memo->capacity)
+    {
+        unsigned int capacity = memo->capacity == 0 ? INIT_MEMO_CAPACITY : memo->capacity * 2;
+        struct MemoEntry *entries = realloc(memo->entries, capacity * sizeof(*entries));
+        if (entries == NULL) return false;
+        memo->entries = entries;
+        memo->capacity = capacity;
+    }
+    if ((memo->count + 1) * 2 <= memo->slot_count) return true;
+
+    unsigned int slot_count = memo->slot_count == 0 ? INIT_MEMO_CAPACITY * 2 : memo->slot_count * 2;
+    unsigned int *slots = calloc(slot_count, sizeof(*slots));
+    if (slots == NULL) return false;
+    free(memo->slots);
+    memo->slots = slots;
+    memo->slot_count = slot_count;
+    for (unsigned int e = 0; e < memo->count; e++)
+    {
+        unsigned int i = memo->entries[e].hash & (slot_count - 1);
+        while (slots[i] != 0) i = (i + 1) & (slot_count - 1);
+        slots[i] = e + 1;
+    }
+    return true;
+}
+
+/* Public functions */
+
+struct Memo *new_memo(Value proc, unsigned int max_entries, size_t max_bytes)
+{
+    struct Memo *memo = malloc(sizeof(*memo));
+    if (memo == NULL) return NULL;
+    memo->proc = proc;
+    memo->entries = NULL;
+    memo->count = 0;
+    memo->capacity = 0;
+    memo->slots = NULL;
+    memo->slot_count = 0;
+    memo->newest = MEMO_NONE;
+    memo->oldest = MEMO_NONE;
+    memo->max_entries = max_entries;
+    memo->max_bytes = max_bytes;
+    memo->bytes = 0;
+    memo->hits = 0;
+    memo->misses = 0;
+    memo->remembered = false;
+    memo->next_remembered = NULL;
+    return memo;
+}
+
+void delete_memo(struct Memo *memo)
+{
+    if (memo == NULL) return;
+    free(memo->entries);
+    free(memo->slots);
+    free(memo);
+}
+
+Value memo_lookup(struct Memo *memo, const Value *argv, unsigned int argc)
+{
+    if (memo->count > 0)
+    {
+        unsigned int slot = find_slot(memo, hash_values(argv, argc), argv, argc);
+        if (memo->slots[slot] != 0)
+        {
+            unsigned int e = memo->slots[slot] - 1;
+            unlink_entry(memo, e);
+            link_newest(memo, e);
+            memo->hits++;
+            return memo->entries[e].value;
+        }
+    }
+    memo->misses++;
+    return NO_VALUE;
+}
+
+void memo_store(Value v, Value args, Value value)
+{
+    struct Memo *memo = as_memo(v);
+    struct List *lst = as_list(args);
+    uint64_t hash = hash_values(lst->values, lst->size);
+    size_t bytes = entry_bytes(args, value);
+    if (value == NO_VALUE || memo->max_entries == 0 || bytes > memo->max_bytes) return;
+
+    // The procedure may have been called with the same arguments again
+    // before it returned, so the entry can already be there
+    if (memo->count > 0)
+    {
+        unsigned int slot = find_slot(memo, hash, lst->values, lst->size);
+        if (memo->slots[slot] != 0) remove_entry(memo, memo->slots[slot] - 1);
+    }
+
+    // Make room by forgetting the least recently used entries
+    while (memo->count > 0
+            && (memo->count >= memo->max_entries || memo->bytes + bytes > memo->max_bytes))
+    {
+        remove_entry(memo, memo->oldest);
+    }
+    if (!reserve_entry(memo)) return;
+
+    unsigned int e = memo->count++;
+    struct MemoEntry *entry = &memo->entries[e];
+    entry->args = args;
+    entry->value = value;
+    entry->hash = hash;
+    entry->bytes = bytes;
+    memo->slots[find_slot(memo, hash, lst->values, lst->size)] = e + 1;
+    link_newest(memo, e);
+    memo->bytes += bytes;
+
+    if (is_young(args) || is_young(value)) gc_remember_object(v);
+}
@@ -0,0 +1,35 @@
+#ifndef MEMO_INCLUDE
+#define MEMO_INCLUDE
+#include <stddef.h>
+#include "datatype.h"
+
+/* Constants */
+
+/* Budget of a memo made without one */
+#define MEMO_DEFAULT_ENTRIES 65536
+#define MEMO_DEFAULT_BYTES ((size_t)64 << 20)
+
+/* Function definitions */
+
+/* Creates an empty memo for proc, a procedure, that remembers at most
+ * max_entries values and max_bytes bytes worth of them. Returns NULL on
+ * failure */
+struct Memo *new_memo(Value proc, unsigned int max_entries, size_t max_bytes);
+
+/* Deletes a memo and its table. What it remembers is owned by the
+ * garbage collector and is left alone */
+void delete_memo(struct Memo *memo);
+
+/* Gets the value memo remembers for the arguments argv[0..argc), making
+ * it the most recently used, or NO_VALUE if it doesn't remember one.
+ * Counts a hit or a miss either way */
+Value memo_lookup(struct Memo *memo, const Value *argv, unsigned int argc);
+
+/* Remembers that the procedure of memo (a MEMO value) returned value for
+ * args, a list of arguments, forgetting the least recently used values
+ * if that goes over budget. The bytes an entry takes are estimated from
+ * the arguments list and value themselves, not what they point to. If
+ * there's no memory for it, the value is simply not remembered */
+void memo_store(Value memo, Value args, Value value);
+
+#endif
@@ -1,91 +1,279 @@
+
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
-#include <float.h>
 #include <assert.h>
 #include "error.h"
 #include "parser.h"
 #include "datatype.h"
 #include "namespace.h"
 #include "eval.h"
+#include "gc.h"
+
+/* Frames whose calls have returned, linked through next */
+static struct Namespace *frame_pool = NULL;
+static unsigned int pooled_frames = 0;
+
+/* Hashes an interned name. Names are unique, so their address is the key */
+static inline unsigned int hash_name(char *name)
+{
+    return (unsigned int)(((uintptr_t)name >> 3) * 2654435761u);
+}
+
+// Inserts b into the hash index, assumes there is room
+static void index_binding(struct Namespace *nsp, struct Binding *b)
+{
+    unsigned int mask = nsp->index_capacity - 1;
+    unsigned int i = hash_name(b->name) & mask;
+    while (nsp->index[i] != NULL) i = (i + 1) & mask;
+    nsp->index[i] = b;
+}
+
+// Rebuilds the hash index with room for at least twice the current bindings.
+// Returns 1 on success
+static int grow_index(struct Namespace *nsp)
+{
+    unsigned int capacity = nsp->index_capacity == 0
+        ? SMALL_NAMESPACE_SIZE * 4
+        : nsp->index_capacity * 2;
+    struct Binding **index = calloc(capacity, sizeof(*index));
+    if (index == NULL) return 0;
+
+    free(nsp->index);
+    nsp->index = index;
+    nsp->index_capacity = capacity;
+    for (unsigned int pos = 0; pos < nsp->size; pos++)
+    {
+        index_binding(nsp, binding_at(nsp, pos));
+    }
+    return 1;
+}
+
+// Makes room for one more binding by adding a block as big as all the
+// bindings so far. Returns 1 on success
+static int grow_bindings(struct Namespace *nsp)
+{
+    unsigned int block = 0, size = INLINE_BINDINGS;
+    for (; size < nsp->capacity; size *= 2) block++;
+    if (block == BINDING_BLOCKS) return 0;
+
+    if (nsp->blocks == NULL)
+    {
+        nsp->blocks = calloc(BINDING_BLOCKS, sizeof(*nsp->blocks));
+        if (nsp->blocks == NULL) return 0;
+    }
+    nsp->blocks[block] = malloc(nsp->capacity * sizeof(struct Binding));
+    if (nsp->blocks[block] == NULL) return 0;
+    nsp->capacity *= 2;
+    return 1;
+}
 
-// Probably fine if val is NULL, but symbol must be a symbol
-void new_var(Binding *bind, struct Value *symbol, struct Value *val)
+// Frees the bindings nsp keeps outside of itself
+static void free_bindings(struct Namespace *nsp)
 {
-    assert(symbol->type == SYMBOL);
+    if (nsp->blocks != NULL)
+    {
+        for (unsigned int i = 0; i < BINDING_BLOCKS; i++) free(nsp->blocks[i]);
+        free(nsp->blocks);
+    }
+    free(nsp->index);
+}
 
-    bind->type = LIST;
-    bind->list = list();
+struct Binding *add_binding(struct Namespace *nsp, char *lname, Value val)
+{
+    if (nsp->size == nsp->capacity && !grow_bindings(nsp))
+    {
+        return NULL;
+    }
+    struct Binding *b = binding_at(nsp, nsp->size);
+    b->name = lname;
+    b->value = val;
+    nsp->size++;
+    if (is_young(val)) gc_remember(nsp);
 
-    append(bind->list, symbol);
-    append(bind->list, val);
+    // Keep the hash index at most half full once the namespace is big
+    if (nsp->size > SMALL_NAMESPACE_SIZE)
+    {
+        if (nsp->size * 2 > nsp->index_capacity)
+        {
+            if (!grow_index(nsp))
+            {
+                nsp->size--;
+                return NULL;
+            }
+        }
+        else
+        {
+            index_binding(nsp, b);
+        }
+    }
+    return b;
 }
 
 void init_nsp(struct Namespace *nsp, struct Namespace *parent)
 {
-    nsp->bindings = list();
+    nsp->size = 0;
+    nsp->capacity = INLINE_BINDINGS;
+    nsp->blocks = NULL;
+    nsp->index_capacity = 0;
+    nsp->index = NULL;
     nsp->parent = parent;
+    nsp->mark = 0;
+    nsp->on_heap = false;
+    nsp->remembered = false;
+    nsp->pooled = false;
+    nsp->next = NULL;
+    nsp->next_remembered = NULL;
 }
 
 struct Namespace *new_nsp(struct Namespace *parent)
 {
     struct Namespace *nsp = malloc(sizeof(*nsp));
+    if (nsp == NULL) return NULL;
+    init_nsp(nsp, parent);
+    gc_track_namespace(nsp);
+    return nsp;
+}
+
+struct Namespace *new_frame(struct Namespace *parent)
+{
+    struct Namespace *nsp = frame_pool;
+    if (nsp != NULL)
+    {
+        frame_pool = nsp->next;
+        pooled_frames--;
+    }
+    else
+    {
+        nsp = malloc(sizeof(*nsp));
+        if (nsp == NULL) return NULL;
+    }
     init_nsp(nsp, parent);
+    nsp->pooled = true;
     return nsp;
 }
 
-// Gets index within current bindings of a name, if it exists
-long get_binding_index(Bindings *binds, char *lname)
+void capture_frame(struct Namespace *nsp)
+{
+    if (!nsp->pooled || nsp->on_heap) return;
+    gc_track_namespace(nsp);
+
+    // Its bindings weren't remembered as they were made, since the VM
+    // roots frames until they're captured
+    gc_remember(nsp);
+}
+
+void release_frame(struct Namespace *nsp)
+{
+    if (!nsp->pooled || nsp->on_heap) return;
+    if (pooled_frames == FRAME_POOL_SIZE)
+    {
+        free_nsp(nsp);
+        return;
+    }
+    // Only the bindings that fit inline are kept, most frames never
+    // have more than those
+    free_bindings(nsp);
+    nsp->blocks = NULL;
+    nsp->index = NULL;
+    nsp->next = frame_pool;
+    frame_pool = nsp;
+    pooled_frames++;
+}
+
+void free_nsp(struct Namespace *nsp)
+{
+    free_bindings(nsp);
+    free(nsp);
+}
+
+struct Binding *find_binding(struct Namespace *nsp, char *lname)
 {
-    if (is_empty(binds)) return -1;
+    if (nsp->index == NULL)
+    {
+        // Small namespace, names are interned so comparing pointers is enough
+        for (unsigned int i = 0; i < nsp->size; i++)
+        {
+            struct Binding *b = binding_at(nsp, i);
+            if (b->name == lname)
+            {
+                return b;
+            }
+        }
+        return NULL;
+    }
 
-    char *name;
-    for (unsigned int i = 0; i < binds->size; i++)
+    unsigned int mask = nsp->index_capacity - 1;
+    unsigned int i = hash_name(lname) & mask;
+    for (; nsp->index[i] != NULL; i = (i + 1) & mask)
     {
-        // Found variable with this name
-        name = get_name(binds->values[i])->symbol;
-        if (strcmp(name, lname) == 0)
+        if (nsp->index[i]->name == lname)
         {
-            return i;
+            return nsp->index[i];
         }
     }
-    return -1;
+    return NULL;
 }
 
 // Binds name to a value in the current namespace
-void define(struct Namespace *nsp, struct Value *symbol, struct Value *val)
+void define(struct Namespace *nsp, Value symbol, Value val)
 {
-    long l = get_binding_index(nsp->bindings, symbol->symbol);
+    assert(type_of(symbol) == SYMBOL);
+    struct Binding *b = find_binding(nsp, as_symbol(symbol));
 
-    // Binding exists in this namespace, overwrite its old value with the new one
-    if (l != -1)
+    // Binding exists in this namespace (maybe as a cell code is waiting
+    // on), overwrite its old value with the new one
+    if (b != NULL)
     {
-        set_value(nsp->bindings->values[(unsigned int)l], val);
+        set_binding(nsp, b, val);
         return;
     }
 
     // If name isn't bound in the namespace, create a new binding
-    Binding *bind = malloc(sizeof(*bind));
-    new_var(bind, symbol, val);
-    append(nsp->bindings, bind);
-    return;
+    add_binding(nsp, as_symbol(symbol), val);
 }
 
-// This function looks for variable with the given name
-struct Value *lookup_var(struct Namespace *nsp, char *lname)
+struct Binding *global_cell(struct Namespace *nsp, char *lname)
 {
-    // Find index of variable with this name
-    long index = get_binding_index(nsp->bindings, lname);
+    struct Binding *b = find_binding(nsp, lname);
+    return (b != NULL) ? b : add_binding(nsp, lname, UNBOUND);
+}
 
-    if (index != -1)
-    {
-        return get_value(nsp->bindings->values[(unsigned int)index]);
-    }
-    else if (nsp->parent != NULL)
+void set_binding(struct Namespace *nsp, struct Binding *b, Value val)
+{
+    b->value = val;
+    if (is_young(val)) gc_remember(nsp);
+}
+
+struct Namespace *lookup_owner(struct Namespace *nsp, char *lname)
+{
+    for (; nsp != NULL; nsp = nsp->parent)
     {
-        return lookup_var(nsp->parent, lname);
+        struct Binding *b = find_binding(nsp, lname);
+        if (b != NULL)
+        {
+            return (b->value == UNBOUND) ? NULL : nsp;
+        }
     }
-    else 
+    return NULL;
+}
+
+struct Binding *lookup_binding(struct Namespace *nsp, char *lname)
+{
+    for (; nsp != NULL; nsp = nsp->parent)
     {
-        return NULL;
+        struct Binding *b = find_binding(nsp, lname);
+        if (b != NULL)
+        {
+            return (b->value == UNBOUND) ? NULL : b;
+        }
     }
+    return NULL;
+}
+
+// This function looks for variable with the given name
+Value lookup_var(struct Namespace *nsp, char *lname)
+{
+    struct Binding *b = lookup_binding(nsp, lname);
+    return (b == NULL) ? NO_VALUE : b->value;
 }
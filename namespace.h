@@ -3,29 +3,75 @@
 
 #include "datatype.h"
 
+/* Constants */
+
+/* Bindings stored inside the namespace itself before spilling to the heap */
+#define INLINE_BINDINGS 4
+
+/* Most heap blocks of bindings a namespace can have. Block i holds
+ * INLINE_BINDINGS << i of them, so this is far more than will fit */
+#define BINDING_BLOCKS 28
+
+/* Namespaces larger than this get a hash index over their bindings */
+#define SMALL_NAMESPACE_SIZE 8
+
+/* Most frames kept around for reuse once their calls have returned */
+#define FRAME_POOL_SIZE 1024
+
 /* Data structures */
 
-/* Binding is an alias for a value of a list of symbol-value pairs 
- * Binding should only contain:
- * - 1 symbol as the first element
- * - 1 value as the second element
- * - Should not contain more values */
-typedef struct Value Binding;
+/* Binding pairs an interned symbol name with the value bound to it */
+struct Binding
+{
+    char *name;
+    Value value;
+};
 
-/* Bindings is just an alias for a list of lists of the 
- * form of Binding Bindings should *not* contain 
- * non-Binding elements 
+/* Namespace stores its bindings in the order they were defined and a
+ * pointer to the parent namespace.
  *
- * At some point we should replace this with a real 
- * hash table */
-typedef struct List Bindings;
-
-/* Namespace stores a list of bindings and a pointer
- * to the parent namespace */
+ * Procedure scopes usually only hold a few parameters, so small namespaces
+ * keep their bindings inline and are searched linearly (a handful of
+ * pointer compares). Once a namespace grows past SMALL_NAMESPACE_SIZE it
+ * also maintains an open-addressing hash index over the bindings, so
+ * lookups in the top level stay O(1) no matter how many definitions exist.
+ *
+ * Bindings past the inline ones go in heap blocks that double in size
+ * and are never reallocated, so a binding never moves once defined. Code
+ * keeps pointers to top level bindings, which act as the cells of global
+ * variables (see resolve.h). Code can refer to a global before it's
+ * defined, in which case its binding holds UNBOUND until it is. */
 struct Namespace
 {
-    Bindings *bindings;
+    unsigned int size;
+    unsigned int capacity;
+
+    /* Table of BINDING_BLOCKS blocks, the ones past capacity not yet
+     * allocated. NULL until the inline bindings run out */
+    struct Binding **blocks;
+
+    /* Hash index: each slot holds a binding, or NULL if the slot is
+     * empty. NULL while the namespace is small. */
+    unsigned int index_capacity;
+    struct Binding **index;
+
     struct Namespace *parent;
+    struct Binding inline_bindings[INLINE_BINDINGS];
+
+    /* Collector bookkeeping (see gc.h). Only namespaces made by new_nsp
+     * and captured frames are on the heap, the rest are owned by whoever
+     * initialized them. Heap namespaces that have been given a young
+     * value since the last minor collection are remembered, so it can
+     * update them */
+    unsigned int mark;
+    bool on_heap;
+    bool remembered;
+
+    /* Made by new_frame, so it goes back to the pool when its call is
+     * over unless it has been captured */
+    bool pooled;
+    struct Namespace *next;
+    struct Namespace *next_remembered;
 };
 
 
@@ -35,40 +81,85 @@ struct Namespace
  * If no parent namespace exists, pass in NULL for parent */
 void init_nsp(struct Namespace *nsp, struct Namespace *parent);
 
-/* Allocates a new namespace, then runs init_nsp with its parent */
+/* Allocates a new namespace owned by the garbage collector, then runs
+ * init_nsp with its parent. Returns NULL on failure */
 struct Namespace *new_nsp(struct Namespace *parent);
 
+/* Gets a namespace for a procedure call to bind its arguments in, as
+ * init_nsp would leave it. Frames are recycled, so making one rarely
+ * allocates. The frame belongs to the call (the VM roots it) until it
+ * is given back with release_frame or captured. Returns NULL on failure */
+struct Namespace *new_frame(struct Namespace *parent);
+
+/* Hands a frame over to the collector because something that can outlive
+ * its call, like a closure, refers to it. Other namespaces are left alone */
+void capture_frame(struct Namespace *nsp);
+
+/* Gives back a frame whose call is over, unless it has been captured */
+void release_frame(struct Namespace *nsp);
+
+/* Frees a namespace made by new_nsp or new_frame, bindings and all */
+void free_nsp(struct Namespace *nsp);
+
+/* Finds the binding for lname in this namespace only (not its parents).
+ * lname must be interned. Returns NULL if not found */
+struct Binding *find_binding(struct Namespace *nsp, char *lname);
+
+/* Finds the closest namespace, starting at nsp and going through its
+ * parents, that binds lname. lname must be interned. Returns NULL if
+ * not found. Bindings that are UNBOUND don't count, here and in the
+ * other lookups */
+struct Namespace *lookup_owner(struct Namespace *nsp, char *lname);
+
+/* Finds the binding for lname in this namespace or the closest parent
+ * that has one. lname must be interned. Returns NULL if not found */
+struct Binding *lookup_binding(struct Namespace *nsp, char *lname);
+
 /* Checks if variable is bound to lname in current namespace and
- * recursively checks parents if not found
- * Returns NULL if not found */
-struct Value *lookup_var(struct Namespace *nsp, char *lname);
+ * recursively checks parents if not found. lname must be interned.
+ * Returns NO_VALUE if not found */
+Value lookup_var(struct Namespace *nsp, char *lname);
 
 /* Adds binds symbol to input value within current namespace's bindings */
-void define(struct Namespace *nsp, struct Value *symbol, struct Value *val);
+void define(struct Namespace *nsp, Value symbol, Value val);
 
-/* Utility functions */
+/* Adds a binding for lname, which must not be bound in nsp yet. Saves
+ * define the search when filling in a new frame. Returns NULL on failure */
+struct Binding *add_binding(struct Namespace *nsp, char *lname, Value val);
 
-/* helper functions for handling bindings */
-static inline struct Value *get_name(Binding *b)
-{
-    return list_lookup(b->list, 0);
-}
+/* Gets the binding for lname in top level namespace nsp to use as its
+ * cell, adding one that is UNBOUND if there isn't one yet. lname must be
+ * interned. Returns NULL on failure */
+struct Binding *global_cell(struct Namespace *nsp, char *lname);
+
+/* Stores val in b, which must be one of nsp's bindings. All writes to
+ * existing bindings go through here so the collector sees them */
+void set_binding(struct Namespace *nsp, struct Binding *b, Value val);
+
+/* Utility functions */
 
-static inline struct Value *get_value(Binding *b)
+/* Gets the binding at position pos, which must be below nsp->capacity */
+static inline struct Binding *binding_at(struct Namespace *nsp, unsigned int pos)
 {
-    return list_lookup(b->list, 1);
+    if (pos < INLINE_BINDINGS) return &nsp->inline_bindings[pos];
+    unsigned int block = 0, start = INLINE_BINDINGS;
+    for (; start * 2 <= pos; start *= 2) block++;
+    return &nsp->blocks[block][pos - start];
 }
 
-static inline void set_value(Binding *b, struct Value *v)
+/* Gets the namespace depth levels above nsp */
+static inline struct Namespace *local_frame(struct Namespace *nsp, unsigned short depth)
 {
-    b->list->values[1] = v;
+    for (; depth > 0; depth--) nsp = nsp->parent;
+    return nsp;
 }
 
-static inline void push_var(Bindings *bindings, Binding *bind)
+/* Gets the binding a resolved variable reference points to: the binding
+ * at position slot of the namespace depth levels above nsp */
+static inline struct Binding *local_binding(struct Namespace *nsp, unsigned short depth, unsigned short slot)
 {
-    append(bindings, bind);
+    nsp = local_frame(nsp, depth);
+    return (slot < nsp->size) ? binding_at(nsp, slot) : NULL;
 }
 
-
 #endif
-
@@ -0,0 +1,697 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "number.h"
+
+/* Data structures */
+
+/* An exact integer's sign and magnitude. Bignums lend theirs, fixnums
+ * are split into small, so an Integer must not be copied */
+struct Integer
+{
+    bool negative;
+    unsigned int length;
+    const uint32_t *digits;
+    uint32_t small[2];
+};
+
+/* Powers of ten used to split numbers for decimal conversion, where
+ * digits[k] is 10^(9 2^k), made as they're needed by squaring */
+struct Powers
+{
+    unsigned int count;
+    uint32_t *digits[32];
+    unsigned int length[32];
+};
+
+/* Private function definitions */
+
+static void load_integer(Value v, struct Integer *n)
+{
+    if (is_fixnum(v))
+    {
+        int64_t x = as_fixnum(v);
+        uint64_t magnitude = (x < 0) ? -(uint64_t)x : (uint64_t)x;
+        n->negative = (x < 0);
+        n->small[0] = (uint32_t)magnitude;
+        n->small[1] = (uint32_t)(magnitude >> 32);
+        n->length = (n->small[1] != 0) ? 2 : (n->small[0] != 0);
+        n->digits = n->small;
+        return;
+    }
+    struct Bignum *big = as_bignum(v);
+    n->negative = big->negative;
+    n->length = big->length;
+    n->digits = big->digits;
+}
+
+// Drops leading zeroes
+static inline unsigned int trim(const uint32_t *digits, unsigned int length)
+{
+    while (length > 0 && digits[length - 1] == 0) length--;
+    return length;
+}
+
+// Makes a value from a sign and magnitude, taking ownership of digits
+// (which is malloc'd). Small enough magnitudes become fixnums
+static Value make_integer(bool negative, uint32_t *digits, unsigned int length)
+{
+    length = trim(digits, length);
+    if (length <= 2)
+    {
+        uint64_t magnitude = (length == 0) ? 0 : digits[0];
+        if (length == 2) magnitude |= (uint64_t)digits[1] << 32;
+        if (magnitude <= (uint64_t)FIXNUM_MAX)
+        {
+            free(digits);
+            return vfixnum(negative ? -(int64_t)magnitude : (int64_t)magnitude);
+        }
+    }
+
+    struct Bignum *big = malloc(sizeof(*big));
+    if (big == NULL)
+    {
+        free(digits);
+        return NO_VALUE;
+    }
+    big->negative = negative;
+    big->length = length;
+    big->digits = digits;
+    Value v = vbignum(big);
+    if (v == NO_VALUE) delete_bignum(big);
+    return v;
+}
+
+/* Magnitudes. Lengths needn't be trimmed unless it says so */
+
+static int compare_magnitudes(const uint32_t *a, unsigned int na, const uint32_t *b, unsigned int nb)
+{
+    na = trim(a, na);
+    nb = trim(b, nb);
+    if (na != nb) return (na < nb) ? -1 : 1;
+    for (unsigned int i = na; i > 0; i--)
+    {
+        if (a[i - 1] != b[i - 1]) return (a[i - 1] < b[i - 1]) ? -1 : 1;
+    }
+    return 0;
+}
+
+// out = a + b, where out has room for one more digit than the longer of
+// the two. Returns the length of out
+static unsigned int add_magnitudes(const uint32_t *a, unsigned int na,
+        const uint32_t *b, unsigned int nb, uint32_t *out)
+{
+    if (na < nb)
+    {
+        const uint32_t *t = a;
+        a = b;
+        b = t;
+        unsigned int n = na;
+        na = nb;
+        nb = n;
+    }
+    uint64_t carry = 0;
+    for (unsigned int i = 0; i < na; i++)
+    {
+        carry += (uint64_t)a[i] + (i < nb ? b[i] : 0);
+        out[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    out[na] = (uint32_t)carry;
+    return na + 1;
+}
+
+// out = a - b, where a >= b and out has room for na digits
+static void sub_magnitudes(const uint32_t *a, unsigned int na,
+        const uint32_t *b, unsigned int nb, uint32_t *out)
+{
+    int64_t borrow = 0;
+    for (unsigned int i = 0; i < na; i++)
+    {
+        borrow += (int64_t)a[i] - (i < nb ? b[i] : 0);
+        out[i] = (uint32_t)borrow;
+        borrow = (borrow < 0) ? -1 : 0;
+    }
+}
+
+// x += y, where the sum is known to fit in nx digits
+static void add_into(uint32_t *x, unsigned int nx, const uint32_t *y, unsigned int ny)
+{
+    ny = trim(y, ny);
+    uint64_t carry = 0;
+    for (unsigned int i = 0; i < nx && (i < ny || carry != 0); i++)
+    {
+        carry += (uint64_t)x[i] + (i < ny ? y[i] : 0);
+        x[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+}
+
+// x -= y, where x >= y
+static void sub_from(uint32_t *x, unsigned int nx, const uint32_t *y, unsigned int ny)
+{
+    ny = trim(y, ny);
+    int64_t borrow = 0;
+    for (unsigned int i = 0; i < nx && (i < ny || borrow != 0); i++)
+    {
+        borrow += (int64_t)x[i] - (i < ny ? y[i] : 0);
+        x[i] = (uint32_t)borrow;
+        borrow = (borrow < 0) ? -1 : 0;
+    }
+}
+
+static void mul_schoolbook(const uint32_t *a, unsigned int na,
+        const uint32_t *b, unsigned int nb, uint32_t *out)
+{
+    memset(out, 0, (na + nb) * sizeof(*out));
+    for (unsigned int i = 0; i < nb; i++)
+    {
+        uint64_t carry = 0;
+        for (unsigned int j = 0; j < na; j++)
+        {
+            carry += (uint64_t)a[j] * b[i] + out[i + j];
+            out[i + j] = (uint32_t)carry;
+            carry >>= 32;
+        }
+        out[i + na] = (uint32_t)carry;
+    }
+}
+
+// out = a * b, where out has room for na + nb digits and doesn't overlap
+// either. Returns false if it runs out of memory
+static bool mul_magnitudes(const uint32_t *a, unsigned int na,
+        const uint32_t *b, unsigned int nb, uint32_t *out)
+{
+    if (na < nb)
+    {
+        const uint32_t *t = a;
+        a = b;
+        b = t;
+        unsigned int n = na;
+        na = nb;
+        nb = n;
+    }
+    if (nb < KARATSUBA_THRESHOLD)
+    {
+        mul_schoolbook(a, na, b, nb, out);
+        return true;
+    }
+
+    if (nb <= na / 2)
+    {
+        // Too lopsided to split evenly, so multiply b by one nb digit
+        // slice of a at a time
+        uint32_t *part = malloc(2 * nb * sizeof(*part));
+        if (part == NULL) return false;
+        memset(out, 0, (na + nb) * sizeof(*out));
+        for (unsigned int i = 0; i < na; i += nb)
+        {
+            unsigned int length = (na - i < nb) ? na - i : nb;
+            if (!mul_magnitudes(a + i, length, b, nb, part))
+            {
+                free(part);
+                return false;
+            }
+            add_into(out + i, na + nb - i, part, length + nb);
+        }
+        free(part);
+        return true;
+    }
+
+    // Split both at m digits, a = a1 B^m + a0 and b = b1 B^m + b0. Then
+    // a b = z2 B^2m + z1 B^m + z0, where z0 = a0 b0, z2 = a1 b1 and
+    // z1 = (a0 + a1)(b0 + b1) - z0 - z2, which takes three products
+    // instead of four
+    unsigned int m = na / 2;
+    unsigned int ns = na - m + 1, nt = ((m > nb - m) ? m : nb - m) + 1;
+    uint32_t *scratch = malloc(2 * (ns + nt) * sizeof(*scratch));
+    if (scratch == NULL) return false;
+    uint32_t *s = scratch, *t = s + ns, *z1 = t + nt;
+
+    if (!mul_magnitudes(a, m, b, m, out)
+            || !mul_magnitudes(a + m, na - m, b + m, nb - m, out + 2 * m))
+    {
+        free(scratch);
+        return false;
+    }
+    ns = add_magnitudes(a, m, a + m, na - m, s);
+    nt = add_magnitudes(b, m, b + m, nb - m, t);
+    if (!mul_magnitudes(s, ns, t, nt, z1))
+    {
+        free(scratch);
+        return false;
+    }
+    sub_from(z1, ns + nt, out, 2 * m);
+    sub_from(z1, ns + nt, out + 2 * m, na + nb - 2 * m);
+    add_into(out + m, na + nb - m, z1, ns + nt);
+    free(scratch);
+    return true;
+}
+
+// q = u / d and returns u % d, for a one digit d. q may be u
+static uint32_t divide_digit(const uint32_t *u, unsigned int n, uint32_t d, uint32_t *q)
+{
+    uint64_t remainder = 0;
+    for (unsigned int i = n; i > 0; i--)
+    {
+        uint64_t current = (remainder << 32) | u[i - 1];
+        q[i - 1] = (uint32_t)(current / d);
+        remainder = current % d;
+    }
+    return (uint32_t)remainder;
+}
+
+// q = u / v and r = u % v by Knuth's algorithm D (TAOCP 4.3.1), for
+// trimmed u and v with m >= n >= 2. q has room for m - n + 1 digits and
+// r for n. Returns false if it runs out of memory
+static bool divide_magnitudes(const uint32_t *u, unsigned int m, const uint32_t *v, unsigned int n,
+        uint32_t *q, uint32_t *r)
+{
+    uint32_t *un = malloc((m + 1 + n) * sizeof(*un));
+    if (un == NULL) return false;
+    uint32_t *vn = un + m + 1;
+
+    // Shift v until its top bit is set, and u along with it, so each
+    // estimated quotient digit is off by at most 2
+    int s = __builtin_clz(v[n - 1]);
+    for (unsigned int i = n - 1; i > 0; i--)
+    {
+        vn[i] = (v[i] << s) | (uint32_t)((uint64_t)v[i - 1] >> (32 - s));
+    }
+    vn[0] = v[0] << s;
+    un[m] = (uint32_t)((uint64_t)u[m - 1] >> (32 - s));
+    for (unsigned int i = m - 1; i > 0; i--)
+    {
+        un[i] = (u[i] << s) | (uint32_t)((uint64_t)u[i - 1] >> (32 - s));
+    }
+    un[0] = u[0] << s;
+
+    for (unsigned int j = m - n + 1; j > 0; j--)
+    {
+        unsigned int k = j - 1;
+
+        // Estimate the digit from the top two digits of what's left
+        uint64_t top = ((uint64_t)un[k + n] << 32) | un[k + n - 1];
+        uint64_t qhat = top / vn[n - 1];
+        uint64_t rhat = top % vn[n - 1];
+        while (qhat >> 32 != 0 || qhat * vn[n - 2] > ((rhat << 32) | un[k + n - 2]))
+        {
+            qhat--;
+            rhat += vn[n - 1];
+            if (rhat >> 32 != 0) break;
+        }
+
+        // Subtract qhat v from this part of u
+        int64_t borrow = 0, t;
+        for (unsigned int i = 0; i < n; i++)
+        {
+            uint64_t p = qhat * vn[i];
+            t = (int64_t)un[i + k] - borrow - (int64_t)(p & 0xFFFFFFFF);
+            un[i + k] = (uint32_t)t;
+            borrow = (int64_t)(p >> 32) - (t >> 32);
+        }
+        t = (int64_t)un[k + n] - borrow;
+        un[k + n] = (uint32_t)t;
+
+        // The estimate was one too big, so add v back
+        q[k] = (uint32_t)qhat;
+        if (t < 0)
+        {
+            q[k]--;
+            uint64_t carry = 0;
+            for (unsigned int i = 0; i < n; i++)
+            {
+                carry += (uint64_t)un[i + k] + vn[i];
+                un[i + k] = (uint32_t)carry;
+                carry >>= 32;
+            }
+            un[k + n] += (uint32_t)carry;
+        }
+    }
+
+    // What's left of u is the remainder, still shifted
+    for (unsigned int i = 0; i + 1 < n; i++)
+    {
+        r[i] = (un[i] >> s) | (uint32_t)((uint64_t)un[i + 1] << (32 - s));
+    }
+    r[n - 1] = un[n - 1] >> s;
+    free(un);
+    return true;
+}
+
+// a + b or a - b for exact integers
+static Value add_integers(Value a, Value b, bool subtract)
+{
+    struct Integer x, y;
+    load_integer(a, &x);
+    load_integer(b, &y);
+    bool y_negative = (y.negative != subtract);
+
+    unsigned int length = ((x.length > y.length) ? x.length : y.length) + 1;
+    uint32_t *out = malloc(length * sizeof(*out));
+    if (out == NULL) return NO_VALUE;
+
+    // Same signs add, otherwise the smaller magnitude comes off the bigger
+    if (x.negative == y_negative)
+    {
+        length = add_magnitudes(x.digits, x.length, y.digits, y.length, out);
+        return make_integer(x.negative, out, length);
+    }
+    else if (compare_magnitudes(x.digits, x.length, y.digits, y.length) >= 0)
+    {
+        sub_magnitudes(x.digits, x.length, y.digits, y.length, out);
+        return make_integer(x.negative, out, x.length);
+    }
+    sub_magnitudes(y.digits, y.length, x.digits, x.length, out);
+    return make_integer(y_negative, out, y.length);
+}
+
+// Makes sure powers has 10^(9 2^k). Returns false if it runs out of memory
+static bool power_of_ten(struct Powers *powers, unsigned int k)
+{
+    if (powers->count == 0)
+    {
+        powers->digits[0] = malloc(sizeof(uint32_t));
+        if (powers->digits[0] == NULL) return false;
+        powers->digits[0][0] = 1000000000;
+        powers->length[0] = 1;
+        powers->count = 1;
+    }
+    while (powers->count <= k)
+    {
+        unsigned int i = powers->count, n = powers->length[i - 1];
+        powers->digits[i] = malloc(2 * n * sizeof(uint32_t));
+        if (powers->digits[i] == NULL) return false;
+        if (!mul_magnitudes(powers->digits[i - 1], n, powers->digits[i - 1], n, powers->digits[i]))
+        {
+            free(powers->digits[i]);
+            return false;
+        }
+        powers->length[i] = trim(powers->digits[i], 2 * n);
+        powers->count++;
+    }
+    return true;
+}
+
+static void delete_powers(struct Powers *powers)
+{
+    for (unsigned int i = 0; i < powers->count; i++) free(powers->digits[i]);
+}
+
+// Reads the decimal digits[0..length) into out, which has room for
+// length / 9 + 2 digits, and sets *n to the length of the result.
+// Returns false if it runs out of memory
+static bool parse_magnitude(const char *digits, unsigned int length, struct Powers *powers,
+        uint32_t *out, unsigned int *n)
+{
+    if (length <= 9 * DECIMAL_THRESHOLD)
+    {
+        // Nine decimal digits at a time always fit in one base 2^32 digit
+        *n = 0;
+        unsigned int i = 0;
+        unsigned int chunk = (length % 9 == 0) ? 9 : length % 9;
+        while (i < length)
+        {
+            uint32_t value = 0, scale = 1;
+            for (unsigned int end = i + chunk; i < end; i++)
+            {
+                value = value * 10 + (uint32_t)(digits[i] - '0');
+                scale *= 10;
+            }
+            chunk = 9;
+
+            // out = out * scale + value
+            uint64_t carry = value;
+            for (unsigned int j = 0; j < *n; j++)
+            {
+                carry += (uint64_t)out[j] * scale;
+                out[j] = (uint32_t)carry;
+                carry >>= 32;
+            }
+            if (carry != 0) out[(*n)++] = (uint32_t)carry;
+        }
+        return true;
+    }
+
+    // Split off the low 9 2^k digits, the most that leaves some above
+    // them, so the number is high 10^(9 2^k) + low
+    unsigned int k = 0;
+    while ((9u << (k + 1)) < length) k++;
+    unsigned int low_length = 9u << k, high_length = length - low_length;
+    if (!power_of_ten(powers, k)) return false;
+
+    uint32_t *high = malloc((high_length / 9 + 2 + low_length / 9 + 2) * sizeof(*high));
+    if (high == NULL) return false;
+    uint32_t *low = high + high_length / 9 + 2;
+    unsigned int nh, nl;
+    if (!parse_magnitude(digits, high_length, powers, high, &nh)
+            || !parse_magnitude(digits + high_length, low_length, powers, low, &nl))
+    {
+        free(high);
+        return false;
+    }
+
+    // The product can't be longer than out, since 10^(9 2^k) has at most
+    // 2^k digits
+    unsigned int np = powers->length[k];
+    if (nh == 0)
+    {
+        memcpy(out, low, nl * sizeof(*out));
+        *n = nl;
+    }
+    else if (!mul_magnitudes(high, nh, powers->digits[k], np, out))
+    {
+        free(high);
+        return false;
+    }
+    else
+    {
+        add_into(out, nh + np, low, nl);
+        *n = trim(out, nh + np);
+    }
+    free(high);
+    return true;
+}
+
+// Writes the magnitude u[0..n), which is below 10^width, as exactly width
+// decimal digits (with leading zeroes). Returns false if it runs out of
+// memory. Splitting halves the work of the divisions at each level, but
+// they're done by algorithm D, so this is still quadratic overall; what it
+// saves is a hardware division for every digit at every step
+static bool write_magnitude(const uint32_t *u, unsigned int n, struct Powers *powers,
+        char *str, unsigned int width)
+{
+    n = trim(u, n);
+
+    // Split at the biggest power of ten that's at most half as long
+    unsigned int k = 0;
+    if (n > DECIMAL_THRESHOLD)
+    {
+        if (!power_of_ten(powers, 0)) return false;
+        while (2 * powers->length[k] <= (n + 1) / 2)
+        {
+            if (!power_of_ten(powers, k + 1)) return false;
+            k++;
+        }
+    }
+    if (n <= DECIMAL_THRESHOLD || (9u << k) >= width)
+    {
+        // Peel off nine decimal digits at a time, least significant first
+        uint32_t *work = malloc((n + 1) * sizeof(*work));
+        if (work == NULL) return false;
+        memcpy(work, u, n * sizeof(*work));
+        char *end = str + width;
+        while (end > str)
+        {
+            uint32_t chunk = (n > 0) ? divide_digit(work, n, 1000000000, work) : 0;
+            n = trim(work, n);
+            for (unsigned int i = 0; i < 9 && end > str; i++)
+            {
+                *--end = (char)('0' + chunk % 10);
+                chunk /= 10;
+            }
+        }
+        free(work);
+        return true;
+    }
+
+    // u = q 10^(9 2^k) + r, and r is the low 9 2^k digits
+    unsigned int np = powers->length[k], low_width = 9u << k;
+    uint32_t *q = malloc((n - np + 1 + np) * sizeof(*q));
+    if (q == NULL) return false;
+    uint32_t *r = q + n - np + 1;
+    bool ok = divide_magnitudes(u, n, powers->digits[k], np, q, r)
+        && write_magnitude(r, np, powers, str + width - low_width, low_width)
+        && write_magnitude(q, n - np + 1, powers, str, width - low_width);
+    free(q);
+    return ok;
+}
+
+/* Public functions */
+
+Value number_add(Value a, Value b)
+{
+    // Fixnums are small enough that the sum can't overflow an int64_t
+    if (is_fixnum(a) && is_fixnum(b)) return vinteger(as_fixnum(a) + as_fixnum(b));
+    else if (!is_exact(a) || !is_exact(b)) return vnumber(as_number(a) + as_number(b));
+    return add_integers(a, b, false);
+}
+
+Value number_sub(Value a, Value b)
+{
+    if (is_fixnum(a) && is_fixnum(b)) return vinteger(as_fixnum(a) - as_fixnum(b));
+    else if (!is_exact(a) || !is_exact(b)) return vnumber(as_number(a) - as_number(b));
+    return add_integers(a, b, true);
+}
+
+Value number_negate(Value a)
+{
+    return number_sub(vfixnum(0), a);
+}
+
+Value number_mul(Value a, Value b)
+{
+    int64_t product;
+    if (is_fixnum(a) && is_fixnum(b)
+            && !__builtin_mul_overflow(as_fixnum(a), as_fixnum(b), &product))
+    {
+        return vinteger(product);
+    }
+    else if (!is_exact(a) || !is_exact(b))
+    {
+        return vnumber(as_number(a) * as_number(b));
+    }
+
+    struct Integer x, y;
+    load_integer(a, &x);
+    load_integer(b, &y);
+    if (x.length == 0 || y.length == 0) return vfixnum(0);
+    uint32_t *out = malloc((x.length + y.length) * sizeof(*out));
+    if (out == NULL) return NO_VALUE;
+    if (!mul_magnitudes(x.digits, x.length, y.digits, y.length, out))
+    {
+        free(out);
+        return NO_VALUE;
+    }
+    return make_integer(x.negative != y.negative, out, x.length + y.length);
+}
+
+int compare_integers(Value a, Value b)
+{
+    if (is_fixnum(a) && is_fixnum(b))
+    {
+        return (as_fixnum(a) > as_fixnum(b)) - (as_fixnum(a) < as_fixnum(b));
+    }
+    struct Integer x, y;
+    load_integer(a, &x);
+    load_integer(b, &y);
+    if (x.negative != y.negative) return x.negative ? -1 : 1;
+    int c = compare_magnitudes(x.digits, x.length, y.digits, y.length);
+    return x.negative ? -c : c;
+}
+
+Value divide_integers(Value a, Value b, enum DivideOp op)
+{
+    Value q, r;
+    if (is_fixnum(a) && is_fixnum(b))
+    {
+        // C division truncates, which is what quotient and remainder want
+        int64_t x = as_fixnum(a), y = as_fixnum(b);
+        q = vinteger(x / y);
+        r = vfixnum(x % y);
+    }
+    else
+    {
+        struct Integer x, y;
+        load_integer(a, &x);
+        load_integer(b, &y);
+        if (compare_magnitudes(x.digits, x.length, y.digits, y.length) < 0)
+        {
+            q = vfixnum(0);
+            r = a;
+        }
+        else
+        {
+            unsigned int ql = x.length - y.length + 1;
+            uint32_t *qd = malloc(ql * sizeof(*qd));
+            uint32_t *rd = malloc(y.length * sizeof(*rd));
+            bool ok = (qd != NULL && rd != NULL);
+            if (ok && y.length == 1)
+            {
+                rd[0] = divide_digit(x.digits, x.length, y.digits[0], qd);
+            }
+            else if (ok)
+            {
+                ok = divide_magnitudes(x.digits, x.length, y.digits, y.length, qd, rd);
+            }
+            if (!ok)
+            {
+                free(qd);
+                free(rd);
+                return NO_VALUE;
+            }
+            // Truncating, the remainder takes the sign of the dividend
+            q = make_integer(x.negative != y.negative, qd, ql);
+            r = make_integer(x.negative, rd, y.length);
+            if (q == NO_VALUE || r == NO_VALUE) return NO_VALUE;
+        }
+    }
+
+    if (op == QUOTIENT) return q;
+    else if (op == REMAINDER) return r;
+
+    // modulo takes the sign of the divisor instead
+    bool r_negative = (compare_integers(r, vfixnum(0)) < 0);
+    bool b_negative = (compare_integers(b, vfixnum(0)) < 0);
+    if (r != vfixnum(0) && r_negative != b_negative) return number_add(r, b);
+    return r;
+}
+
+Value parse_integer(const char *digits, unsigned int length)
+{
+    struct Powers powers = { 0 };
+    unsigned int n;
+    uint32_t *magnitude = malloc((length / 9 + 2) * sizeof(*magnitude));
+    if (magnitude == NULL) return NO_VALUE;
+    bool ok = parse_magnitude(digits, length, &powers, magnitude, &n);
+    delete_powers(&powers);
+    if (!ok)
+    {
+        free(magnitude);
+        return NO_VALUE;
+    }
+    return make_integer(false, magnitude, n);
+}
+
+char *integer_to_decimal(Value v)
+{
+    if (is_fixnum(v))
+    {
+        char *str = malloc(24);
+        if (str != NULL) snprintf(str, 24, "%lld", (long long)as_fixnum(v));
+        return str;
+    }
+
+    // A base 2^32 digit is worth less than ten decimal ones, so that many
+    // is always enough. The leading zeroes are dropped afterwards
+    struct Bignum *big = as_bignum(v);
+    unsigned int width = big->length * 10, start = big->negative;
+    char *str = malloc(width + 2);
+    if (str == NULL) return NULL;
+    struct Powers powers = { 0 };
+    bool ok = write_magnitude(big->digits, big->length, &powers, str + start, width);
+    delete_powers(&powers);
+    if (!ok)
+    {
+        free(str);
+        return NULL;
+    }
+
+    unsigned int zeroes = 0;
+    while (zeroes + 1 < width && str[start + zeroes] == '0') zeroes++;
+    memmove(str + start, str + start + zeroes, width - zeroes);
+    str[start + width - zeroes] = '\0';
+    if (big->negative) str[0] = '-';
+    return str;
+}
@@ -0,0 +1,53 @@
+#ifndef NUMBER_INCLUDE
+#define NUMBER_INCLUDE
+#include "datatype.h"
+
+/* Constants */
+
+/* Bignums with fewer digits than this (base 2^32) are multiplied the
+ * schoolbook way, bigger ones with Karatsuba's algorithm */
+#define KARATSUBA_THRESHOLD 32
+
+/* Bignums with more digits than this (base 2^32) are converted to and
+ * from decimal by splitting them at a power of ten and converting the
+ * halves, smaller ones nine decimal digits at a time */
+#define DECIMAL_THRESHOLD 32
+
+/* Data structures */
+
+enum DivideOp
+{
+    QUOTIENT,
+    REMAINDER,
+    MODULO
+};
+
+/* Function definitions */
+
+/* Arithmetic on any kind of number. Exact integers stay exact, growing
+ * into bignums and shrinking back into fixnums as needed, and anything
+ * involving a double is done in doubles. These return NO_VALUE if they
+ * run out of memory */
+Value number_add(Value a, Value b);
+Value number_sub(Value a, Value b);
+Value number_mul(Value a, Value b);
+Value number_negate(Value a);
+
+/* Compares two exact integers, giving a negative number, 0 or a positive
+ * number as a is less than, equal to or greater than b */
+int compare_integers(Value a, Value b);
+
+/* Divides one exact integer by another, which must not be zero.
+ * quotient and remainder truncate, modulo takes the sign of b. Returns
+ * NO_VALUE on failure */
+Value divide_integers(Value a, Value b, enum DivideOp op);
+
+/* Reads the exact integer written in the first length bytes of digits,
+ * which must all be decimal digits. Returns NO_VALUE on failure */
+Value parse_integer(const char *digits, unsigned int length);
+
+/* Writes an exact integer out in decimal, as a new null terminated
+ * string the caller frees. Returns NULL on failure */
+char *integer_to_decimal(Value v);
+
+#endif
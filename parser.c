@@ -3,24 +3,56 @@
 #include <string.h>
 #include "datatype.h"
 #include "parser.h"
+#include "symbol.h"
+#include "number.h"
 
+/* Elements of the lists being parsed, innermost list last. Each list is
+ * gathered here and copied out when it closes, so it's allocated once at
+ * its final size. Parsing never evaluates anything (or collects), so one
+ * stack serves every parser */
+static Value *elements = NULL;
+static unsigned int elements_size = 0;
+static unsigned int elements_capacity = 0;
 
-void init_parser(struct Parser *parser, ScmString *sstr)
+// Pushes v onto the element stack. Returns false on failure
+static bool push_element(Value v)
+{
+    if (elements_size == elements_capacity)
+    {
+        unsigned int capacity = elements_capacity == 0 ? 256 : elements_capacity * 2;
+        Value *grown = realloc(elements, capacity * sizeof(*grown));
+        if (grown == NULL) return false;
+        elements = grown;
+        elements_capacity = capacity;
+    }
+    elements[elements_size++] = v;
+    return true;
+}
+
+void init_parser_buffer(struct Parser *parser, const char *input, unsigned int length)
 {
     parser->error = NO_ERROR;
-    parser->value = NULL;
+    parser->value = NO_VALUE;
     parser->row = 1;
     parser->column = 1;
     parser->index = 0;
-    parser->input = sstr;
+    parser->input = input;
+    parser->length = length;
 }
 
+void init_parser(struct Parser *parser, ScmString *sstr)
+{
+    init_parser_buffer(parser, sstr->chars, sstr->length);
+}
 
-// Parses content of string, returns as list of characters. 
+
+// Parses content of string. Escapes are kept as written, so the
+// contents are exactly the bytes between the quotes and can be
+// copied out of the input in one go.
 // Assumes that leading quote has been consumed already.
 int parse_string(struct Parser *parser)
 {
-    struct List *lst = list();
+    unsigned int start = parser->index;
     char c, prevc;
     prevc = 'i'; // choosing a random non-escape-y char for initialization
 
@@ -30,35 +62,25 @@ int parse_string(struct Parser *parser)
         if (c == '\n')
         {
             parser->error = NO_NEWLINE_IN_STRING;
-            goto error;
+            return PARSE_FAILURE;
         }
         else if (c == '"' && prevc != '\\')
         {
-            parser->value = vstring(lst);
+            // Leave off the closing quote
+            ScmString *sstr = scm_string(&parser->input[start], parser->index - 1 - start);
+            if (sstr == NULL) break;
+            parser->value = vstring(sstr);
             return PARSE_SUCCESS;
         }
-        else if (prevc == '\\') 
+        else if (prevc == '\\' && !(c == 'n' || c == 't' || c == '\\' || c == '"'))
         {
-            if (c == 'n' || c == 't' || c == '\\' || c == '"')
-            {
-                append(lst, vcharacter(c));
-            }
-            else 
-            {
-                parser->error = UNKNOWN_ESCAPE_SEQUENCE;
-                goto error;
-            }
-        }
-        else
-        {
-            append(lst, vcharacter(c));
+            parser->error = UNKNOWN_ESCAPE_SEQUENCE;
+            return PARSE_FAILURE;
         }
         prevc = c;
     }
     parser->error = UNTERMINATED_STRING;
-error:
-    delete_list(lst);
-    return PARSE_SUCCESS;
+    return PARSE_FAILURE;
 }
 
 
@@ -167,11 +189,12 @@ int parse_atom(struct Parser *parser)
         // Technically scheme allows identifiers that start with numbers, 
         // but that feels stupid, so I'm not going to allow it
 
-        // TODO handle decimal, negatives, & overflow checks
-        // Also need to figure out if this method actually works for 
-        // double values greater than INT_MAX since floating point 
-        // stuff is weird
-        double num = 0;
+        // TODO handle decimal and negatives
+        // Integers are read as fixnums when they fit, and only go through
+        // the bignum code when they don't
+        unsigned int start = parser->index;
+        int64_t num = 0;
+        bool exact = true;
 
         while (1)
         {
@@ -181,35 +204,37 @@ int parse_atom(struct Parser *parser)
                 parser->error = INVALID_NUM_CHAR;
                 return PARSE_FAILURE;
             }
-            num *= 10;
-            num += (c - '0');
+            if (exact && num <= (FIXNUM_MAX - (c - '0')) / 10)
+                num = num * 10 + (c - '0');
+            else
+                exact = false;
             next(parser);
             if (!has_next(parser) || is_terminal(peek(parser)))
                 break;
         } 
-        parser->value = vnumber(num);
+        if (exact)
+            parser->value = vfixnum(num);
+        else
+            parser->value = parse_integer(parser->input + start, parser->index - start);
         return PARSE_SUCCESS;
     }
 
-    // Pretty much anything that isn't one of the above is an identifier
-    char content[MAXIMUM_SYMBOL_LENGTH];
-    unsigned int i = 0;
-    for (i = 0; i < MAXIMUM_SYMBOL_LENGTH; i++)
-    {
-        if (!has_next(parser) || is_terminal(peek(parser)))
-        {
-            char *varname = calloc(i+1, sizeof(char));
-            strncpy(varname, content, i);
-            parser->value = vsymbol(varname);
-            return PARSE_SUCCESS;
-        }
-        content[i] = next(parser);
-    }
-    if (i == MAXIMUM_SYMBOL_LENGTH + 1)
+    // Pretty much anything that isn't one of the above is an identifier,
+    // interned straight from the input
+    unsigned int start = parser->index;
+    while (has_next(parser) && !is_terminal(peek(parser))) next(parser);
+    unsigned int length = parser->index - start;
+    if (length >= MAXIMUM_SYMBOL_LENGTH)
     {
         parser->error = MAXIMUM_SYMBOL_LENGTH_EXCEEDED;
         return PARSE_FAILURE;
     }
+    char *varname = intern(&parser->input[start], length);
+    if (varname != NULL)
+    {
+        parser->value = vsymbol(varname);
+        return PARSE_SUCCESS;
+    }
 
     parser->error = UNHANDLED_DATA_TYPE;
     return PARSE_FAILURE;
@@ -234,15 +259,19 @@ int parse_list(struct Parser *parser)
     next(parser);
     spaces(parser);
 
-    struct List *lst = list();
-
+    // Elements above start belong to this list
+    unsigned int start = elements_size;
     while (has_next(parser) && peek(parser) != ')')
     {
         if (!parse(parser))
         {
             goto err;
         }
-        append(lst, parser->value);
+        if (!push_element(parser->value))
+        {
+            parser->error = OUT_OF_MEMORY;
+            goto err;
+        }
         spaces(parser);
     }
 
@@ -252,11 +281,24 @@ int parse_list(struct Parser *parser)
         goto err;
     }
     next(parser);
-    parser->value = vlist(lst);
+
+    unsigned int size = elements_size - start;
+    elements_size = start;
+    if (size == 0)
+    {
+        parser->value = EMPTY_LIST;
+        return PARSE_SUCCESS;
+    }
+    parser->value = vlist(list_from(&elements[start], size));
+    if (parser->value == NO_VALUE)
+    {
+        parser->error = OUT_OF_MEMORY;
+        return PARSE_FAILURE;
+    }
     return PARSE_SUCCESS;
 
 err:
-    delete_list(lst);
+    elements_size = start;
     return PARSE_FAILURE;
 }
 
@@ -9,20 +9,28 @@
 #define PARSE_SUCCESS 1
 
 /* Data structures */
+
+/* Parser reads straight out of a byte buffer (a file, REPL line or
+ * string), which must outlive it. Symbols and string literals are sliced
+ * out of the buffer rather than built up a character at a time. */
 struct Parser
 {
     unsigned int row;
     unsigned int column;
     unsigned int index;
-    ScmString *input;
+    const char *input;
+    unsigned int length;
     enum Error error;
-    struct Value *value;
+    Value value;
 };
 
 
 /* Function definitions */
 
-/* Creates a new parser from the given ScmPString */
+/* Creates a new parser over the first length bytes of input */
+void init_parser_buffer(struct Parser *parser, const char *input, unsigned int length);
+
+/* Creates a new parser from the given ScmString */
 void init_parser(struct Parser *parser, ScmString *pstr);
 
 /* Parses a string token */
@@ -56,13 +64,13 @@ static inline void iterrow(struct Parser *p)
 /* Check if there are more characters */
 static inline int has_next(struct Parser *p)
 {
-    return p->index < p->input->size;
+    return p->index < p->length;
 }
 
 /* look at next character without changing index */
 static inline char peek(struct Parser *p)
 {
-    return list_lookup(p->input, p->index)->character;
+    return p->input[p->index];
 }
 
 static inline int is_space(char c)
@@ -80,7 +88,7 @@ static inline int is_terminal(char c)
  * Assumes that we've checked has_next already */
 static inline char next(struct Parser *p)
 {
-    char c = list_lookup(p->input, p->index)->character;
+    char c = p->input[p->index];
     if (c == '\n')
         p->row++;
     else 
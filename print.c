@@ -1,19 +1,30 @@
 #include <stdio.h>
 #include "datatype.h"
+#include "namespace.h"
 #include "print.h"
+#include "number.h"
 
-void print(struct Value *v, bool newline)
+void print(Value v, bool newline)
 {
-    if (v == NULL)
+    if (v == NO_VALUE)
     {
         printf("Error, cannot print NULL value\n");
         return;
     }
-    switch (v->type)
+    struct List *l;
+    switch (type_of(v))
     {
     case LIST:
+    case PAIR:
         printf("(");
-        struct List *l = v->list;
+        // Pairs first, then whatever array list they end in
+        for (; type_of(v) == PAIR; v = as_pair(v)->cdr)
+        {
+            print(as_pair(v)->car, 0);
+            if (as_pair(v)->cdr != EMPTY_LIST)
+                printf(" ");
+        }
+        l = as_list(v);
         for (unsigned int i = 0; i < l->size; i++)
         {
             print(l->values[i], 0);
@@ -23,31 +34,74 @@ void print(struct Value *v, bool newline)
         printf(")");
         break;
     case STRING:
-        printf("\"%s\"", from_scm_string(v->string));
+        // Written by length, strings may hold null bytes
+        printf("\"");
+        fwrite(as_string(v)->chars, 1, as_string(v)->length, stdout);
+        printf("\"");
         break;
     case SYMBOL:
-        printf("%s", v->symbol);
+        printf("%s", as_symbol(v));
         break;
     case CHAR:
-        printf("#\\%c", v->character);
+        printf("#\\%c", as_char(v));
         break;
     case NUMBER:
-        printf("%f", v->number);
+        if (is_exact(v))
+        {
+            char *digits = integer_to_decimal(v);
+            if (digits != NULL) fputs(digits, stdout);
+            free(digits);
+        }
+        else
+        {
+            printf("%f", as_number(v));
+        }
         break;
     case BOOLEAN:
-        if (v->boolean)
+        if (as_boolean(v))
             printf("#t");
         else
             printf("#f");
         break;
     case PROCEDURE:
         printf("(lambda ");
-        print(v->proc->values[0], 0);
+        print(get_args(v), 0);
         printf(" ");
-        print(v->proc->values[1], 0);
+        print(get_body(v), 0);
+        printf(")");
+        break;
+    case BUILTIN:
+        printf("#<procedure %s>", as_builtin(v)->name);
+        break;
+    case LOCAL:
+        printf("%s", as_object(v)->local.name);
+        break;
+    case GLOBAL:
+        printf("%s", as_object(v)->global.cell->name);
+        break;
+    case CODE:
+        printf("#<code>");
+        break;
+    case MACRO:
+        printf("#<macro>");
+        break;
+    case HASH_TABLE:
+        printf("#<hash-table %u>", as_hash_table(v)->count);
+        break;
+    case MEMO:
+        printf("#<memoized ");
+        print(as_memo(v)->proc, 0);
+        printf(">");
+        break;
+    case F64VECTOR:
+        printf("#f64(");
+        for (unsigned int i = 0; i < as_f64vector(v)->length; i++)
+        {
+            if (i > 0) printf(" ");
+            printf("%f", as_f64vector(v)->data[i]);
+        }
         printf(")");
         break;
     }
     if (newline) printf("\n");
 }
-
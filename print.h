@@ -7,7 +7,7 @@
 /* Function definitions */
 
 /* Print a scheme */
-void print(struct Value *v, bool newline);
+void print(Value v, bool newline);
 
 /* Utility functions */
 
@@ -9,17 +9,20 @@
 #include "eval.h"
 #include "print.h"
 #include "error.h"
+#include "resolve.h"
+#include "builtin.h"
+#include "gc.h"
 
 
 /* Read-Eval-Print Loop for Scheme interpreter */
-ScmString *read(void)
+ScmString *read_input(void)
 {
     unsigned int i, parencount;
     char c;
     parencount = 0;
     c = fgetc(stdin);
 
-    ScmString *sstr = list();
+    ScmString *sstr = scm_string("", 0);
     for (i = 0; !(c == '\n' && parencount == 0); 
             i++, c = fgetc(stdin))
     {
@@ -28,7 +31,7 @@ ScmString *read(void)
             printf("\nexiting scheme\n");
             exit(0);
         }
-        append(sstr, vcharacter(c));
+        string_append(sstr, c);
 
         if (c == '(')
         {
@@ -49,16 +52,23 @@ void repl()
     ScmString *sstr;
     struct Parser p;
     struct Namespace nsp;
-    struct Value *v;
+    Value v;
 
     init_nsp(&nsp, NULL);
+    register_builtins(&nsp);
+
+    // Everything reachable from the top level or the form being evaluated
+    // is kept. Never popped, the REPL runs until the program exits
+    struct GCRoot root;
+    p.value = NO_VALUE;
+    gc_push_root(&root, &p.value, 1, &nsp);
 
     // Load standard library functions at the top level
     load(&nsp, &p, "load.scm");
     while (1)
     {
         printf("> ");
-        sstr = read();
+        sstr = read_input();
         init_parser(&p, sstr);
         parse(&p);
         if (p.error != NO_ERROR)
@@ -68,14 +78,15 @@ void repl()
                     parse_error_to_string(p.error));
             continue;
         }
-        v = eval(&nsp, &p, p.value);
+        p.value = resolve(&nsp, &p, p.value);
+        v = (p.value == NO_VALUE) ? NO_VALUE : eval(&nsp, &p, p.value);
         if (p.error != NO_ERROR)
         {
             printf("Error while executing: %s\n",
                     parse_error_to_string(p.error));
             continue;
         }
-        if (v != NULL) print(v, true);
+        if (v != NO_VALUE) print(v, true);
     }
 }
 
@@ -6,7 +6,7 @@
 
 /* Function definitions */
 
-ScmString *read(void);
+ScmString *read_input(void);
 void repl();
 
 #endif
@@ -0,0 +1,288 @@
+#include <stdlib.h>
+#include "datatype.h"
+#include "symbol.h"
+#include "compile.h"
+#include "error.h"
+#include "macro.h"
+#include "namespace.h"
+#include "resolve.h"
+
+/* Internal constants */
+
+/* Most expansions that can lead to the one being expanded, so a macro
+ * that expands into itself forever is caught */
+#define MAX_EXPANSION_DEPTH 10000
+
+/* Data structures */
+
+/* One lambda's worth of lexical scope */
+struct Scope
+{
+    /* Parameter list (or lone symbol for variadic lambdas).
+     * Parameter i always lives in binding slot i of the call frame */
+    Value args;
+
+    /* Symbols define'd somewhere in this lambda's body. These are added
+     * to the frame at run time, so references to them stay dynamic */
+    struct List *defined;
+
+    struct Scope *parent;
+};
+
+/* State for resolving one top level form */
+struct Resolver
+{
+    /* Where the form is evaluated, and where macros are looked up */
+    struct Namespace *nsp;
+
+    /* nsp if it's a top level namespace, otherwise NULL */
+    struct Namespace *top;
+
+    struct Parser *parser;
+
+    /* Expansions that led to the expression being expanded */
+    unsigned int depth;
+};
+
+/* Interned names of the forms the resolver has to understand */
+static char *s_quote, *s_lambda, *s_define, *s_define_syntax;
+
+/* Private function definitions */
+
+static bool resolve_expr(Value *v, struct Scope *scope, struct Resolver *r);
+
+static inline bool is_form(struct List *lst, char *name)
+{
+    Value first = list_lookup(lst, 0);
+    return first != NO_VALUE && first == vsymbol(name);
+}
+
+// Collects every name defined in body without descending into quoted
+// data or nested lambdas (those define into their own frames)
+static void collect_defines(Value body, struct List *defined)
+{
+    if (body == NO_VALUE || type_of(body) != LIST) return;
+    struct List *lst = as_list(body);
+    if (is_form(lst, s_quote) || is_form(lst, s_lambda)) return;
+
+    if (is_form(lst, s_define) && lst->size == 3)
+    {
+        Value name = list_lookup(lst, 1);
+        if (type_of(name) == SYMBOL) append(defined, name);
+    }
+    for (unsigned int i = 0; i < lst->size; i++)
+    {
+        collect_defines(list_lookup(lst, i), defined);
+    }
+}
+
+static bool is_defined(struct Scope *scope, char *name)
+{
+    for (unsigned int i = 0; i < scope->defined->size; i++)
+    {
+        if (as_symbol(scope->defined->values[i]) == name) return true;
+    }
+    return false;
+}
+
+// Gets the slot of a parameter name, or -1 if it isn't a parameter
+static long param_slot(struct Scope *scope, char *name)
+{
+    Value args = scope->args;
+    if (type_of(args) == SYMBOL)
+    {
+        return (as_symbol(args) == name) ? 0 : -1;
+    }
+    struct List *lst = as_list(args);
+    for (unsigned int i = 0; i < lst->size; i++)
+    {
+        if (as_symbol(lst->values[i]) == name) return i;
+    }
+    return -1;
+}
+
+// Gets the macro a name refers to, or NO_VALUE if it isn't one or is
+// shadowed by a variable
+static Value lookup_macro(char *name, struct Scope *scope, struct Resolver *r)
+{
+    for (; scope != NULL; scope = scope->parent)
+    {
+        if (param_slot(scope, name) != -1 || is_defined(scope, name)) return NO_VALUE;
+    }
+    Value v = lookup_var(r->nsp, name);
+    return (v != NO_VALUE && type_of(v) == MACRO) ? v : NO_VALUE;
+}
+
+// Replaces every macro use in the expression at v with its expansion,
+// leaving quoted data and nested lambdas (which expand their own
+// bodies when they're resolved) alone
+static bool expand_expr(Value *v, struct Scope *scope, struct Resolver *r)
+{
+    unsigned int expansions = 0;
+    struct List *lst;
+    for (;;)
+    {
+        if (type_of(*v) != LIST || *v == EMPTY_LIST) return true;
+        lst = as_list(*v);
+        Value first = list_lookup(lst, 0);
+        if (type_of(first) != SYMBOL) break;
+
+        char *name = as_symbol(first);
+        if (name == s_quote || name == s_lambda || name == s_define_syntax) return true;
+        if (is_special_form(name)) break;
+        Value macro = lookup_macro(name, scope, r);
+        if (macro == NO_VALUE) break;
+        if (r->depth == MAX_EXPANSION_DEPTH)
+        {
+            r->depth -= expansions;
+            r->parser->error = EXPANSION_TOO_DEEP;
+            return false;
+        }
+
+        // The expansion replaces the use for good, so this only happens
+        // once however many times the code runs
+        Value expansion = expand_macro(r->parser, macro, *v);
+        if (expansion == NO_VALUE)
+        {
+            r->depth -= expansions;
+            return false;
+        }
+        *v = expansion;
+        r->depth++;
+        expansions++;
+    }
+
+    bool ok = true;
+    for (unsigned int i = 0; i < lst->size && ok; i++)
+    {
+        ok = expand_expr(&lst->values[i], scope, r);
+    }
+    r->depth -= expansions;
+    return ok;
+}
+
+// Replaces the symbol at v with a LOCAL reference if it names a
+// parameter of an enclosing lambda, or with a GLOBAL one if nothing
+// encloses it and there is a top level namespace to bind it in
+static void resolve_symbol(Value *v, struct Scope *scope, struct Namespace *top)
+{
+    char *name = as_symbol(*v);
+    unsigned short depth = 0;
+    for (; scope != NULL; scope = scope->parent, depth++)
+    {
+        long slot = param_slot(scope, name);
+        if (slot != -1)
+        {
+            Value local = vlocal(name, depth, (unsigned short)slot);
+            if (local != NO_VALUE) *v = local;
+            return;
+        }
+        else if (is_defined(scope, name))
+        {
+            return;
+        }
+    }
+    if (top == NULL) return;
+    struct Binding *cell = global_cell(top, name);
+    if (cell == NULL) return;
+    Value global = vglobal(top, cell);
+    if (global != NO_VALUE) *v = global;
+}
+
+static bool valid_args(Value args)
+{
+    if (args == NO_VALUE) return false;
+    if (type_of(args) == SYMBOL) return true;
+    if (type_of(args) != LIST) return false;
+    struct List *lst = as_list(args);
+    for (unsigned int i = 0; i < lst->size; i++)
+    {
+        if (type_of(lst->values[i]) != SYMBOL) return false;
+    }
+    return true;
+}
+
+static bool resolve_lambda(struct List *lst, struct Scope *parent, struct Resolver *r)
+{
+    // Malformed lambdas are left alone for the compiler to report
+    if (lst->size != 3 || !valid_args(list_lookup(lst, 1))) return true;
+
+    struct Scope scope;
+    scope.args = list_lookup(lst, 1);
+    scope.defined = list();
+    scope.parent = parent;
+    if (scope.defined == NULL) return true;
+
+    // Macros can expand into defines, so they go first
+    bool ok = expand_expr(&lst->values[2], &scope, r);
+    if (ok)
+    {
+        collect_defines(list_lookup(lst, 2), scope.defined);
+        ok = resolve_expr(&lst->values[2], &scope, r);
+    }
+
+    // The defined list only borrows the symbols from the body
+    delete_list(scope.defined);
+    return ok;
+}
+
+// Resolves the expression stored at v, which may be replaced
+static bool resolve_expr(Value *v, struct Scope *scope, struct Resolver *r)
+{
+    if (*v == NO_VALUE) return true;
+    if (type_of(*v) == SYMBOL)
+    {
+        resolve_symbol(v, scope, r->top);
+        return true;
+    }
+    if (type_of(*v) != LIST || *v == EMPTY_LIST) return true;
+
+    struct List *lst = as_list(*v);
+    Value first = list_lookup(lst, 0);
+    unsigned int start = 0;
+
+    if (type_of(first) == SYMBOL)
+    {
+        char *name = as_symbol(first);
+        if (name == s_quote || name == s_define_syntax)
+        {
+            return true;
+        }
+        else if (name == s_lambda)
+        {
+            return resolve_lambda(lst, scope, r);
+        }
+        else if (name == s_define)
+        {
+            // The name being defined is not a reference
+            start = 2;
+        }
+        else if (is_special_form(name))
+        {
+            start = 1;
+        }
+    }
+    for (unsigned int i = start; i < lst->size; i++)
+    {
+        if (!resolve_expr(&lst->values[i], scope, r)) return false;
+    }
+    return true;
+}
+
+Value resolve(struct Namespace *nsp, struct Parser *parser, Value form)
+{
+    if (s_quote == NULL)
+    {
+        s_quote = intern_cstr("quote");
+        s_lambda = intern_cstr("lambda");
+        s_define = intern_cstr("define");
+        s_define_syntax = intern_cstr("define-syntax");
+    }
+    // Inside a procedure (a form being loaded there), free names may
+    // be bound by its frames, so they can't be tied to top level cells
+    struct Resolver r = { nsp, (nsp->parent == NULL) ? nsp : NULL, parser, 0 };
+
+    // A top level form that's a macro use is replaced as a whole
+    if (!expand_expr(&form, NULL, &r) || !resolve_expr(&form, NULL, &r)) return NO_VALUE;
+    return form;
+}
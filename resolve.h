@@ -0,0 +1,37 @@
+#ifndef RESOLVE
+#define RESOLVE
+#include "datatype.h"
+#include "parser.h"
+
+/* Data structures */
+
+/* Function definitions */
+
+/* Lexical addressing pass, run on each top level form before it is
+ * evaluated in nsp. Every reference inside a lambda body to one of the
+ * parameters of an enclosing lambda is rewritten in place into a LOCAL
+ * value holding the number of frames to walk up and the binding slot to
+ * read, so evaluating it never compares names.
+ *
+ * When nsp is a top level namespace, references to names nothing else
+ * binds become GLOBAL values pointing straight at the name's binding in
+ * nsp, which is made (UNBOUND) if the name isn't defined yet. define and
+ * set! change that binding in place, so reading a global is a single
+ * load and redefinitions are seen by code that's already compiled.
+ *
+ * References that can't be resolved statically are left as symbols and
+ * looked up by name at run time: names that are define'd inside a
+ * procedure body (and anything they shadow), free names when nsp is a
+ * procedure's frame, and code built at run time for eval.
+ *
+ * Uses of macros defined in nsp (see macro.h) are expanded first, and
+ * the expansion takes the use's place for good, so a macro costs nothing
+ * once its use has been loaded. Code built at run time for eval isn't
+ * expanded. Returns the resolved form, which is a new one if the whole
+ * form was a macro use, or NO_VALUE and sets parser->error if an
+ * expansion fails */
+Value resolve(struct Namespace *nsp, struct Parser *parser, Value form);
+
+/* Utility functions */
+
+#endif
@@ -0,0 +1,92 @@
+#include <stdlib.h>
+#include <string.h>
+#include "symbol.h"
+
+/* Internal constants */
+
+const unsigned int INIT_SYMBOL_TABLE_CAPACITY = 256;
+
+/* Data structures */
+
+/* Open-addressing hash set of interned names. Capacity is always a power
+ * of two and the table is kept at most half full so probes stay short. */
+struct SymbolTable
+{
+    unsigned int size;
+    unsigned int capacity;
+    char **names;
+};
+
+static struct SymbolTable table = { 0, 0, NULL };
+
+/* Private function definitions */
+
+/* FNV-1a hash of the first length characters of name */
+static unsigned int hash_name(const char *name, unsigned int length)
+{
+    unsigned int hash = 2166136261u;
+    for (unsigned int i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* Checks if the interned string str is exactly the given name */
+static inline int same_name(const char *str, const char *name, unsigned int length)
+{
+    return strncmp(str, name, length) == 0 && str[length] == '\0';
+}
+
+/* Doubles the table capacity and rehashes every name. Returns 1 on success. */
+static int grow_table(void)
+{
+    unsigned int new_capacity = table.capacity == 0
+        ? INIT_SYMBOL_TABLE_CAPACITY
+        : table.capacity * 2;
+    char **names = calloc(new_capacity, sizeof(*names));
+    if (names == NULL) return 0;
+
+    for (unsigned int i = 0; i < table.capacity; i++)
+    {
+        char *name = table.names[i];
+        if (name == NULL) continue;
+        unsigned int j = hash_name(name, strlen(name)) & (new_capacity - 1);
+        while (names[j] != NULL) j = (j + 1) & (new_capacity - 1);
+        names[j] = name;
+    }
+
+    free(table.names);
+    table.names = names;
+    table.capacity = new_capacity;
+    return 1;
+}
+
+char *intern(const char *name, unsigned int length)
+{
+    if (table.size * 2 >= table.capacity && !grow_table())
+    {
+        return NULL;
+    }
+
+    unsigned int mask = table.capacity - 1;
+    unsigned int i = hash_name(name, length) & mask;
+    for (; table.names[i] != NULL; i = (i + 1) & mask)
+    {
+        if (same_name(table.names[i], name, length))
+        {
+            return table.names[i];
+        }
+    }
+
+    // First time we've seen this name, so store the one canonical copy
+    char *str = malloc(length + 1);
+    if (str == NULL) return NULL;
+    memcpy(str, name, length);
+    str[length] = '\0';
+
+    table.names[i] = str;
+    table.size++;
+    return str;
+}
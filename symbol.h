@@ -0,0 +1,28 @@
+#ifndef SYMBOL_INCLUDE
+#define SYMBOL_INCLUDE
+#include <string.h>
+
+/* Data structures */
+
+/* Every distinct symbol name is stored exactly once in a global table,
+ * so two symbols are the same symbol if and only if their name pointers
+ * are equal. Interned names live for the lifetime of the program and
+ * must never be freed or modified. */
+
+
+/* Function definitions */
+
+/* Returns the canonical copy of the first length characters of name,
+ * adding it to the symbol table if it hasn't been seen before.
+ * Returns NULL on failure. */
+char *intern(const char *name, unsigned int length);
+
+/* Utility functions */
+
+/* Sugar for interning a null-terminated C string */
+static inline char *intern_cstr(const char *name)
+{
+    return intern(name, strlen(name));
+}
+
+#endif
@@ -6,8 +6,32 @@
 #include "datatype.h"
 #include "repl.h"
 #include "parser.h"
+#include "symbol.h"
+#include "namespace.h"
+#include "resolve.h"
+#include "eval.h"
+#include "compile.h"
+#include "builtin.h"
+#include "file.h"
+#include "gc.h"
+#include "f64vector.h"
+#include "number.h"
 
 
+/* Helper function for parsing, resolving and evaluating a single form */
+Value eval_string(struct Namespace *nsp, struct Parser *p, char *code)
+{
+    struct GCRoot root;
+    Value v;
+    init_parser(p, to_scm_string(code));
+    assert(parse(p));
+    p->value = resolve(nsp, p, p->value);
+    gc_push_root(&root, &p->value, 1, nsp);
+    v = (p->value == NO_VALUE) ? NO_VALUE : eval(nsp, p, p->value);
+    gc_pop_root(&root);
+    return v;
+}
+
 /* Helper function for checking that the state of the parser is what we expect */ 
 void assert_init_parser(struct Parser p, enum Error err, unsigned int row, unsigned int column, unsigned int index)
 {
@@ -32,13 +56,13 @@ void test_parse_list()
     assert_init_parser(p, NO_ERROR, 1, 25, 24);
 
     // Check internal value
-    assert(p.value != NULL);
-    assert(p.value->type == LIST);
-    assert(p.value->list->size == 4);
-    assert(strcmp(p.value->list->values[0]->symbol, "this") == 0);
-    assert(strcmp(p.value->list->values[1]->symbol, "is") == 0);
-    assert(p.value->list->values[2]->number == 4);
-    assert(strcmp(p.value->list->values[3]->symbol, "atoms") == 0);
+    assert(p.value != NO_VALUE);
+    assert(type_of(p.value) == LIST);
+    assert(as_list(p.value)->size == 4);
+    assert(strcmp(as_symbol(as_list(p.value)->values[0]), "this") == 0);
+    assert(strcmp(as_symbol(as_list(p.value)->values[1]), "is") == 0);
+    assert(as_number(as_list(p.value)->values[2]) == 4);
+    assert(strcmp(as_symbol(as_list(p.value)->values[3]), "atoms") == 0);
 
     // Test nested lists
     sstr = to_scm_string("(this is a (nested ( (list  ) (with) (internal)) sublists))");
@@ -49,17 +73,29 @@ void test_parse_list()
     assert_init_parser(p, NO_ERROR, 1, 60, 59);
 
     // Check internal value
-    assert(p.value != NULL);
-    assert(p.value->type == LIST);
-    assert(p.value->list->size == 4);
-    assert(strcmp(p.value->list->values[0]->symbol, "this") == 0);
-    assert(strcmp(p.value->list->values[1]->symbol, "is") == 0);
-    assert(strcmp(p.value->list->values[2]->symbol, "a") == 0);
-    assert(strcmp(p.value->list->values[3]->list->values[0]->symbol, "nested") == 0);
-    assert(strcmp(p.value->list->values[3]->list->values[1]->list->values[0]->list->values[0]->symbol, "list") == 0);
-    assert(strcmp(p.value->list->values[3]->list->values[1]->list->values[1]->list->values[0]->symbol, "with") == 0);
-    assert(strcmp(p.value->list->values[3]->list->values[1]->list->values[2]->list->values[0]->symbol, "internal") == 0);
-    assert(strcmp(p.value->list->values[3]->list->values[2]->symbol, "sublists") == 0);
+    assert(p.value != NO_VALUE);
+    assert(type_of(p.value) == LIST);
+    assert(as_list(p.value)->size == 4);
+    assert(strcmp(as_symbol(as_list(p.value)->values[0]), "this") == 0);
+    assert(strcmp(as_symbol(as_list(p.value)->values[1]), "is") == 0);
+    assert(strcmp(as_symbol(as_list(p.value)->values[2]), "a") == 0);
+    assert(strcmp(as_symbol(as_list(as_list(p.value)->values[3])->values[0]), "nested") == 0);
+    assert(strcmp(as_symbol(as_list(as_list(as_list(as_list(p.value)->values[3])->values[1])->values[0])->values[0]), "list") == 0);
+    assert(strcmp(as_symbol(as_list(as_list(as_list(as_list(p.value)->values[3])->values[1])->values[1])->values[0]), "with") == 0);
+    assert(strcmp(as_symbol(as_list(as_list(as_list(as_list(p.value)->values[3])->values[1])->values[2])->values[0]), "internal") == 0);
+    assert(strcmp(as_symbol(as_list(as_list(p.value)->values[3])->values[2]), "sublists") == 0);
+
+    // Lists are allocated at their final size
+    assert(as_list(p.value)->capacity == 4);
+    assert(as_list(as_list(p.value)->values[3])->capacity == 3);
+
+    // A list that fails part way leaves nothing behind for the next one
+    init_parser(&p, to_scm_string("(a (b c"));
+    assert(!parse_list(&p) && p.error == UNEXPECTED_END_OF_LIST);
+    init_parser(&p, to_scm_string("(d ())"));
+    assert(parse_list(&p));
+    assert(as_list(p.value)->size == 2 && as_list(p.value)->values[1] == EMPTY_LIST);
+    assert(strcmp(as_symbol(as_list(p.value)->values[0]), "d") == 0);
 }
 
 /* Tests for parsing a symbol */
@@ -77,9 +113,949 @@ void test_parse_symbol()
     assert_init_parser(p, NO_ERROR, 1, 14, 13);
 
     // Check internal value
-    assert(p.value != NULL);
-    assert(p.value->type == SYMBOL);
-    assert(strcmp(p.value->symbol, "flippity-floo") == 0);
+    assert(p.value != NO_VALUE);
+    assert(type_of(p.value) == SYMBOL);
+    assert(strcmp(as_symbol(p.value), "flippity-floo") == 0);
+}
+
+/* Tests for the symbol intern table */
+void test_intern()
+{
+    ScmString *sstr;
+    struct Parser p;
+
+    // Same name always gives back the same pointer
+    char *a = intern_cstr("some-symbol");
+    assert(a != NULL);
+    assert(strcmp(a, "some-symbol") == 0);
+    assert(intern("some-symbol-and-more", 11) == a);
+    assert(intern_cstr("some-symbo") != a);
+
+    // Every occurrence of a symbol in parsed code shares one name
+    sstr = to_scm_string("(foo bar foo some-symbol)");
+    init_parser(&p, sstr);
+    assert(parse_list(&p));
+    assert(as_symbol(as_list(p.value)->values[0]) == as_symbol(as_list(p.value)->values[2]));
+    assert(as_symbol(as_list(p.value)->values[0]) != as_symbol(as_list(p.value)->values[1]));
+    assert(as_symbol(as_list(p.value)->values[3]) == a);
+
+    // Stress test table growth
+    char name[16];
+    for (unsigned int i = 0; i < 5000; i++)
+    {
+        sprintf(name, "sym%u", i);
+        assert(strcmp(intern_cstr(name), name) == 0);
+    }
+    assert(intern_cstr("sym1234") == intern_cstr("sym1234"));
+    assert(intern_cstr("some-symbol") == a);
+}
+
+/* Tests for defining and looking up variables in namespaces */
+void test_namespace()
+{
+    struct Namespace global;
+    struct Namespace *child;
+    char name[16];
+
+    init_nsp(&global, NULL);
+    child = new_nsp(&global);
+
+    // Enough definitions to move past the small namespace mode
+    for (unsigned int i = 0; i < 1000; i++)
+    {
+        sprintf(name, "var%u", i);
+        define(&global, vsymbol(intern_cstr(name)), vnumber(i));
+    }
+    assert(global.size == 1000);
+    assert(global.index != NULL);
+    for (unsigned int i = 0; i < 1000; i++)
+    {
+        sprintf(name, "var%u", i);
+        assert(as_number(lookup_var(&global, intern_cstr(name))) == i);
+        assert(as_number(lookup_var(child, intern_cstr(name))) == i);
+    }
+    assert(lookup_var(&global, intern_cstr("not-defined")) == NO_VALUE);
+
+    // Redefining overwrites the old binding rather than adding a new one
+    define(&global, vsymbol(intern_cstr("var10")), vnumber(-1));
+    assert(global.size == 1000);
+    assert(as_number(lookup_var(&global, intern_cstr("var10"))) == -1);
+
+    // Child bindings shadow the parent's without touching them
+    define(child, vsymbol(intern_cstr("var20")), vnumber(-2));
+    assert(child->index == NULL);
+    assert(as_number(lookup_var(child, intern_cstr("var20"))) == -2);
+    assert(as_number(lookup_var(&global, intern_cstr("var20"))) == 20);
+    assert(find_binding(child, intern_cstr("var21")) == NULL);
+    assert(find_binding(&global, intern_cstr("var21")) == binding_at(&global, 21));
+}
+
+/* Tests for closures and resolving variables to frame slots */
+void test_lexical_scope()
+{
+    struct Namespace nsp;
+    struct Parser p;
+    Value v, body;
+    init_nsp(&nsp, NULL);
+    register_builtins(&nsp);
+
+    // Parameters are rewritten to (depth, slot), globals to their cells
+    init_parser(&p, to_scm_string("(lambda (x y) (lambda (z) (+ x y z g)))"));
+    assert(parse(&p));
+    resolve(&nsp, &p, p.value);
+    body = as_list(as_list(p.value)->values[2])->values[2];
+    assert(type_of(as_list(body)->values[0]) == GLOBAL);
+    assert(as_object(as_list(body)->values[0])->global.cell == find_binding(&nsp, intern_cstr("+")));
+    assert(type_of(as_list(body)->values[1]) == LOCAL);
+    assert(as_object(as_list(body)->values[1])->local.depth == 1);
+    assert(as_object(as_list(body)->values[1])->local.slot == 0);
+    assert(as_object(as_list(body)->values[2])->local.depth == 1);
+    assert(as_object(as_list(body)->values[2])->local.slot == 1);
+    assert(as_object(as_list(body)->values[3])->local.depth == 0);
+    assert(as_object(as_list(body)->values[3])->local.slot == 0);
+    assert(type_of(as_list(body)->values[4]) == GLOBAL);
+    assert(as_object(as_list(body)->values[4])->global.cell->value == UNBOUND);
+
+    // Closures keep the namespace they were created in
+    eval_string(&nsp, &p, "(define make-adder (lambda (n) (lambda (x) (+ x n))))");
+    eval_string(&nsp, &p, "(define add2 (make-adder 2))");
+    eval_string(&nsp, &p, "(define n 100)");
+    v = eval_string(&nsp, &p, "(add2 5)");
+    assert(p.error == NO_ERROR);
+    assert(type_of(v) == NUMBER && as_number(v) == 7);
+
+    // Inner defines shadow outer parameters, so those stay dynamic
+    v = eval_string(&nsp, &p, "((lambda (x) ((lambda () (begin (define x 5) x)))) 1)");
+    assert(p.error == NO_ERROR);
+    assert(as_number(v) == 5);
+
+    // set! updates the closed over binding rather than making a new one
+    eval_string(&nsp, &p, "(define counter ((lambda (c) (lambda () (begin (set! c (+ c 1)) c))) 0))");
+    eval_string(&nsp, &p, "(counter)");
+    v = eval_string(&nsp, &p, "(counter)");
+    assert(p.error == NO_ERROR);
+    assert(as_number(v) == 2);
+    eval_string(&nsp, &p, "(set! not-bound-anywhere 1)");
+    assert(p.error == SYMBOL_NOT_BOUND);
+
+    // Parameter names must be unique
+    eval_string(&nsp, &p, "(lambda (a b a) a)");
+    assert(p.error == DUPLICATE_PARAMETER);
+}
+
+/* Top level references are tied to the cell of the binding they name */
+void test_globals()
+{
+    struct Namespace nsp, child;
+    struct Parser p;
+    struct Binding *cell;
+    char name[16];
+    Value v;
+    init_nsp(&nsp, NULL);
+    register_builtins(&nsp);
+
+    // Forward references get an unbound cell that define fills in
+    eval_string(&nsp, &p, "(define f (lambda () (g 1)))");
+    eval_string(&nsp, &p, "(f)");
+    assert(p.error == SYMBOL_NOT_BOUND);
+    cell = find_binding(&nsp, intern_cstr("g"));
+    assert(cell != NULL && cell->value == UNBOUND);
+    assert(lookup_var(&nsp, intern_cstr("g")) == NO_VALUE);
+    eval_string(&nsp, &p, "(set! g 1)");
+    assert(p.error == SYMBOL_NOT_BOUND);
+    eval_string(&nsp, &p, "(define g (lambda (x) (+ x 1)))");
+    v = eval_string(&nsp, &p, "(f)");
+    assert(p.error == NO_ERROR && as_fixnum(v) == 2);
+    assert(find_binding(&nsp, intern_cstr("g")) == cell);
+
+    // Redefining is seen by code compiled before, and so is set!
+    eval_string(&nsp, &p, "(define g (lambda (x) (+ x 10)))");
+    v = eval_string(&nsp, &p, "(f)");
+    assert(p.error == NO_ERROR && as_fixnum(v) == 11);
+    eval_string(&nsp, &p, "(set! g (lambda (x) x))");
+    v = eval_string(&nsp, &p, "(f)");
+    assert(p.error == NO_ERROR && as_fixnum(v) == 1);
+
+    // Including the names that have instructions of their own
+    eval_string(&nsp, &p, "(define add (lambda (a b) (+ a b)))");
+    eval_string(&nsp, &p, "(define plus +)");
+    eval_string(&nsp, &p, "(set! + -)");
+    v = eval_string(&nsp, &p, "(add 5 3)");
+    assert(p.error == NO_ERROR && as_fixnum(v) == 2);
+    eval_string(&nsp, &p, "(set! + plus)");
+    v = eval_string(&nsp, &p, "(add 5 3)");
+    assert(p.error == NO_ERROR && as_fixnum(v) == 8);
+
+    // Bindings stay put as the namespace grows
+    for (unsigned int i = 0; i < 1000; i++)
+    {
+        sprintf(name, "global%u", i);
+        define(&nsp, vsymbol(intern_cstr(name)), vinteger(i));
+    }
+    assert(find_binding(&nsp, intern_cstr("g")) == cell);
+    v = eval_string(&nsp, &p, "(+ (f) global999)");
+    assert(p.error == NO_ERROR && as_fixnum(v) == 1000);
+
+    // Code resolved inside a procedure's frame, or built at run time,
+    // still looks names up as it runs
+    init_nsp(&child, &nsp);
+    define(&child, vsymbol(intern_cstr("y")), vinteger(41));
+    init_parser(&p, to_scm_string("(+ y 1)"));
+    assert(parse(&p));
+    resolve(&child, &p, p.value);
+    assert(type_of(as_list(p.value)->values[1]) == SYMBOL);
+    assert(find_binding(&nsp, intern_cstr("y")) == NULL);
+    v = eval(&child, &p, p.value);
+    assert(p.error == NO_ERROR && as_fixnum(v) == 42);
+    v = eval_string(&nsp, &p, "(eval (cons (quote g) (quote (3))))");
+    assert(p.error == NO_ERROR && as_fixnum(v) == 3);
+}
+
+/* Counts the namespaces the collector owns */
+unsigned int heap_namespaces()
+{
+    unsigned int count = 0;
+    for (struct Namespace *nsp = heap.namespaces; nsp != NULL; nsp = nsp->next) count++;
+    return count;
+}
+
+/* Call frames are recycled unless a closure holds on to them */
+void test_frames()
+{
+    struct Namespace nsp, *frame;
+    struct Parser p;
+    struct GCRoot root;
+    Value v;
+    unsigned int namespaces;
+    init_nsp(&nsp, NULL);
+    register_builtins(&nsp);
+
+    // Returning calls leave nothing for the collector
+    eval_string(&nsp, &p, "(define sum (lambda (n) (if (= n 0) 0 (+ n (sum (- n 1))))))");
+    namespaces = heap_namespaces();
+    v = eval_string(&nsp, &p, "(sum 5000)");
+    assert(p.error == NO_ERROR && as_fixnum(v) == 12502500);
+    assert(heap_namespaces() == namespaces);
+
+    // Frames that are given back are used for the next call
+    frame = new_frame(&nsp);
+    assert(frame->pooled && !frame->on_heap);
+    release_frame(frame);
+    assert(new_frame(&nsp) == frame);
+    release_frame(frame);
+
+    // Captured frames belong to the collector and outlive their call
+    eval_string(&nsp, &p, "(define make-adder (lambda (n) (lambda (x) (+ x n))))");
+    eval_string(&nsp, &p, "(define add3 (make-adder 3))");
+    assert(heap_namespaces() == namespaces + 1);
+    frame = get_env(lookup_var(&nsp, intern_cstr("add3")));
+    assert(frame->pooled && frame->on_heap);
+    gc_push_root(&root, NULL, 0, &nsp);
+    gc_collect();
+    gc_pop_root(&root);
+    v = eval_string(&nsp, &p, "(add3 4)");
+    assert(p.error == NO_ERROR && as_fixnum(v) == 7);
+
+    // Errors part way through give back the frames of the calls they cut short
+    eval_string(&nsp, &p, "(sum (quote x))");
+    assert(p.error != NO_ERROR);
+    v = eval_string(&nsp, &p, "(sum 10)");
+    assert(p.error == NO_ERROR && as_fixnum(v) == 55);
+}
+
+/* Tail calls run in constant C stack */
+void test_tail_calls()
+{
+    struct Namespace nsp;
+    struct Parser p;
+    Value v;
+    init_nsp(&nsp, NULL);
+    register_builtins(&nsp);
+
+    // Far deeper than the C stack could take if each call nested
+    eval_string(&nsp, &p, "(define count (lambda (x) (if (= 0 x) \"done\" (count (- x 1)))))");
+    v = eval_string(&nsp, &p, "(count 1000000)");
+    assert(p.error == NO_ERROR);
+    assert(type_of(v) == STRING && strcmp(from_scm_string(as_string(v)), "done") == 0);
+
+    // The last form of begin and the last operand of and/or are tail calls too
+    eval_string(&nsp, &p, "(define loop (lambda (x) (begin x (and #t (or #f (if (= 0 x) x (loop (- x 1))))))))");
+    v = eval_string(&nsp, &p, "(loop 1000000)");
+    assert(p.error == NO_ERROR);
+    assert(as_number(v) == 0);
+
+    // Mutual recursion through a global
+    eval_string(&nsp, &p, "(define even (lambda (x) (if (= 0 x) #t (odd (- x 1)))))");
+    eval_string(&nsp, &p, "(define odd (lambda (x) (if (= 0 x) #f (even (- x 1)))))");
+    v = eval_string(&nsp, &p, "(even 1000001)");
+    assert(p.error == NO_ERROR);
+    assert(v == FALSE_VALUE);
+
+    // and/or give back the value that decided them
+    v = eval_string(&nsp, &p, "(or #f 3 4)");
+    assert(as_number(v) == 3);
+    v = eval_string(&nsp, &p, "(and 1 2)");
+    assert(as_number(v) == 2);
+    v = eval_string(&nsp, &p, "(and 1 #f 2)");
+    assert(v == FALSE_VALUE);
+    assert(eval_string(&nsp, &p, "(and)") == TRUE_VALUE);
+    assert(eval_string(&nsp, &p, "(or)") == FALSE_VALUE);
+
+    // Errors in tail position still come out
+    eval_string(&nsp, &p, "(begin 1 (undefined-thing))");
+    assert(p.error == SYMBOL_NOT_BOUND);
+}
+
+/* Forms are compiled to bytecode before they run */
+void test_compile()
+{
+    struct Namespace nsp;
+    struct Parser p;
+    Value v, code;
+    init_nsp(&nsp, NULL);
+    register_builtins(&nsp);
+
+    // Two argument arithmetic gets its own instruction
+    init_parser(&p, to_scm_string("(lambda (x) (+ x 1))"));
+    assert(parse(&p));
+    resolve(&nsp, &p, p.value);
+    code = compile(&p, p.value);
+    assert(p.error == NO_ERROR && type_of(code) == CODE);
+    assert(as_code(code)->ops[0] == OP_LAMBDA);
+    code = as_code(code)->constants->values[as_code(code)->ops[1]];
+    assert(as_code(code)->nparams == 1 && !as_code(code)->variadic);
+    assert(as_code(code)->ops[0] == OP_LOCAL && as_code(code)->ops[3] == OP_CONST);
+    assert(as_code(code)->ops[5] == OP_ADD && as_code(code)->ops[7] == OP_RETURN);
+
+    // Malformed forms are caught before anything runs
+    init_parser(&p, to_scm_string("(begin (define ran 1) (if))"));
+    assert(parse(&p));
+    assert(compile(&p, p.value) == NO_VALUE && p.error == INCORRECT_NUMBER_OF_ARGS);
+    eval_string(&nsp, &p, "(begin (define ran 1) (if))");
+    assert(lookup_var(&nsp, intern_cstr("ran")) == NO_VALUE);
+
+    // Arithmetic still goes through whatever the name is bound to
+    eval_string(&nsp, &p, "(define add +)");
+    eval_string(&nsp, &p, "(define + (lambda (a b) (- a b)))");
+    v = eval_string(&nsp, &p, "(+ 5 3)");
+    assert(p.error == NO_ERROR && as_number(v) == 2);
+    v = eval_string(&nsp, &p, "((lambda (+) (+ 5 3)) add)");
+    assert(p.error == NO_ERROR && as_number(v) == 8);
+    eval_string(&nsp, &p, "(set! + add)");
+    eval_string(&nsp, &p, "(+ 1 \"a\")");
+    assert(p.error == EXPECTED_NUMBER);
+
+    // Calls that aren't tail calls are kept off the C stack too
+    eval_string(&nsp, &p, "(define depth (lambda (n) (if (= n 0) 0 (+ 1 (depth (- n 1))))))");
+    v = eval_string(&nsp, &p, "(depth 100000)");
+    assert(p.error == NO_ERROR && as_number(v) == 100000);
+
+    // Code made at run time is compiled when it's evaluated
+    v = eval_string(&nsp, &p, "(eval (quote ((lambda (x) (+ x x)) 21)))");
+    assert(p.error == NO_ERROR && as_number(v) == 42);
+    v = eval_string(&nsp, &p, "(if #f #f)");
+    assert(p.error == NO_ERROR && v == NO_VALUE);
+    eval_string(&nsp, &p, "(+ 1 (if #f #f))");
+    assert(p.error == UNDEFINED);
+}
+
+// Compiles a lambda and gets the code of its body
+static struct Code *lambda_body(struct Namespace *nsp, struct Parser *p, char *str)
+{
+    init_parser(p, to_scm_string(str));
+    assert(parse(p));
+    resolve(nsp, p, p->value);
+    Value code = compile(p, p->value);
+    assert(p->error == NO_ERROR && as_code(code)->ops[0] == OP_LAMBDA);
+    return as_code(as_code(code)->constants->values[as_code(code)->ops[1]]);
+}
+
+/* Constant expressions are worked out when they're compiled */
+void test_fold()
+{
+    struct Namespace nsp;
+    struct Parser p;
+    struct Code *code;
+    Value v;
+    init_nsp(&nsp, NULL);
+    register_builtins(&nsp);
+
+    // Calls to builtins with constant arguments fold into one value,
+    // which depends on the globals they went through
+    code = lambda_body(&nsp, &p, "(lambda () (* 2 (+ 1 (if (= 0 0) 2 x))))");
+    assert(code->ops[0] == OP_FOLDED);
+    v = code->constants->values[code->ops[1]];
+    assert(as_list(v)->size == 7 && as_number(as_list(v)->values[0]) == 6);
+
+    // So does an if whose test folds, leaving no test or jumps to run
+    code = lambda_body(&nsp, &p, "(lambda (x) (if (= 0 0) 1 x))");
+    assert(code->ops[0] == OP_FOLDED);
+    v = code->constants->values[code->ops[1]];
+    assert(as_list(v)->size == 3 && as_number(as_list(v)->values[0]) == 1);
+    assert(code->ops[code->ops[2]] == OP_RETURN);
+    eval_string(&nsp, &p, "(define k (lambda () (if (< 1 0) (car) 2)))");
+    assert(as_number(eval_string(&nsp, &p, "(k)")) == 2);
+
+    // Special forms with constant tests need no builtins, so they're
+    // simplified for good
+    code = lambda_body(&nsp, &p, "(lambda (x) (if (and #t (quote #f)) 1 (begin 1 (begin 2 x))))");
+    assert(code->ops[0] == OP_LOCAL && code->ops[3] == OP_RETURN);
+    code = lambda_body(&nsp, &p, "(lambda (x) (or #f x))");
+    assert(code->ops[0] == OP_LOCAL && code->ops[3] == OP_RETURN);
+    v = eval_string(&nsp, &p, "((lambda (x) (and x #f (car))) 1)");
+    assert(p.error == NO_ERROR && v == FALSE_VALUE);
+    v = eval_string(&nsp, &p, "(begin (begin (define y 1) 2) y)");
+    assert(p.error == NO_ERROR && as_number(v) == 1);
+
+    // Code that can't run still has to make sense
+    init_parser(&p, to_scm_string("(if #f (if) 1)"));
+    assert(parse(&p));
+    assert(compile(&p, p.value) == NO_VALUE && p.error == INCORRECT_NUMBER_OF_ARGS);
+
+    // Redefining a builtin undoes the folds that used it
+    eval_string(&nsp, &p, "(define f (lambda () (+ 1 2)))");
+    eval_string(&nsp, &p, "(define g (lambda () (not (< 2 1))))");
+    eval_string(&nsp, &p, "(define add +)");
+    assert(as_number(eval_string(&nsp, &p, "(f)")) == 3);
+    eval_string(&nsp, &p, "(define + -)");
+    assert(as_number(eval_string(&nsp, &p, "(f)")) == -1);
+    eval_string(&nsp, &p, "(set! + add)");
+    assert(as_number(eval_string(&nsp, &p, "(f)")) == 3);
+    assert(eval_string(&nsp, &p, "(g)") == TRUE_VALUE);
+    eval_string(&nsp, &p, "(define not (lambda (x) x))");
+    assert(eval_string(&nsp, &p, "(g)") == FALSE_VALUE);
+
+    // Calls that would fail are left to fail when they run
+    eval_string(&nsp, &p, "(define h (lambda () (+ 1 \"a\")))");
+    assert(p.error == NO_ERROR);
+    eval_string(&nsp, &p, "(h)");
+    assert(p.error == EXPECTED_NUMBER);
+}
+
+/* Macros are expanded once, where they're used */
+void test_macros()
+{
+    struct Namespace nsp;
+    struct Parser p;
+    struct GCRoot root;
+    Value v;
+    init_nsp(&nsp, NULL);
+    register_builtins(&nsp);
+
+    eval_string(&nsp, &p, "(define-syntax swap! (syntax-rules () "
+            "((_ a b) ((lambda (tmp) (begin (set! a b) (set! b tmp))) a))))");
+    assert(p.error == NO_ERROR);
+    eval_string(&nsp, &p, "(define x 1)");
+    eval_string(&nsp, &p, "(define y 2)");
+    eval_string(&nsp, &p, "(swap! x y)");
+    assert(p.error == NO_ERROR);
+    assert(as_number(lookup_var(&nsp, intern_cstr("x"))) == 2);
+    assert(as_number(lookup_var(&nsp, intern_cstr("y"))) == 1);
+
+    // The expansion replaces the use, so redefining the macro doesn't
+    // change code that's already loaded
+    eval_string(&nsp, &p, "(define-syntax inc (syntax-rules () ((_ e) (+ e 1))))");
+    eval_string(&nsp, &p, "(define f (lambda (n) (inc n)))");
+    v = get_body(lookup_var(&nsp, intern_cstr("f")));
+    assert(type_of(list_lookup(as_list(v), 0)) == GLOBAL);
+    eval_string(&nsp, &p, "(define-syntax inc (syntax-rules () ((_ e) (- e 1))))");
+    assert(as_number(eval_string(&nsp, &p, "(f 5)")) == 6);
+    assert(as_number(eval_string(&nsp, &p, "(inc 5)")) == 4);
+
+    // Patterns with ..., nested ones, and literals
+    eval_string(&nsp, &p, "(define-syntax my-or (syntax-rules () ((_) #f) ((_ e) e) "
+            "((_ e r ...) ((lambda (t) (if t t (my-or r ...))) e))))");
+    assert(as_number(eval_string(&nsp, &p, "(my-or #f #f 3)")) == 3);
+    assert(eval_string(&nsp, &p, "(my-or)") == FALSE_VALUE);
+    eval_string(&nsp, &p, "(define-syntax flip (syntax-rules () "
+            "((_ (a b ...) ...) (quote ((b ... a) ...)))))");
+    v = eval_string(&nsp, &p, "(flip (1 2 3) (4))");
+    assert(p.error == NO_ERROR && as_list(v)->size == 2);
+    assert(as_number(as_list(list_lookup(as_list(v), 0))->values[2]) == 1);
+    assert(as_list(list_lookup(as_list(v), 1))->size == 1);
+    eval_string(&nsp, &p, "(define-syntax arrow (syntax-rules (=>) "
+            "((_ a => b) b) ((_ a b c) a)))");
+    assert(as_number(eval_string(&nsp, &p, "(arrow 1 => 2)")) == 2);
+    assert(as_number(eval_string(&nsp, &p, "(arrow 1 2 3)")) == 1);
+
+    // Parameters shadow macros, and macros can expand into defines
+    v = eval_string(&nsp, &p, "((lambda (inc) (inc 1)) (lambda (n) (* n 10)))");
+    assert(p.error == NO_ERROR && as_number(v) == 10);
+    eval_string(&nsp, &p, "(define-syntax def (syntax-rules () ((_ n e) (define n e))))");
+    v = eval_string(&nsp, &p, "((lambda () (begin (def z 5) z)))");
+    assert(p.error == NO_ERROR && as_number(v) == 5);
+    assert(lookup_var(&nsp, intern_cstr("z")) == NO_VALUE);
+
+    // Errors are reported before anything runs
+    eval_string(&nsp, &p, "(swap! x)");
+    assert(p.error == NO_MATCHING_SYNTAX);
+    eval_string(&nsp, &p, "(define-syntax bad (syntax-rules () (_ 1)))");
+    assert(p.error == INVALID_SYNTAX_RULES);
+    eval_string(&nsp, &p, "(define-syntax forever (syntax-rules () ((_ e) (forever e))))");
+    eval_string(&nsp, &p, "(forever 1)");
+    assert(p.error == EXPANSION_TOO_DEEP);
+
+    // lib.scm builds let, cond and friends out of them
+    p.error = NO_ERROR;
+    gc_push_root(&root, NULL, 0, &nsp);
+    load(&nsp, &p, "lib.scm");
+    assert(p.error == NO_ERROR);
+    v = eval_string(&nsp, &p, "(let* ((a 1) (b (+ a 1))) (cond ((= b 1) 10) ((= b 2) 20) (else 30)))");
+    assert(p.error == NO_ERROR && as_number(v) == 20);
+    gc_pop_root(&root);
+}
+
+/* Memos remember values by arguments that are equal?, and forget the
+ * least recently used ones past their budget */
+void test_memoize()
+{
+    struct Namespace nsp;
+    struct Parser p;
+    struct GCRoot root;
+    Value v, memo;
+    init_nsp(&nsp, NULL);
+    register_builtins(&nsp);
+
+    // Each recursive call is made once
+    eval_string(&nsp, &p, "(define fib (memoize (lambda (n) "
+            "(if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))))");
+    v = eval_string(&nsp, &p, "(fib 30)");
+    assert(p.error == NO_ERROR && as_number(v) == 832040);
+    assert(as_number(eval_string(&nsp, &p, "(memo-misses fib)")) == 31);
+    assert(as_number(eval_string(&nsp, &p, "(memo-hits fib)")) == 28);
+    v = eval_string(&nsp, &p, "(= (fib 90) 2880067194370816120)");
+    assert(v == TRUE_VALUE);
+    assert(eval_string(&nsp, &p, "(procedure? fib)") == TRUE_VALUE);
+
+    // Arguments that are equal? are the same call
+    eval_string(&nsp, &p, "(define calls 0)");
+    eval_string(&nsp, &p, "(define tag (memoize (lambda (l) "
+            "(begin (set! calls (+ calls 1)) (cons calls l)))))");
+    eval_string(&nsp, &p, "(tag (quote (1 \"a\")))");
+    v = eval_string(&nsp, &p, "(car (tag (cons 1 (quote (\"a\")))))");
+    assert(p.error == NO_ERROR && as_number(v) == 1);
+    v = eval_string(&nsp, &p, "(car (tag (quote (1 \"b\"))))");
+    assert(as_number(v) == 2);
+    assert(eval_string(&nsp, &p, "(equal? (quote (1 (2 \"x\"))) (cons 1 (cons (cons 2 (quote (\"x\"))) (quote ()))))") == TRUE_VALUE);
+    assert(eval_string(&nsp, &p, "(equal? (quote (1 2)) (quote (1 2 3)))") == FALSE_VALUE);
+
+    // Past the budget, the least recently used value is forgotten
+    eval_string(&nsp, &p, "(set! calls 0)");
+    eval_string(&nsp, &p, "(define square (memoize (lambda (n) "
+            "(begin (set! calls (+ calls 1)) (* n n))) 2))");
+    eval_string(&nsp, &p, "(square 1)");
+    eval_string(&nsp, &p, "(square 2)");
+    eval_string(&nsp, &p, "(square 1)");
+    eval_string(&nsp, &p, "(square 3)");
+    assert(as_number(eval_string(&nsp, &p, "(memo-count square)")) == 2);
+    assert(as_number(eval_string(&nsp, &p, "calls")) == 3);
+    v = eval_string(&nsp, &p, "(square 1)");
+    assert(as_number(v) == 1 && as_number(eval_string(&nsp, &p, "calls")) == 3);
+    eval_string(&nsp, &p, "(square 2)");
+    assert(as_number(eval_string(&nsp, &p, "calls")) == 4);
+
+    // Byte budgets can be bigger than 32 bits, and huge ones mean no limit
+    v = eval_string(&nsp, &p, "(memoize (lambda (x) x) 10 100000000000)");
+    assert(p.error == NO_ERROR && as_memo(v)->max_bytes == (size_t)100000000000);
+    v = eval_string(&nsp, &p, "(memoize (lambda (x) x) 10 (* 100000000000 100000000000))");
+    assert(p.error == NO_ERROR && as_memo(v)->max_bytes == SIZE_MAX);
+    eval_string(&nsp, &p, "(memoize (lambda (x) x) 10 (- 0 1))");
+    assert(p.error == INDEX_OUT_OF_RANGE);
+
+    // An old memo given young values keeps them through collections
+    gc_push_root(&root, NULL, 0, &nsp);
+    gc_collect();
+    eval_string(&nsp, &p, "(tag (quote (2)))");
+    memo = lookup_var(&nsp, intern_cstr("tag"));
+    assert(!is_young(memo) && as_memo(memo)->remembered);
+    gc_minor_collect();
+    assert(!as_memo(memo)->remembered);
+    for (unsigned int i = 0; i < 1000; i++) vstring(to_scm_string("garbage"));
+    v = eval_string(&nsp, &p, "(tag (quote (2)))");
+    assert(p.error == NO_ERROR && as_number(as_pair(v)->car) == 5);
+    gc_pop_root(&root);
+
+    // Only procedures written in Scheme are memoized
+    eval_string(&nsp, &p, "(memoize 1)");
+    assert(p.error == EXPECTED_PROC);
+    eval_string(&nsp, &p, "(memoize car)");
+    assert(p.error == EXPECTED_PROC);
+    eval_string(&nsp, &p, "(memo-hits car)");
+    assert(p.error == EXPECTED_MEMO);
+}
+
+/* Hash tables compare keys with equal? (or eq?), and keep working as they
+ * grow, shrink and get collected */
+void test_hash_tables()
+{
+    struct Namespace nsp;
+    struct Parser p;
+    struct GCRoot root;
+    Value v, table;
+    init_nsp(&nsp, NULL);
+    register_builtins(&nsp);
+
+    eval_string(&nsp, &p, "(define t (make-hash-table))");
+    eval_string(&nsp, &p, "(hash-table-set! t \"a\" 1)");
+    eval_string(&nsp, &p, "(hash-table-set! t (quote (1 2)) 2)");
+    assert(p.error == NO_ERROR);
+    assert(as_number(eval_string(&nsp, &p, "(hash-table-ref t \"a\")")) == 1);
+    assert(as_number(eval_string(&nsp, &p, "(hash-table-ref t (cons 1 (quote (2))))")) == 2);
+    assert(as_number(eval_string(&nsp, &p, "(hash-table-ref/default t \"b\" 3)")) == 3);
+    assert(as_number(eval_string(&nsp, &p, "(hash-table-ref t \"b\" (lambda () 4))")) == 4);
+    eval_string(&nsp, &p, "(hash-table-ref t \"b\")");
+    assert(p.error == KEY_NOT_FOUND);
+
+    // eq? tables only find the same string
+    eval_string(&nsp, &p, "(define e (make-hash-table eq?))");
+    eval_string(&nsp, &p, "(define s \"a\")");
+    eval_string(&nsp, &p, "(hash-table-set! e s 1)");
+    eval_string(&nsp, &p, "(hash-table-set! e 12345678901234567890 2)");
+    assert(eval_string(&nsp, &p, "(hash-table-contains? e s)") == TRUE_VALUE);
+    assert(eval_string(&nsp, &p, "(hash-table-contains? e \"a\")") == FALSE_VALUE);
+    assert(as_number(eval_string(&nsp, &p, "(hash-table-ref e 12345678901234567890)")) == 2);
+    eval_string(&nsp, &p, "(make-hash-table =)");
+    assert(p.error == UNSUPPORTED_EQUIVALENCE);
+
+    // Counting, with update!
+    eval_string(&nsp, &p, "(define count (lambda (l) (if (eq? l (quote ())) 0 (begin "
+            "(hash-table-update!/default t (car l) (lambda (n) (+ n 1)) 0) (count (cdr l))))))");
+    eval_string(&nsp, &p, "(count (quote (x y x z x)))");
+    assert(p.error == NO_ERROR);
+    assert(as_number(eval_string(&nsp, &p, "(hash-table-ref t (quote x))")) == 3);
+    eval_string(&nsp, &p, "(hash-table-update! t (quote y) (lambda (n) (* n 10)))");
+    assert(as_number(eval_string(&nsp, &p, "(hash-table-ref t (quote y))")) == 10);
+    eval_string(&nsp, &p, "(hash-table-update! t (quote w) (lambda (n) n))");
+    assert(p.error == KEY_NOT_FOUND);
+    assert(as_number(eval_string(&nsp, &p, "(hash-table-count t)")) == 5);
+
+    // Deleting keeps every other key reachable
+    eval_string(&nsp, &p, "(define fill (lambda (n) (if (= n 0) 0 (begin "
+            "(hash-table-set! e n (* n n)) (fill (- n 1))))))");
+    eval_string(&nsp, &p, "(define drop (lambda (n) (if (< n 1) 0 (begin "
+            "(hash-table-delete! e n) (drop (- n 2))))))");
+    eval_string(&nsp, &p, "(fill 1000)");
+    eval_string(&nsp, &p, "(drop 1000)");
+    assert(p.error == NO_ERROR);
+    assert(as_number(eval_string(&nsp, &p, "(hash-table-count e)")) == 502);
+    assert(as_number(eval_string(&nsp, &p, "(hash-table-ref e 999)")) == 998001);
+    assert(eval_string(&nsp, &p, "(hash-table-contains? e 998)") == FALSE_VALUE);
+    v = eval_string(&nsp, &p, "(hash-table-keys e)");
+    assert(type_of(v) == LIST && as_list(v)->size == 502);
+
+    // Walking sees every entry once
+    eval_string(&nsp, &p, "(define total 0)");
+    eval_string(&nsp, &p, "(hash-table-walk t (lambda (k n) (set! total (+ total n))))");
+    assert(p.error == NO_ERROR && as_number(eval_string(&nsp, &p, "total")) == 17);
+
+    // An old table given young keys and values keeps them
+    gc_push_root(&root, NULL, 0, &nsp);
+    gc_collect();
+    eval_string(&nsp, &p, "(hash-table-set! t (cons 7 (quote ())) \"seven\")");
+    table = lookup_var(&nsp, intern_cstr("t"));
+    assert(!is_young(table) && as_hash_table(table)->remembered);
+    gc_minor_collect();
+    assert(!as_hash_table(table)->remembered);
+    for (unsigned int i = 0; i < 1000; i++) vstring(to_scm_string("garbage"));
+    v = eval_string(&nsp, &p, "(hash-table-ref t (quote (7)))");
+    assert(p.error == NO_ERROR && strcmp(from_scm_string(as_string(v)), "seven") == 0);
+    gc_pop_root(&root);
+
+    eval_string(&nsp, &p, "(hash-table-ref 1 2)");
+    assert(p.error == EXPECTED_HASH_TABLE);
+}
+
+/* cons makes pairs, and car and cdr never copy */
+void test_pairs()
+{
+    struct Namespace nsp;
+    struct Parser p;
+    struct GCRoot root;
+    Value v, tail;
+    init_nsp(&nsp, NULL);
+    register_builtins(&nsp);
+    p.error = NO_ERROR;
+    gc_push_root(&root, NULL, 0, &nsp);
+    load(&nsp, &p, "lib.scm");
+    gc_pop_root(&root);
+    assert(p.error == NO_ERROR);
+
+    v = eval_string(&nsp, &p, "(cons 1 (quote (2 3)))");
+    assert(type_of(v) == PAIR && as_number(as_pair(v)->car) == 1);
+    assert(type_of(as_pair(v)->cdr) == LIST && as_list(as_pair(v)->cdr)->size == 2);
+    v = eval_string(&nsp, &p, "(cons 1 2)");
+    assert(p.error == EXPECTED_LIST);
+
+    // The tail of an array list shares its values
+    eval_string(&nsp, &p, "(define data (quote (1 2 3)))");
+    v = eval_string(&nsp, &p, "data");
+    gc_push_root(&root, &v, 1, NULL);
+    tail = eval_string(&nsp, &p, "(cdr (cdr data))");
+    gc_pop_root(&root);
+    assert(as_list(tail)->size == 1 && as_list(tail)->values == as_list(v)->values + 2);
+    assert(as_list(tail)->owner == v);
+    assert(eval_string(&nsp, &p, "(cdr (cdr (cdr data)))") == EMPTY_LIST);
+
+    // Every cdr makes a new tail, but they're all the same tail to eq?,
+    // and to eq? hash tables
+    eval_string(&nsp, &p, "(define l (quote (1 2 3)))");
+    assert(eval_string(&nsp, &p, "(eq? (cdr l) (cdr l))") == TRUE_VALUE);
+    assert(eval_string(&nsp, &p, "(eq? (cdr l) (cdr (cdr l)))") == FALSE_VALUE);
+    assert(eval_string(&nsp, &p, "(eq? (cdr l) (quote (2 3)))") == FALSE_VALUE);
+    eval_string(&nsp, &p, "(define e (make-hash-table eq?))");
+    eval_string(&nsp, &p, "(hash-table-set! e (cdr l) 1)");
+    v = eval_string(&nsp, &p, "(hash-table-ref e (cdr l))");
+    assert(p.error == NO_ERROR && as_number(v) == 1);
+
+    // Lists of pairs work with everything lists do
+    v = eval_string(&nsp, &p, "(pair? (cons 1 (quote ())))");
+    assert(v == TRUE_VALUE);
+    v = eval_string(&nsp, &p, "(list? (cons 1 (quote ())))");
+    assert(v == TRUE_VALUE);
+    v = eval_string(&nsp, &p, "(null? (cdr (cons 1 (quote ()))))");
+    assert(v == TRUE_VALUE);
+    v = eval_string(&nsp, &p, "(eval (cons (quote +) (cons 1 (quote (2)))))");
+    assert(p.error == NO_ERROR && as_number(v) == 3);
+    v = eval_string(&nsp, &p, "((eval (list (quote lambda) (cons (quote x) (quote ())) (quote x))) 5)");
+    assert(p.error == NO_ERROR && as_number(v) == 5);
+
+    // Long lists can be built and walked
+    eval_string(&nsp, &p, "(define iota (lambda (n acc) (if (= n 0) acc (iota (- n 1) (cons n acc)))))");
+    eval_string(&nsp, &p, "(define sum (lambda (l acc) (if (null? l) acc (sum (cdr l) (+ acc (car l))))))");
+    eval_string(&nsp, &p, "(define big (map (lambda (x) (+ x 1)) (reverse (iota 100000 (quote ())))))");
+    assert(p.error == NO_ERROR);
+    v = eval_string(&nsp, &p, "(sum big 0)");
+    assert(p.error == NO_ERROR && as_number(v) == 5000050000.0 + 100000);
+    v = eval_string(&nsp, &p, "(car big)");
+    assert(as_number(v) == 100001);
+    v = eval_string(&nsp, &p, "(max 3 9 2 7)");
+    assert(as_number(v) == 9);
+
+    // Reading out of a structure gives back what's in it, not a copy
+    eval_string(&nsp, &p, "(define nested (quote ((1 2) \"s\" 3)))");
+    v = eval_string(&nsp, &p, "(eq? (car nested) (car nested))");
+    assert(v == TRUE_VALUE);
+    v = eval_string(&nsp, &p, "(eq? (cadr nested) (car (cdr nested)))");
+    assert(v == TRUE_VALUE);
+    eval_string(&nsp, &p, "(define fs (list (lambda (x) x) car))");
+    v = eval_string(&nsp, &p, "(eq? (car fs) (car fs))");
+    assert(v == TRUE_VALUE);
+    v = eval_string(&nsp, &p, "((car fs) 4)");
+    assert(as_number(v) == 4);
+}
+
+/* Tests for special form dispatch and first-class builtins */
+void test_builtins()
+{
+    struct Namespace nsp;
+    struct Parser p;
+    Value v;
+    init_nsp(&nsp, NULL);
+    register_builtins(&nsp);
+
+    assert(is_special_form(intern_cstr("lambda")));
+    assert(!is_special_form(intern_cstr("car")));
+
+    // Builtins are ordinary values
+    v = eval_string(&nsp, &p, "car");
+    assert(type_of(v) == BUILTIN);
+    v = eval_string(&nsp, &p, "((lambda (f) (f 1 2 3)) +)");
+    assert(p.error == NO_ERROR);
+    assert(as_number(v) == 6);
+    v = eval_string(&nsp, &p, "(procedure? cons)");
+    assert(type_of(v) == BOOLEAN && as_boolean(v));
+
+    // Parameters may shadow builtins, but not special forms
+    v = eval_string(&nsp, &p, "((lambda (car) (car 5)) -)");
+    assert(p.error == NO_ERROR);
+    assert(as_number(v) == -5);
+    eval_string(&nsp, &p, "(define car cdr)");
+    v = eval_string(&nsp, &p, "(car (quote (1 2)))");
+    assert(type_of(v) == LIST && as_list(v)->size == 1);
+
+    // Argument counts are checked before the builtin runs
+    eval_string(&nsp, &p, "(cons 1)");
+    assert(p.error == INCORRECT_NUMBER_OF_ARGS);
+    eval_string(&nsp, &p, "(1 2)");
+    assert(p.error == FIRST_NOT_PROC);
+}
+
+/* Tests for immediate (unboxed) values */
+void test_immediates()
+{
+    // Numbers round trip through the boxed word exactly
+    double nums[] = { 0, -0.0, 1, -1, 3.14, 1e300, -1e-300, 1.0 / 0.0, -1.0 / 0.0 };
+    for (unsigned int i = 0; i < sizeof(nums) / sizeof(nums[0]); i++)
+    {
+        Value v = vnumber(nums[i]);
+        assert(type_of(v) == NUMBER);
+        assert(!is_object(v));
+        assert(as_number(v) == nums[i]);
+    }
+    assert(type_of(vnumber(0.0 / 0.0)) == NUMBER);
+    assert(vnumber(0.0 / 0.0) != NO_VALUE);
+
+    // So do fixnums, which are never mistaken for doubles
+    int64_t ints[] = { 0, 1, -1, 42, -42, FIXNUM_MAX, FIXNUM_MIN };
+    for (unsigned int i = 0; i < sizeof(ints) / sizeof(ints[0]); i++)
+    {
+        Value v = vfixnum(ints[i]);
+        assert(type_of(v) == NUMBER && is_fixnum(v) && !is_double(v));
+        assert(!is_object(v));
+        assert(as_fixnum(v) == ints[i] && as_number(v) == (double)ints[i]);
+    }
+    assert(is_bignum(vinteger(FIXNUM_MAX + 1)) && as_number(vinteger(FIXNUM_MAX + 1)) == FIXNUM_MAX + 1.0);
+
+    // Booleans, chars and the empty list are their own tags
+    assert(type_of(vboolean(true)) == BOOLEAN && as_boolean(vboolean(true)));
+    assert(type_of(vboolean(false)) == BOOLEAN && !as_boolean(vboolean(false)));
+    assert(vboolean(true) == vboolean(true));
+    for (int c = -128; c < 128; c++)
+    {
+        assert(type_of(vcharacter((char)c)) == CHAR);
+        assert(as_char(vcharacter((char)c)) == (char)c);
+    }
+    assert(type_of(EMPTY_LIST) == LIST && is_empty(as_list(EMPTY_LIST)));
+    assert(vlist(list()) == EMPTY_LIST);
+
+    // Symbols carry their interned name
+    char *name = intern_cstr("immediate");
+    assert(type_of(vsymbol(name)) == SYMBOL && as_symbol(vsymbol(name)) == name);
+
+    // Heap objects keep their type
+    Value str = vstring(to_scm_string("abc"));
+    assert(is_object(str) && type_of(str) == STRING);
+}
+
+/* Tests for reading and loading source files */
+void test_load()
+{
+    struct Namespace nsp;
+    struct Parser p;
+    struct SourceFile src;
+    ScmString *sstr;
+    Value v;
+    char *filename = "test_load.scm";
+    char *code = "(define loaded-a 1)\n(define loaded-b \"two\")\n";
+    init_nsp(&nsp, NULL);
+    register_builtins(&nsp);
+
+    FILE *fp = fopen(filename, "w");
+    assert(fp != NULL);
+    fputs(code, fp);
+    fclose(fp);
+
+    // Both ways of reading give back the exact file contents
+    assert(open_source(&src, filename));
+    assert(src.length == strlen(code));
+    assert(memcmp(src.chars, code, src.length) == 0);
+    close_source(&src);
+    sstr = read_file(filename);
+    assert(sstr != NULL && strcmp(from_scm_string(sstr), code) == 0);
+    delete_scm_string(sstr);
+
+    // Strings parsed from the file outlive the mapping
+    eval_string(&nsp, &p, "(load \"test_load.scm\")");
+    assert(p.error == NO_ERROR);
+    v = eval_string(&nsp, &p, "loaded-b");
+    assert(strcmp(from_scm_string(as_string(v)), "two") == 0);
+    assert(as_number(eval_string(&nsp, &p, "loaded-a")) == 1);
+
+    // Empty files can't be mapped, so they're read instead
+    fp = fopen(filename, "w");
+    fclose(fp);
+    assert(open_source(&src, filename));
+    assert(src.length == 0);
+    close_source(&src);
+    remove(filename);
+
+    assert(!open_source(&src, filename));
+    eval_string(&nsp, &p, "(load \"test_load.scm\")");
+    assert(p.error == CANT_OPEN_FILE);
+}
+
+/* Tests for the garbage collector */
+void test_gc()
+{
+    struct Namespace nsp;
+    struct Parser p;
+    struct GCRoot root;
+    Value kept, v;
+    size_t live;
+    init_nsp(&nsp, NULL);
+    register_builtins(&nsp);
+
+    // Unreachable objects are freed, rooted ones are kept
+    kept = vstring(to_scm_string("kept"));
+    gc_push_root(&root, &kept, 1, &nsp);
+    gc_collect();
+    live = heap.live;
+    for (unsigned int i = 0; i < 1000; i++) vstring(to_scm_string("garbage"));
+    gc_collect();
+    assert(heap.live == live);
+    assert(strcmp(from_scm_string(as_string(kept)), "kept") == 0);
+    gc_pop_root(&root);
+
+    // New objects start in the nursery and move out when they survive
+    gc_push_root(&root, NULL, 0, &nsp);
+    gc_minor_collect();
+    gc_pop_root(&root);
+    struct Namespace *frame = new_nsp(&nsp);
+    v = vlist(list());
+    assert(v == EMPTY_LIST);
+    struct List *lst = list();
+    append(lst, vstring(to_scm_string("inner")));
+    v = vlist(lst);
+    assert(is_young(v) && is_young(lst->values[0]));
+    define(frame, vsymbol(intern_cstr("young")), vstring(to_scm_string("bound")));
+    assert(frame->remembered);
+    unsigned long minors = heap.minor_collections;
+    gc_push_root(&root, &v, 1, frame);
+    gc_minor_collect();
+    gc_pop_root(&root);
+    assert(heap.minor_collections == minors + 1);
+    assert(heap.nursery_top == 0 && !frame->remembered);
+    assert(is_object(v) && !is_young(v));
+    assert(as_list(v) == lst && !is_young(lst->values[0]));
+    assert(strcmp(from_scm_string(as_string(lst->values[0])), "inner") == 0);
+    v = lookup_var(frame, intern_cstr("young"));
+    assert(!is_young(v) && strcmp(from_scm_string(as_string(v)), "bound") == 0);
+
+    // Closures keep their namespaces (and what's bound in them) alive
+    eval_string(&nsp, &p, "(define make-counter (lambda (c) (lambda () (begin (set! c (+ c 1)) c))))");
+    eval_string(&nsp, &p, "(define counter (make-counter (quote 10)))");
+    eval_string(&nsp, &p, "(define rev (lambda (l acc) (if (eq? l (quote ())) acc (rev (cdr l) (cons (car l) acc)))))");
+    gc_push_root(&root, NULL, 0, &nsp);
+    gc_collect();
+    gc_pop_root(&root);
+    v = eval_string(&nsp, &p, "(counter)");
+    assert(p.error == NO_ERROR && as_number(v) == 11);
+
+    // Collections in the middle of evaluating keep every live temporary.
+    // Frames are recycled rather than left to the collector, so churn
+    // makes little old garbage; have a major collection due from the start
+    unsigned long collections = heap.collections;
+    heap.allocated = heap.threshold;
+    eval_string(&nsp, &p, "(define churn (lambda (n) (if (= n 0) (rev (quote (1 2 3 4 5 6 7 8)) (quote ())) (begin (rev (quote (a b c d e f g h i j k l m n o p)) (quote ())) (churn (- n 1))))))");
+    v = eval_string(&nsp, &p, "(churn 3000)");
+    assert(p.error == NO_ERROR);
+    assert(heap.collections > collections);
+    assert(type_of(v) == PAIR && as_number(as_pair(v)->car) == 8);
+    v = flatten_list(v);
+    assert(as_list(v)->size == 8 && as_number(as_list(v)->values[7]) == 1);
+    v = eval_string(&nsp, &p, "(counter)");
+    assert(as_number(v) == 12);
+
+    // The heap doesn't keep what churn made
+    gc_push_root(&root, NULL, 0, &nsp);
+    gc_collect();
+    gc_pop_root(&root);
+    assert(heap.live < MIN_COLLECTION_BYTES);
+
+    // The growth factor sets the gap to the next collection
+    gc_set_heap_growth(100000);
+    assert(heap.threshold == heap.live / 100 * 100000 || heap.threshold == MIN_COLLECTION_BYTES);
+    gc_set_heap_growth(DEFAULT_HEAP_GROWTH);
 }
 
 /* Tests for parsing number values */ 
@@ -97,9 +1073,15 @@ void test_parse_number()
     assert_init_parser(p, NO_ERROR, 1, 11, 10);
 
     // Check internal value
-    assert(p.value != NULL);
-    assert(p.value->type == NUMBER);
-    assert(p.value->number == 1234567890);
+    assert(p.value != NO_VALUE);
+    assert(type_of(p.value) == NUMBER);
+    assert(is_fixnum(p.value) && as_fixnum(p.value) == 1234567890);
+
+    // Too big for a fixnum
+    sstr = to_scm_string("10000000000000000000000");
+    init_parser(&p, sstr);
+    assert(parse_atom(&p));
+    assert(is_bignum(p.value) && as_number(p.value) == 1e22);
 }
 
 /* Tests for parsing hash-prefixed values (bools and chars) */ 
@@ -117,9 +1099,9 @@ void test_parse_hash()
     assert_init_parser(p, NO_ERROR, 1, 3, 2);
 
     // Check internal value
-    assert(p.value != NULL);
-    assert(p.value->type == BOOLEAN);
-    assert(p.value->boolean == 0);
+    assert(p.value != NO_VALUE);
+    assert(type_of(p.value) == BOOLEAN);
+    assert(as_boolean(p.value) == 0);
 
     // Test true
     sstr = to_scm_string("#t");
@@ -128,9 +1110,9 @@ void test_parse_hash()
     // Check parser struct 
     assert(parse_atom(&p));
     assert_init_parser(p, NO_ERROR, 1, 3, 2);
-    assert(p.value != NULL);
-    assert(p.value->type == BOOLEAN);
-    assert(p.value->boolean == 1);
+    assert(p.value != NO_VALUE);
+    assert(type_of(p.value) == BOOLEAN);
+    assert(as_boolean(p.value) == 1);
 
 
     // Test a character
@@ -140,9 +1122,9 @@ void test_parse_hash()
     // Check parser struct 
     assert(parse_atom(&p));
     assert_init_parser(p, NO_ERROR, 1, 4, 3);
-    assert(p.value != NULL);
-    assert(p.value->type == CHAR);
-    assert(p.value->character == 's');
+    assert(p.value != NO_VALUE);
+    assert(type_of(p.value) == CHAR);
+    assert(as_char(p.value) == 's');
 
 
     // Test space
@@ -152,9 +1134,9 @@ void test_parse_hash()
     // Check parser struct 
     assert(parse_atom(&p));
     assert_init_parser(p, NO_ERROR, 1, 8, 7);
-    assert(p.value != NULL);
-    assert(p.value->type == CHAR);
-    assert(p.value->character == ' ');
+    assert(p.value != NO_VALUE);
+    assert(type_of(p.value) == CHAR);
+    assert(as_char(p.value) == ' ');
 
     // Test tab
     sstr = to_scm_string("#\\tab");
@@ -163,9 +1145,9 @@ void test_parse_hash()
     // Check parser struct 
     assert(parse_atom(&p));
     assert_init_parser(p, NO_ERROR, 1, 6, 5);
-    assert(p.value != NULL);
-    assert(p.value->type == CHAR);
-    assert(p.value->character == '\t');
+    assert(p.value != NO_VALUE);
+    assert(type_of(p.value) == CHAR);
+    assert(as_char(p.value) == '\t');
 
     // Test newline
     sstr = to_scm_string("#\\newline");
@@ -174,9 +1156,9 @@ void test_parse_hash()
     // Check parser struct 
     assert(parse_atom(&p));
     assert_init_parser(p, NO_ERROR, 1, 10, 9);
-    assert(p.value != NULL);
-    assert(p.value->type == CHAR);
-    assert(p.value->character == '\n');
+    assert(p.value != NO_VALUE);
+    assert(type_of(p.value) == CHAR);
+    assert(as_char(p.value) == '\n');
 
     // Test bad bool-looking input
     sstr = to_scm_string("#r");
@@ -184,7 +1166,7 @@ void test_parse_hash()
 
     assert(!parse_atom(&p));
     assert(p.error != NO_ERROR);
-    assert(p.value == NULL);
+    assert(p.value == NO_VALUE);
 
     // Test early termination of bool-looking input
     sstr = to_scm_string("#");
@@ -192,7 +1174,7 @@ void test_parse_hash()
 
     assert(!parse_atom(&p));
     assert(p.error != NO_ERROR);
-    assert(p.value == NULL);
+    assert(p.value == NO_VALUE);
 
     // Test bad char-looking input
     sstr = to_scm_string("#\\ta");
@@ -200,7 +1182,7 @@ void test_parse_hash()
 
     assert(!parse_atom(&p));
     assert(p.error != NO_ERROR);
-    assert(p.value == NULL);
+    assert(p.value == NO_VALUE);
 
     // Test early termination of char-looking input
     sstr = to_scm_string("#\\");
@@ -208,7 +1190,7 @@ void test_parse_hash()
 
     assert(!parse_atom(&p));
     assert(p.error != NO_ERROR);
-    assert(p.value == NULL);
+    assert(p.value == NO_VALUE);
 }
 
 /* Tests for parsing Scheme's string type */
@@ -224,11 +1206,79 @@ void test_parse_string()
     assert_init_parser(p, NO_ERROR, 1, 23, 22);
 
     // Check internal value
-    assert(p.value != NULL);
-    assert(p.value->type == STRING);
-    assert(p.value->string != NULL);
-    assert(!is_empty(p.value->string));
-    assert(strcmp(from_scm_string(p.value->string), "this is \\nsome input") == 0);
+    assert(p.value != NO_VALUE);
+    assert(type_of(p.value) == STRING);
+    assert(as_string(p.value) != NULL);
+    assert(as_string(p.value)->length == 20);
+    assert(strcmp(from_scm_string(as_string(p.value)), "this is \\nsome input") == 0);
+}
+
+/* Tests for the byte buffer string type */
+void test_scm_string()
+{
+    ScmString *sstr = to_scm_string("abc");
+    assert(sstr->length == 3);
+    assert(strcmp(from_scm_string(sstr), "abc") == 0);
+
+    // No copy is made when reading the contents back out
+    assert(from_scm_string(sstr) == sstr->chars);
+
+    // Growing keeps the buffer contiguous and null terminated
+    for (unsigned int i = 0; i < 10000; i++)
+    {
+        assert(string_append(sstr, 'a' + (i % 26)));
+    }
+    assert(sstr->length == 10003);
+    assert(sstr->chars[10003] == '\0');
+    assert(sstr->chars[3] == 'a' && sstr->chars[10002] == 'a' + (9999 % 26));
+
+    // Null bytes are just bytes
+    delete_scm_string(sstr);
+    sstr = scm_string("a\0b", 3);
+    assert(sstr->length == 3 && sstr->chars[2] == 'b');
+    delete_scm_string(sstr);
+}
+
+/* Tests for parsing straight out of a raw buffer */
+void test_parse_buffer()
+{
+    struct Parser p;
+    char input[] = "(define s \"a\\\"b\")\n  (sym 12)) trailing";
+    char long_symbol[MAXIMUM_SYMBOL_LENGTH + 1];
+
+    // Only length bytes are read, and rows / columns are tracked as usual
+    init_parser_buffer(&p, input, 28);
+    assert(parse(&p));
+    assert(as_list(p.value)->size == 3);
+    assert(strcmp(from_scm_string(as_string(as_list(p.value)->values[2])), "a\\\"b") == 0);
+    assert(parse(&p));
+    assert(p.index == 28 && p.row == 2 && p.column == 28);
+    assert(as_symbol(as_list(p.value)->values[0]) == intern_cstr("sym"));
+    assert(as_number(as_list(p.value)->values[1]) == 12);
+    assert(!has_next(&p));
+
+    // String literals own their bytes rather than pointing into the input
+    input[11] = 'z';
+    init_parser_buffer(&p, input, 28);
+    assert(parse(&p));
+    assert(from_scm_string(as_string(as_list(p.value)->values[2]))[0] == 'z');
+    input[11] = 'a';
+
+    // Errors inside a string literal fail the parse
+    init_parser_buffer(&p, "\"ab\\q\"", 7);
+    assert(!parse(&p));
+    assert(p.error == UNKNOWN_ESCAPE_SEQUENCE);
+    init_parser_buffer(&p, "\"ab", 3);
+    assert(!parse(&p));
+    assert(p.error == UNTERMINATED_STRING);
+
+    memset(long_symbol, 'x', MAXIMUM_SYMBOL_LENGTH);
+    init_parser_buffer(&p, long_symbol, MAXIMUM_SYMBOL_LENGTH);
+    assert(!parse(&p));
+    assert(p.error == MAXIMUM_SYMBOL_LENGTH_EXCEEDED);
+    init_parser_buffer(&p, long_symbol, MAXIMUM_SYMBOL_LENGTH - 1);
+    assert(parse(&p));
+    assert(strlen(as_symbol(p.value)) == MAXIMUM_SYMBOL_LENGTH - 1);
 }
 
 /* Tests for making sure that the list type works properly */
@@ -236,59 +1286,56 @@ void test_list()
 {
     struct List *lst = list();
 
-    struct Value *v = malloc(sizeof(*v));
-    v->type = NUMBER;
-    v->number = 3.14;
+    Value v = vnumber(3.14);
 
-    // testing basic append
+    // testing basic append, which starts out in the list's own storage
     append(lst, v);
-    assert(lst->capacity == 8);
+    assert(lst->capacity == INIT_LIST_CAPACITY);
+    assert(lst->values == lst->storage);
     assert(lst->size == 1);
-    assert(lst->values[0]->number == 3.14);
+    assert(as_number(lst->values[0]) == 3.14);
 
     // test that capacity grows at a certain threshold
     for (unsigned int i = 0; i < 10; i++)
     {
-        v = malloc(sizeof(*v));
-        v->type = NUMBER;
-        v->number = i;
+        v = vnumber(i);
         append(lst, v);
         assert(lst->size == (i+2));
     }
     assert(lst->capacity == 16);
-    assert(lst->values[9]->number == 8);
+    assert(lst->values != lst->storage);
+    assert(as_number(lst->values[0]) == 3.14);
+    assert(as_number(lst->values[9]) == 8);
 
     // test pop
     v = pop(lst);
-    assert(v->number == 9);
+    assert(as_number(v) == 9);
     assert(lst->size == 10);
 
     v = pop(lst);
-    assert(v->number == 8);
+    assert(as_number(v) == 8);
     assert(lst->size == 9);
     assert(lst->capacity == 16);
 
     for (int i = 0; i < 8; i++) v = pop(lst);
-    assert(v->number == 0);
+    assert(as_number(v) == 0);
     assert(lst->size == 1);
     assert(lst->capacity == 8);
 
     v = pop(lst);
-    assert(v->number == 3.14);
+    assert(as_number(v) == 3.14);
     assert(lst->size == 0);
-    assert(lst->capacity == 8);
+    assert(lst->capacity == INIT_LIST_CAPACITY);
 
-    assert(pop(lst) == NULL);
+    assert(pop(lst) == NO_VALUE);
 
     // Stress test growth / shrinking
     for (unsigned int i = 0; i < 10000; i++)
     {
-        v = malloc(sizeof(*v));
-        v->type = SYMBOL;
-        v->symbol = "hi";
+        v = vsymbol(intern_cstr("hi"));
         append(lst, v);
     }
-    assert(strcmp(lst->values[9999]->symbol, "hi") == 0);
+    assert(strcmp(as_symbol(lst->values[9999]), "hi") == 0);
     assert(lst->size == 10000);
     assert(lst->capacity == 16384);
 
@@ -298,18 +1345,300 @@ void test_list()
     }
     assert(lst->size == 2500);
     assert(lst->capacity == 8192);
-    do { v = pop(lst); } while (v != NULL);
+    do { v = pop(lst); } while (v != NO_VALUE);
     assert(lst->size == 0);
-    assert(lst->capacity == 8);
+    assert(lst->capacity == INIT_LIST_CAPACITY);
+    delete_list(lst);
+
+    // Lists made from known elements are a single allocation of exactly
+    // that size, and still grow as usual
+    Value three[] = { vfixnum(1), vfixnum(2), vfixnum(3) };
+    lst = list_from(three, 3);
+    assert(lst->size == 3 && lst->capacity == 3);
+    assert(lst->values == lst->storage);
+    append(lst, vfixnum(4));
+    assert(lst->capacity == 6 && lst->values != lst->storage);
+    assert(as_fixnum(lst->values[0]) == 1 && as_fixnum(lst->values[3]) == 4);
+    delete_list(lst);
+}
+
+/* Exact integer arithmetic, and where it gives way to doubles */
+void test_fixnums()
+{
+    struct Namespace nsp;
+    struct Parser p;
+    struct GCRoot root;
+    Value v;
+    init_nsp(&nsp, NULL);
+    register_builtins(&nsp);
+    p.error = NO_ERROR;
+    gc_push_root(&root, NULL, 0, &nsp);
+    load(&nsp, &p, "lib.scm");
+    gc_pop_root(&root);
+    assert(p.error == NO_ERROR);
+
+    v = eval_string(&nsp, &p, "(+ 1 2 3)");
+    assert(is_fixnum(v) && as_fixnum(v) == 6);
+    v = eval_string(&nsp, &p, "(- 10 (+ 4 (- 7)))");
+    assert(is_fixnum(v) && as_fixnum(v) == 13);
+    v = eval_string(&nsp, &p, "((lambda (a b) (- a b)) 1 2)");
+    assert(is_fixnum(v) && as_fixnum(v) == -1);
+    v = eval_string(&nsp, &p, "(+)");
+    assert(is_fixnum(v) && as_fixnum(v) == 0);
+
+    // Overflowing a fixnum carries on in bignums, in builtins and in the
+    // VM's inline arithmetic, and coming back in range gives a fixnum
+    v = eval_string(&nsp, &p, "(+ 35184372088831 1)");
+    assert(is_bignum(v) && as_number(v) == 35184372088832.0);
+    v = eval_string(&nsp, &p, "((lambda (a) (+ a 1)) 35184372088831)");
+    assert(is_bignum(v) && as_number(v) == 35184372088832.0);
+    v = eval_string(&nsp, &p, "(+ 35184372088831 1 (- 2))");
+    assert(is_fixnum(v) && as_fixnum(v) == 35184372088830);
+    v = eval_string(&nsp, &p, "(- (- 35184372088831) 1)");
+    assert(is_fixnum(v) && as_fixnum(v) == FIXNUM_MIN);
+    v = eval_string(&nsp, &p, "(- (- (- 35184372088831) 1))");
+    assert(is_bignum(v) && as_number(v) == 35184372088832.0);
+
+    // Exact and inexact numbers compare by value, but aren't the same
+    v = eval_string(&nsp, &p, "(< 1 2 123456789012345678901234567890)");
+    assert(v == TRUE_VALUE);
+    v = eval_string(&nsp, &p, "(= 35184372088832 (+ 35184372088831 1))");
+    assert(v == TRUE_VALUE);
+    v = eval_string(&nsp, &p, "(eq? 3 3)");
+    assert(v == TRUE_VALUE);
+    v = eval_string(&nsp, &p, "(eq? 1 (f64vector-ref (f64vector 1) 0))");
+    assert(v == FALSE_VALUE);
+
+    v = eval_string(&nsp, &p, "(quotient 17 (- 5))");
+    assert(is_fixnum(v) && as_fixnum(v) == -3);
+    v = eval_string(&nsp, &p, "(remainder 17 (- 5))");
+    assert(is_fixnum(v) && as_fixnum(v) == 2);
+    v = eval_string(&nsp, &p, "(modulo 17 (- 5))");
+    assert(is_fixnum(v) && as_fixnum(v) == -3);
+    v = eval_string(&nsp, &p, "(modulo (- 7) 2)");
+    assert(is_fixnum(v) && as_fixnum(v) == 1);
+    v = eval_string(&nsp, &p, "(quotient 123456789012345678 10)");
+    assert(is_bignum(v) && as_number(v) == 12345678901234567.0);
+    eval_string(&nsp, &p, "(remainder 1 0)");
+    assert(p.error == DIVISION_BY_ZERO);
+    eval_string(&nsp, &p, "(modulo 1 (quote a))");
+    assert(p.error == EXPECTED_NUMBER);
+
+    v = eval_string(&nsp, &p, "(even? 10)");
+    assert(v == TRUE_VALUE);
+    v = eval_string(&nsp, &p, "(odd? 7)");
+    assert(v == TRUE_VALUE);
+    v = eval_string(&nsp, &p, "(integer? 123456789012345678901234567890)");
+    assert(v == TRUE_VALUE);
+    v = eval_string(&nsp, &p, "(integer? (quote a))");
+    assert(v == FALSE_VALUE);
+    v = eval_string(&nsp, &p, "(exact? 1)");
+    assert(v == TRUE_VALUE);
+    v = eval_string(&nsp, &p, "(inexact? (f64vector-ref (f64vector 1) 0))");
+    assert(v == TRUE_VALUE);
+}
+
+/* Checks the length and leading digits of an exact integer in decimal */
+void assert_decimal(Value v, unsigned int length, char *prefix)
+{
+    char *digits = integer_to_decimal(v);
+    assert(digits != NULL && strlen(digits) == length);
+    assert(strncmp(digits, prefix, strlen(prefix)) == 0);
+    free(digits);
+}
+
+/* Arbitrary precision integers */
+void test_bignums()
+{
+    struct Namespace nsp;
+    struct Parser p;
+    struct GCRoot root;
+    Value v;
+    init_nsp(&nsp, NULL);
+    register_builtins(&nsp);
+    p.error = NO_ERROR;
+    gc_push_root(&root, NULL, 0, &nsp);
+    load(&nsp, &p, "lib.scm");
+    gc_pop_root(&root);
+    assert(p.error == NO_ERROR);
+
+    eval_string(&nsp, &p, "(define factorial (lambda (n) (if (= n 0) 1 (* n (factorial (- n 1))))))");
+    eval_string(&nsp, &p, "(define expt (lambda (b n) (if (= n 0) 1 (* b (expt b (- n 1))))))");
+    v = eval_string(&nsp, &p, "(factorial 30)");
+    assert_decimal(v, 33, "265252859812191058636308480000000");
+    v = eval_string(&nsp, &p, "(factorial 10000)");
+    assert(p.error == NO_ERROR && is_bignum(v));
+    assert_decimal(v, 35660, "284625968091705451890641321211");
+
+    // Big enough operands for Karatsuba, both evenly sized and lopsided
+    v = eval_string(&nsp, &p, "(* (factorial 1000) (factorial 1200))");
+    assert_decimal(v, 5744, "255547661978214656079604969315");
+    v = eval_string(&nsp, &p, "(* (factorial 3000) (factorial 1000))");
+    assert_decimal(v, 11699, "166964944190193447538585818186");
+    eval_string(&nsp, &p, "(define x (expt 3 3000))");
+    eval_string(&nsp, &p, "(define y (+ (expt 7 1500) 12345))");
+    v = eval_string(&nsp, &p, "(* x y)");
+    assert_decimal(v, 2700, "102523678571962058673773216628");
+    v = eval_string(&nsp, &p, "(= (* x (+ y 1)) (+ (* x y) x))");
+    assert(v == TRUE_VALUE);
+    v = eval_string(&nsp, &p, "(- x y)");
+    assert_decimal(v, 1432, "231080957811190927269310943118");
+
+    v = eval_string(&nsp, &p, "(quotient x y)");
+    assert_decimal(v, 164, "520839768985236900262997820146");
+    v = eval_string(&nsp, &p, "(remainder x y)");
+    assert_decimal(v, 1267, "287646536590632533372763745740");
+    v = eval_string(&nsp, &p, "(modulo (- x) y)");
+    assert_decimal(v, 1268, "414905303152051281758880763545");
+    v = eval_string(&nsp, &p, "(= (+ (* (quotient x y) y) (remainder x y)) x)");
+    assert(v == TRUE_VALUE);
+    v = eval_string(&nsp, &p, "(quotient (factorial 200) (factorial 198))");
+    assert(is_fixnum(v) && as_fixnum(v) == 39800);
+    v = eval_string(&nsp, &p, "(remainder (factorial 100) 1000000007)");
+    assert(is_fixnum(v) && as_fixnum(v) == 437918130);
+    eval_string(&nsp, &p, "(quotient x 0)");
+    assert(p.error == DIVISION_BY_ZERO);
+
+    // Big literals are read exactly
+    v = eval_string(&nsp, &p, "(- 123456789012345678901234567890 123456789012345678901234567889)");
+    assert(is_fixnum(v) && as_fixnum(v) == 1);
+    // Long enough to be split at powers of ten, with zeroes across the splits
+    char literal[1100];
+    strcpy(literal, "(- 1");
+    for (unsigned int i = 0; i < 999; i++) strcat(literal, "0");
+    strcat(literal, "7 (expt 10 1000))");
+    v = eval_string(&nsp, &p, literal);
+    assert(p.error == NO_ERROR && is_fixnum(v) && as_fixnum(v) == 7);
+    v = eval_string(&nsp, &p, "(+ (expt 10 2000) 1)");
+    assert_decimal(v, 2001, "100000000000000000000000000000");
+    char *digits = integer_to_decimal(v);
+    assert(digits != NULL && strcmp(digits + 1990, "00000000001") == 0);
+    free(digits);
+    v = eval_string(&nsp, &p, "(< 35184372088832 (factorial 20) (factorial 21))");
+    assert(v == TRUE_VALUE);
+    v = eval_string(&nsp, &p, "(eq? (factorial 25) (factorial 25))");
+    assert(v == TRUE_VALUE);
+    v = eval_string(&nsp, &p, "(even? (factorial 25))");
+    assert(v == TRUE_VALUE);
+    v = eval_string(&nsp, &p, "(exact? (factorial 25))");
+    assert(v == TRUE_VALUE);
+}
+
+/* f64vectors, their kernels, and builtins that call back into Scheme */
+void test_f64vector()
+{
+    struct Namespace nsp;
+    struct Parser p;
+    Value v;
+    init_nsp(&nsp, NULL);
+    register_builtins(&nsp);
+
+    eval_string(&nsp, &p, "(define v (f64vector 1 2 3 4 5))");
+    v = eval_string(&nsp, &p, "v");
+    assert(type_of(v) == F64VECTOR && as_f64vector(v)->length == 5);
+    assert(as_f64vector(v)->data[4] == 5);
+    v = eval_string(&nsp, &p, "(f64vector-ref v 2)");
+    assert(as_number(v) == 3);
+    v = eval_string(&nsp, &p, "(f64vector-sum v)");
+    assert(as_number(v) == 15);
+    v = eval_string(&nsp, &p, "(f64vector-dot v v)");
+    assert(as_number(v) == 55);
+    v = eval_string(&nsp, &p, "(f64vector-ref (f64vector- v (f64vector 1 1 1 1 1)) 0)");
+    assert(as_number(v) == 0);
+    v = eval_string(&nsp, &p, "(f64vector-ref (f64vector/ v 2) 4)");
+    assert(as_number(v) == 2.5);
+    v = eval_string(&nsp, &p, "(f64vector-sum (f64vector< v 3))");
+    assert(as_number(v) == 2);
+    v = eval_string(&nsp, &p, "(f64vector-sum (f64vector* (f64vector>= v 4) v))");
+    assert(as_number(v) == 9);
+    v = eval_string(&nsp, &p, "(f64vector->list (list->f64vector (cons 1 (quote (2 3)))))");
+    assert(type_of(v) == LIST && as_list(v)->size == 3 && as_number(as_list(v)->values[2]) == 3);
+
+    // map calls back into Scheme, and the callback can collect
+    eval_string(&nsp, &p, "(define double (lambda (x) (+ x x)))");
+    v = eval_string(&nsp, &p, "(f64vector-sum (f64vector-map double (make-f64vector 100000 3)))");
+    assert(p.error == NO_ERROR && as_number(v) == 600000);
+    v = eval_string(&nsp, &p, "(f64vector-ref (f64vector-map - v) 1)");
+    assert(as_number(v) == -2);
+    eval_string(&nsp, &p, "(define nested (lambda (x) (f64vector-sum (f64vector-map double (f64vector x x)))))");
+    v = eval_string(&nsp, &p, "(f64vector-sum (f64vector-map nested (make-f64vector 10000 2)))");
+    assert(p.error == NO_ERROR && as_number(v) == 80000);
+
+    eval_string(&nsp, &p, "(f64vector-ref v 5)");
+    assert(p.error == INDEX_OUT_OF_RANGE);
+    eval_string(&nsp, &p, "(f64vector+ v (f64vector 1 2))");
+    assert(p.error == LENGTH_MISMATCH);
+    eval_string(&nsp, &p, "(f64vector-sum (quote (1 2)))");
+    assert(p.error == EXPECTED_F64VECTOR);
+    eval_string(&nsp, &p, "(f64vector-map (lambda (x) #t) v)");
+    assert(p.error == EXPECTED_NUMBER);
+
+    // Every set of kernels agrees with plain C, including on the
+    // elements left over after the last full register
+    enum VectorOp ops[] = { VEC_ADD, VEC_SUB, VEC_MUL, VEC_DIV, VEC_EQ, VEC_LT, VEC_GT, VEC_LEQ, VEC_GEQ };
+    enum SimdLevel levels[] = { SIMD_SSE2, SIMD_AVX2 };
+    enum SimdLevel best = simd_level();
+    double x[23], y[23], expected[23], out[23], two = 2;
+    for (unsigned int i = 0; i < 23; i++)
+    {
+        x[i] = i;
+        y[i] = (i % 3) * 4;
+    }
+    for (unsigned int l = 0; l < 2; l++)
+    {
+        if (!set_simd_level(levels[l])) continue;
+        for (unsigned int n = 0; n <= 23; n++)
+        {
+            assert(f64_sum(x, n) == n * (n - 1.0) / 2);
+            assert(set_simd_level(SIMD_NONE));
+            double dot = f64_dot(x, y, n);
+            assert(set_simd_level(levels[l]));
+            assert(f64_dot(x, y, n) == dot);
+            for (unsigned int o = 0; o < sizeof(ops) / sizeof(ops[0]); o++)
+            {
+                for (int broadcast = 0; broadcast < 2; broadcast++)
+                {
+                    const double *b = broadcast ? &two : y;
+                    assert(set_simd_level(SIMD_NONE));
+                    f64_binary(ops[o], x, b, broadcast, expected, n);
+                    assert(set_simd_level(levels[l]));
+                    f64_binary(ops[o], x, b, broadcast, out, n);
+                    assert(memcmp(out, expected, n * sizeof(double)) == 0);
+                }
+            }
+        }
+    }
+    assert(set_simd_level(best));
 }
 
 int main()
 {
     test_list();
+    test_scm_string();
     test_parse_string();
+    test_parse_buffer();
     test_parse_hash();
+    test_immediates();
     test_parse_number();
     test_parse_symbol();
+    test_intern();
+    test_namespace();
+    test_lexical_scope();
+    test_globals();
+    test_frames();
+    test_tail_calls();
+    test_compile();
+    test_fold();
+    test_macros();
+    test_memoize();
+    test_hash_tables();
+    test_pairs();
+    test_fixnums();
+    test_bignums();
+    test_f64vector();
+    test_builtins();
+    test_load();
+    test_gc();
     test_parse_list();
     printf("ran tests successfully\n");
 }
@@ -0,0 +1,704 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vm.h"
+#include "compile.h"
+#include "builtin.h"
+#include "error.h"
+#include "eval.h"
+#include "gc.h"
+#include "memo.h"
+
+/* Data structures */
+
+/* A call that's waiting for the one it made to return */
+struct Frame
+{
+    struct Code *code;
+    unsigned int pc;
+
+    /* Stack slot holding the procedure (or code) the call is running,
+     * which keeps it alive. The call's value replaces it on return, and
+     * its temporaries go above it */
+    unsigned int base;
+
+    /* Whether the call made its namespace, and so gives it back when it
+     * returns. Code run by eval borrows its caller's */
+    bool owns_nsp;
+
+    /* Whether the call is running the procedure of a memo, which is two
+     * slots under base with the arguments list above it. Its value is
+     * remembered when it returns */
+    bool memoizing;
+};
+
+/* The value stack and the call stack. The namespace of each call is kept
+ * in nsps rather than in its frame, so the collector can find them all
+ * (nsps[fp] is the namespace of the call that's running) */
+struct Machine
+{
+    Value *stack;
+    unsigned int stack_capacity;
+    struct Frame *frames;
+    struct Namespace **nsps;
+    unsigned int frame_capacity;
+
+    struct GCRoot root;
+    Value init_stack[VM_STACK_SIZE];
+    struct Frame init_frames[VM_FRAMES];
+    struct Namespace *init_nsps[VM_FRAMES];
+};
+
+/* The builtins that OP_ADD to OP_GEQ stand for, in the same order */
+static char *primitive_names[] = { "+", "-", "=", "<", ">", "<=", ">=" };
+static struct InternalFunction *primitives[OP_GEQ - OP_ADD + 1];
+
+/* Private function definitions */
+
+// Makes room for at least size values on the stack
+static bool reserve_stack(struct Machine *m, unsigned int size)
+{
+    if (size <= m->stack_capacity) return true;
+    unsigned int capacity = m->stack_capacity * 2;
+    while (capacity < size) capacity *= 2;
+
+    Value *stack;
+    if (m->stack == m->init_stack)
+    {
+        stack = malloc(capacity * sizeof(*stack));
+        if (stack != NULL) memcpy(stack, m->init_stack, sizeof(m->init_stack));
+    }
+    else
+    {
+        stack = realloc(m->stack, capacity * sizeof(*stack));
+    }
+    if (stack == NULL) return false;
+    m->stack = stack;
+    m->stack_capacity = capacity;
+    m->root.values = stack;
+    return true;
+}
+
+// Makes room for one more frame
+static bool grow_frames(struct Machine *m)
+{
+    unsigned int capacity = m->frame_capacity * 2;
+    struct Frame *frames = malloc(capacity * sizeof(*frames));
+    struct Namespace **nsps = malloc(capacity * sizeof(*nsps));
+    if (frames == NULL || nsps == NULL)
+    {
+        free(frames);
+        free(nsps);
+        return false;
+    }
+    memcpy(frames, m->frames, m->frame_capacity * sizeof(*frames));
+    memcpy(nsps, m->nsps, m->frame_capacity * sizeof(*nsps));
+    if (m->frames != m->init_frames)
+    {
+        free(m->frames);
+        free(m->nsps);
+    }
+    m->frames = frames;
+    m->nsps = nsps;
+    m->frame_capacity = capacity;
+    m->root.frames = nsps;
+    return true;
+}
+
+// Binds the arguments of a call to the parameters of code in frame.
+// Parameters are defined in order, so parameter i ends up in slot i
+static bool bind_args(struct Namespace *frame, struct Code *code, Value *argv, unsigned int argc)
+{
+    if (code->variadic)
+    {
+        struct List *lst = list();
+        if (lst == NULL) return false;
+        for (unsigned int i = 0; i < argc; i++) append(lst, argv[i]);
+        Value args = vlist(lst);
+        if (args == NO_VALUE) return false;
+        return add_binding(frame, as_symbol(code->args), args) != NULL;
+    }
+    // The frame is new and parameter names are unique, so nothing is
+    // bound yet
+    struct List *params = as_list(code->args);
+    for (unsigned int i = 0; i < argc; i++)
+    {
+        if (add_binding(frame, as_symbol(params->values[i]), argv[i]) == NULL) return false;
+    }
+    return true;
+}
+
+// Gets the value of the variable ref refers to, which is either a global
+// or a name to look up from env. Returns NO_VALUE if it isn't bound
+static inline Value variable_value(struct Namespace *env, Value ref)
+{
+    if (type_of(ref) == SYMBOL) return lookup_var(env, as_symbol(ref));
+    Value v = as_object(ref)->global.cell->value;
+    return (v == UNBOUND) ? NO_VALUE : v;
+}
+
+static inline Value apply_fixnum_primitive(enum Opcode op, int64_t a, int64_t b)
+{
+    // Fixnums are small enough that none of this overflows an int64_t
+    switch (op)
+    {
+        case OP_ADD:
+            return vinteger(a + b);
+        case OP_SUB:
+            return vinteger(a - b);
+        case OP_NUM_EQ:
+            return vboolean(a == b);
+        case OP_LT:
+            return vboolean(a < b);
+        case OP_GT:
+            return vboolean(a > b);
+        case OP_LEQ:
+            return vboolean(a <= b);
+        default:
+            return vboolean(a >= b);
+    }
+}
+
+static inline Value apply_primitive(enum Opcode op, double a, double b)
+{
+    switch (op)
+    {
+        case OP_ADD:
+            return vnumber(a + b);
+        case OP_SUB:
+            return vnumber(a - b);
+        case OP_NUM_EQ:
+            return vboolean(a == b);
+        case OP_LT:
+            return vboolean(a < b);
+        case OP_GT:
+            return vboolean(a > b);
+        case OP_LEQ:
+            return vboolean(a <= b);
+        default:
+            return vboolean(a >= b);
+    }
+}
+
+// Runs code with the given values on the stack, the first of which is
+// the slot it runs in, until the outermost call returns
+static Value execute(struct Namespace *nsp, struct Parser *parser, struct Code *code,
+        Value *values, unsigned int count)
+{
+    if (primitives[0] == NULL)
+    {
+        for (unsigned int i = 0; i < sizeof(primitives) / sizeof(primitives[0]); i++)
+        {
+            primitives[i] = find_builtin(primitive_names[i]);
+        }
+    }
+
+    struct Machine m;
+    m.stack = m.init_stack;
+    m.stack_capacity = VM_STACK_SIZE;
+    m.frames = m.init_frames;
+    m.nsps = m.init_nsps;
+    m.frame_capacity = VM_FRAMES;
+
+    // Everything on the stack, and the namespace of every call, is live.
+    // The counts are brought up to date before anything can collect
+    m.nsps[0] = nsp;
+    gc_push_root(&m.root, m.stack, 0, NULL);
+    m.root.frames = m.nsps;
+    m.root.frame_count = 1;
+
+    struct Code *c = code, *callee;
+    struct Namespace *env = nsp, *owner;
+    struct Binding *b;
+    struct List *lst;
+    unsigned int pc = 0, sp = count, base = 0, fp = 0, argc, fslot, guard;
+    bool tail, memoized, owns_nsp = false, memoizing = false;
+    enum Opcode op;
+    Value v, f, a, result = NO_VALUE;
+    if (!reserve_stack(&m, sp + c->max_stack)) goto done;
+    memcpy(m.stack, values, count * sizeof(*values));
+    m.root.count = count;
+
+    for (;;)
+    {
+        op = (enum Opcode)c->ops[pc++];
+        switch (op)
+        {
+            case OP_CONST:
+                m.stack[sp++] = c->constants->values[c->ops[pc++]];
+                break;
+
+            case OP_NONE:
+                m.stack[sp++] = NO_VALUE;
+                break;
+
+            case OP_LOCAL:
+                b = local_binding(env, c->ops[pc], c->ops[pc + 1]);
+                pc += 2;
+                if (b == NULL || b->value == NO_VALUE)
+                {
+                    parser->error = SYMBOL_NOT_BOUND;
+                    goto done;
+                }
+                m.stack[sp++] = b->value;
+                break;
+
+            case OP_GLOBAL:
+                v = as_object(c->constants->values[c->ops[pc++]])->global.cell->value;
+                if (v == NO_VALUE || v == UNBOUND)
+                {
+                    parser->error = SYMBOL_NOT_BOUND;
+                    goto done;
+                }
+                m.stack[sp++] = v;
+                break;
+
+            case OP_DYNAMIC:
+                v = lookup_var(env, as_symbol(c->constants->values[c->ops[pc++]]));
+                if (v == NO_VALUE)
+                {
+                    parser->error = SYMBOL_NOT_BOUND;
+                    goto done;
+                }
+                m.stack[sp++] = v;
+                break;
+
+            case OP_SET_LOCAL:
+                owner = local_frame(env, c->ops[pc]);
+                b = local_binding(owner, 0, c->ops[pc + 1]);
+                pc += 2;
+                v = m.stack[sp - 1];
+                if (b == NULL)
+                {
+                    parser->error = SYMBOL_NOT_BOUND;
+                    goto done;
+                }
+                else if (v == NO_VALUE)
+                {
+                    parser->error = UNDEFINED;
+                    goto done;
+                }
+                set_binding(owner, b, v);
+                m.stack[sp - 1] = NO_VALUE;
+                break;
+
+            case OP_SET_GLOBAL:
+                v = c->constants->values[c->ops[pc++]];
+                b = as_object(v)->global.cell;
+                if (b->value == UNBOUND)
+                {
+                    parser->error = SYMBOL_NOT_BOUND;
+                    goto done;
+                }
+                else if (m.stack[sp - 1] == NO_VALUE)
+                {
+                    parser->error = UNDEFINED;
+                    goto done;
+                }
+                set_binding(as_object(v)->global.nsp, b, m.stack[sp - 1]);
+                m.stack[sp - 1] = NO_VALUE;
+                break;
+
+            case OP_SET_DYNAMIC:
+                v = c->constants->values[c->ops[pc++]];
+                owner = lookup_owner(env, as_symbol(v));
+                if (owner == NULL)
+                {
+                    parser->error = SYMBOL_NOT_BOUND;
+                    goto done;
+                }
+                else if (m.stack[sp - 1] == NO_VALUE)
+                {
+                    parser->error = UNDEFINED;
+                    goto done;
+                }
+                set_binding(owner, find_binding(owner, as_symbol(v)), m.stack[sp - 1]);
+                m.stack[sp - 1] = NO_VALUE;
+                break;
+
+            case OP_DECLARE:
+                define(env, c->constants->values[c->ops[pc++]], NO_VALUE);
+                break;
+
+            case OP_DEFINE:
+                if (m.stack[sp - 1] == NO_VALUE)
+                {
+                    parser->error = UNDEFINED;
+                    goto done;
+                }
+                define(env, c->constants->values[c->ops[pc++]], m.stack[sp - 1]);
+                m.stack[sp - 1] = NO_VALUE;
+                break;
+
+            case OP_POP:
+                sp--;
+                break;
+
+            case OP_JUMP:
+                pc = c->ops[pc];
+                break;
+
+            case OP_JUMP_IF_FALSE:
+            case OP_AND:
+            case OP_OR:
+                v = m.stack[sp - 1];
+                if (v == NO_VALUE)
+                {
+                    parser->error = UNDEFINED;
+                    goto done;
+                }
+                // and/or keep the value they stop at, if only has to test it
+                if ((op == OP_OR) == (v != FALSE_VALUE))
+                {
+                    pc = c->ops[pc];
+                    if (op == OP_JUMP_IF_FALSE) sp--;
+                }
+                else
+                {
+                    pc++;
+                    sp--;
+                }
+                break;
+
+            case OP_FOLDED:
+                // If every builtin the fold used is still where it was,
+                // the value can be used as is
+                lst = as_list(c->constants->values[c->ops[pc]]);
+                for (guard = 1; guard < lst->size; guard += 2)
+                {
+                    if (as_object(lst->values[guard])->global.cell->value != lst->values[guard + 1]) break;
+                }
+                if (guard < lst->size)
+                {
+                    pc += 2;
+                    break;
+                }
+                m.stack[sp++] = lst->values[0];
+                pc = c->ops[pc + 1];
+                break;
+
+            case OP_LAMBDA:
+                // The procedure can outlive this call, so its frame has to
+                // stay as long as the procedure does
+                capture_frame(env);
+                v = vproc(c->constants->values[c->ops[pc++]], env);
+                if (v == NO_VALUE) goto done;
+                m.stack[sp++] = v;
+                break;
+
+            case OP_ADD:
+            case OP_SUB:
+            case OP_NUM_EQ:
+            case OP_LT:
+            case OP_GT:
+            case OP_LEQ:
+            case OP_GEQ:
+                f = variable_value(env, c->constants->values[c->ops[pc++]]);
+                if (f == NO_VALUE)
+                {
+                    parser->error = SYMBOL_NOT_BOUND;
+                    goto done;
+                }
+                a = m.stack[sp - 2];
+                v = m.stack[sp - 1];
+                if (is_immediate_number(a) && is_immediate_number(v)
+                        && type_of(f) == BUILTIN && as_builtin(f) == primitives[op - OP_ADD])
+                {
+                    if (is_fixnum(a) && is_fixnum(v))
+                        m.stack[sp - 2] = apply_fixnum_primitive(op, as_fixnum(a), as_fixnum(v));
+                    else
+                        m.stack[sp - 2] = apply_primitive(op, as_number(a), as_number(v));
+                    sp--;
+                    break;
+                }
+
+                // Anything else is an ordinary call, so put the procedure
+                // under the arguments (the compiler left room for it)
+                m.stack[sp] = v;
+                m.stack[sp - 1] = a;
+                m.stack[sp - 2] = f;
+                sp++;
+                argc = 2;
+                tail = false;
+                goto call;
+
+            case OP_CALL:
+            case OP_TAIL_CALL:
+                argc = c->ops[pc++];
+                tail = (op == OP_TAIL_CALL);
+            call:
+                fslot = sp - argc - 1;
+                f = m.stack[fslot];
+                for (unsigned int i = fslot; i < sp; i++)
+                {
+                    if (m.stack[i] == NO_VALUE)
+                    {
+                        parser->error = UNDEFINED;
+                        goto done;
+                    }
+                }
+
+                if (type_of(f) == BUILTIN)
+                {
+                    // The arguments are passed straight off the stack. A
+                    // builtin can call back in with apply, so the stack
+                    // has to be rooted as it stands
+                    struct InternalFunction *fn = as_builtin(f);
+                    if (argc < (unsigned int)fn->min_args
+                            || (fn->max_args != -1 && argc > (unsigned int)fn->max_args))
+                    {
+                        parser->error = INCORRECT_NUMBER_OF_ARGS;
+                        goto done;
+                    }
+                    m.root.count = sp;
+                    m.root.frame_count = fp + 1;
+                    v = fn->function_ptr(parser, argc, &m.stack[fslot + 1]);
+                    if (parser->error != NO_ERROR) goto done;
+                    m.stack[fslot] = v;
+                    sp = fslot + 1;
+                    break;
+                }
+
+                // A memo always wraps a procedure, which memoize checked
+                memoized = (type_of(f) == MEMO);
+                if (memoized)
+                {
+                    // Arguments the memo has seen before give back the
+                    // value they did then
+                    v = memo_lookup(as_memo(f), &m.stack[fslot + 1], argc);
+                    if (v != NO_VALUE)
+                    {
+                        m.stack[fslot] = v;
+                        sp = fslot + 1;
+                        break;
+                    }
+                    // Otherwise the procedure runs, and its value has to
+                    // come back here to be remembered, so it's never a
+                    // tail call
+                    a = vlist(list_from(&m.stack[fslot + 1], argc));
+                    if (a == NO_VALUE) goto done;
+                    f = as_memo(f)->proc;
+                    tail = false;
+                }
+                else if (type_of(f) != PROCEDURE)
+                {
+                    parser->error = FIRST_NOT_PROC;
+                    goto done;
+                }
+
+                // Must pass an value for each argument
+                callee = as_code(as_proc(f)->code);
+                if (!callee->variadic && argc != callee->nparams)
+                {
+                    parser->error = INCORRECT_NUMBER_OF_ARGS;
+                    goto done;
+                }
+
+                // The caller is finished with after a tail call, so its
+                // frame can be used again right away
+                if (tail && owns_nsp)
+                {
+                    release_frame(env);
+                    owns_nsp = false;
+                }
+
+                // Create a namespace for this scope, inside the one the
+                // procedure closed over
+                env = new_frame(as_proc(f)->env);
+                if (env == NULL) goto done;
+                if (!bind_args(env, callee, &m.stack[fslot + 1], argc))
+                {
+                    release_frame(env);
+                    goto done;
+                }
+
+                if (memoized)
+                {
+                    // The arguments are bound, so their slots can hold
+                    // the list of them and the procedure instead
+                    if (!reserve_stack(&m, fslot + 3))
+                    {
+                        release_frame(env);
+                        goto done;
+                    }
+                    m.stack[fslot + 1] = a;
+                    m.stack[fslot + 2] = f;
+                    fslot += 2;
+                }
+
+                if (tail)
+                {
+                    // The call takes the caller's place
+                    m.stack[base] = f;
+                }
+                else
+                {
+                    if (fp + 1 == m.frame_capacity && !grow_frames(&m))
+                    {
+                        release_frame(env);
+                        goto done;
+                    }
+                    m.frames[fp].code = c;
+                    m.frames[fp].pc = pc;
+                    m.frames[fp].base = base;
+                    m.frames[fp].owns_nsp = owns_nsp;
+                    m.frames[fp].memoizing = memoizing;
+                    fp++;
+                    base = fslot;
+                    memoizing = memoized;
+                }
+                sp = base + 1;
+                m.nsps[fp] = env;
+                owns_nsp = true;
+                c = callee;
+                pc = 0;
+                goto enter;
+
+            case OP_EVAL:
+            case OP_TAIL_EVAL:
+                if (m.stack[sp - 1] == NO_VALUE)
+                {
+                    parser->error = UNDEFINED;
+                    goto done;
+                }
+                // The code was made at run time, so it hasn't been compiled
+                v = compile(parser, m.stack[sp - 1]);
+                if (v == NO_VALUE) goto done;
+
+                // Runs like a call without a namespace of its own
+                if (op == OP_TAIL_EVAL)
+                {
+                    sp = base + 1;
+                }
+                else
+                {
+                    if (fp + 1 == m.frame_capacity && !grow_frames(&m)) goto done;
+                    m.frames[fp].code = c;
+                    m.frames[fp].pc = pc;
+                    m.frames[fp].base = base;
+                    m.frames[fp].owns_nsp = owns_nsp;
+                    m.frames[fp].memoizing = memoizing;
+                    fp++;
+                    base = sp - 1;
+                    m.nsps[fp] = env;
+                    owns_nsp = false;
+                    memoizing = false;
+                }
+                m.stack[base] = v;
+                c = as_code(v);
+                pc = 0;
+            enter:
+                if (!reserve_stack(&m, sp + c->max_stack)) goto done;
+
+                // Every live value is on the stack, so it's safe to collect
+                m.root.count = sp;
+                m.root.frame_count = fp + 1;
+                gc_safe_point(&m.stack[base]);
+                break;
+
+            case OP_LOAD:
+                v = m.stack[sp - 1];
+                if (v == NO_VALUE)
+                {
+                    parser->error = UNDEFINED;
+                    goto done;
+                }
+                else if (type_of(v) != STRING)
+                {
+                    parser->error = EXPECTED_STRING;
+                    goto done;
+                }
+                // The name stays on the stack, so it's kept while loading
+                m.root.count = sp;
+                m.root.frame_count = fp + 1;
+                v = load_file(env, parser, from_scm_string(as_string(v)));
+                if (parser->error != NO_ERROR) goto done;
+                m.stack[sp - 1] = v;
+                break;
+
+            case OP_RETURN:
+                v = m.stack[sp - 1];
+                if (fp == 0)
+                {
+                    result = v;
+                    goto done;
+                }
+                if (memoizing)
+                {
+                    // The value replaces the memo rather than the
+                    // procedure it ran
+                    memo_store(m.stack[base - 2], m.stack[base - 1], v);
+                    base -= 2;
+                }
+                m.stack[base] = v;
+                sp = base + 1;
+                if (owns_nsp) release_frame(env);
+                fp--;
+                c = m.frames[fp].code;
+                pc = m.frames[fp].pc;
+                base = m.frames[fp].base;
+                owns_nsp = m.frames[fp].owns_nsp;
+                memoizing = m.frames[fp].memoizing;
+                env = m.nsps[fp];
+                break;
+        }
+    }
+
+done:
+    // Give back the frames of every call still running, which is just
+    // the outermost one unless there was an error
+    if (owns_nsp) release_frame(m.nsps[fp]);
+    for (unsigned int i = 0; i < fp; i++)
+    {
+        if (m.frames[i].owns_nsp) release_frame(m.nsps[i]);
+    }
+    gc_pop_root(&m.root);
+    if (m.stack != m.init_stack) free(m.stack);
+    if (m.frames != m.init_frames)
+    {
+        free(m.frames);
+        free(m.nsps);
+    }
+    return result;
+}
+
+/* Public functions */
+
+Value run(struct Namespace *nsp, struct Parser *parser, Value code)
+{
+    return execute(nsp, parser, as_code(code), &code, 1);
+}
+
+Value apply(struct Parser *parser, Value proc, unsigned int argc, Value *argv)
+{
+    if (argc > MAX_CODE_LENGTH)
+    {
+        parser->error = INCORRECT_NUMBER_OF_ARGS;
+        return NO_VALUE;
+    }
+
+    // A two instruction program that makes the call in its own place.
+    // Its slot is empty, since the code isn't a value
+    uint16_t ops[] = { OP_TAIL_CALL, (uint16_t)argc, OP_RETURN };
+    struct Code code;
+    code.ops = ops;
+    code.length = sizeof(ops) / sizeof(ops[0]);
+    code.capacity = code.length;
+    code.constants = NULL;
+    code.args = NO_VALUE;
+    code.body = NO_VALUE;
+    code.nparams = 0;
+    code.variadic = false;
+    code.max_stack = argc + 1;
+
+    Value init[VM_APPLY_ARGS + 2];
+    Value *values = (argc <= VM_APPLY_ARGS) ? init : malloc((argc + 2) * sizeof(*values));
+    if (values == NULL) return NO_VALUE;
+    values[0] = NO_VALUE;
+    values[1] = proc;
+    if (argc > 0) memcpy(values + 2, argv, argc * sizeof(*argv));
+
+    Value result = execute(NULL, parser, &code, values, argc + 2);
+    if (values != init) free(values);
+    return result;
+}
@@ -0,0 +1,32 @@
+#ifndef VM
+#define VM
+
+#include "datatype.h"
+#include "namespace.h"
+#include "parser.h"
+
+/* Constants */
+
+/* Stack slots and call frames the VM starts with on the C stack. Deeper
+ * computations move to the heap, so (non tail) recursion is only limited
+ * by memory */
+#define VM_STACK_SIZE 256
+#define VM_FRAMES 32
+
+/* Arguments apply can pass without allocating */
+#define VM_APPLY_ARGS 8
+
+/* Function definitions */
+
+/* Runs compiled code (a CODE value from compile) in nsp and returns the
+ * value it computes. Sets parser->error and returns NO_VALUE on failure */
+Value run(struct Namespace *nsp, struct Parser *parser, Value code);
+
+/* Calls proc (a procedure or builtin) with argc arguments and returns its
+ * value. This is how builtins call back into Scheme. It's a safe point,
+ * so anything the caller holds across it must be rooted (see gc.h), and
+ * argv is copied rather than kept up to date (it may be NULL if argc is
+ * 0). Sets parser->error and returns NO_VALUE on failure */
+Value apply(struct Parser *parser, Value proc, unsigned int argc, Value *argv);
+
+#endif